@@ -30,15 +30,15 @@
 
 /*---------- external variables ----------*/
 /*-- READ-ONLY --*/
-extern int mv_stack_p;
-extern MVST move_stack[MAX_STACK+1];
-extern int cst_p;
-extern uint16_t cstack[MAX_STACK+1];
-extern int en_passant_sq;
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL int cst_p;
+extern THREAD_LOCAL uint16_t cstack[MAX_STACK+1];
+extern THREAD_LOCAL int en_passant_sq;
 extern const int8_t board64[64];
 extern const int8_t RowNum[120];
-extern PIECE *board[120];
-extern unsigned int gflags;
+extern THREAD_LOCAL PIECE *board[120];
+extern THREAD_LOCAL unsigned int gflags;
 
 /*-- READ-WRITE --*/
 
@@ -67,6 +67,19 @@
 #define QUEEN_V            960
 #define DELTAMARGIN        200
 #define EG_WINNING_MARGIN  400
+/*lazy eval margins for the windowed eval, per stage. measured as the
+  difference between the stage value and the full middle game eval, they
+  cover more than 99.9% of the positions. they are not the maximum of the
+  skipped terms, so the lazy exits are approximate and change the search.
+  that is why the lazy exits are only built with LAZY_EVAL_WINDOW defined
+  at build time: they add nodes, and bench is not faster with them.
+  after material and piece-square values, there are still the mobility,
+  minor piece imbalances, pawn structure, trade logic and king safety.*/
+#define LAZY_MARGIN_MATERIAL 300
+/*after the pawn structure from the pawn hash table, there are still the
+  trade logic, the knight/bishop pawn spread and the middle game terms like
+  rooks on open files and king safety.*/
+#define LAZY_MARGIN_PAWNS  220
 #define PV_CHANGE_THRESH   50
 #define EG_PIECES          6
 #define NULL_PIECES        6
@@ -80,6 +93,7 @@
 #define QS_CHECKS          1
 #define QS_CHECK_DEPTH     4
 #define QS_RECAPT_DEPTH    5 /*must be greater than QS_CHECK_DEPTH*/
+#define QS_TT_DEPTH        0 /*hash depth of QS entries, below all main search entries*/
 #define HIGH_EVAL_NOISE    30
 
 /*approximate base Elo at 30 kNPS*/
@@ -97,13 +111,48 @@
 #define NO_ACTION_PLIES    40
 #define FIFTY_MOVES_FULL   80
 
+/*with TT_BUCKETS defined at build time, there is one shared main hash table
+  of 64 byte buckets instead of the two tables with overlapping clusters.*/
+#ifdef TT_BUCKETS
+#define DEF_MAX_TT         0x2000UL /*in buckets*/
+#define TT_TABLES          1
+#define MAX_AGE_CNT        63
+#else
 #define DEF_MAX_TT         0x8000UL
-#define PMAX_TT            0x2FFFUL
-#define CLUSTER_SIZE       3
+#define TT_TABLES          2
 #define MAX_AGE_CNT        3
+#endif
+/*eval cache size per thread as power of 2. can be set at build time with
+  -DEVAL_CACHE_BITS=n, and 0 switches the eval cache off. off by default
+  because with the exact key, the hit rate is below 1% in the search, and
+  computing the key costs more than the hits save.*/
+#ifndef EVAL_CACHE_BITS
+#define EVAL_CACHE_BITS    0
+#endif
+#define CLUSTER_SIZE       3
 #define HASH_DEFAULT       8    /*in MB*/
 #define HASH_MIN           1    /*in MB*/
+/*64 bit builds can use 64 GB, 32 bit builds lack the address space.*/
+#if (TARGET_BUILD == 64)
+#define HASH_MAX           65536 /*in MB*/
+#else
 #define HASH_MAX           1024 /*in MB*/
+#endif
+/*the pawn hash table exists once per search thread.*/
+#define PAWN_HASH_DEFAULT  1    /*in MB*/
+#define PAWN_HASH_MIN      1    /*in MB*/
+#define PAWN_HASH_MAX      256  /*in MB*/
+#define THREADS_DEFAULT    1
+#define THREADS_MIN        1
+#define THREADS_MAX        128
+#define MULTIPV_DEFAULT    1
+#define MULTIPV_MIN        1
+#define MULTIPV_MAX        32
+
+/*the saved hash tables start on multiples of this in the file so that they
+  can be mapped directly. 64 kB also fits the Windows allocation granularity.*/
+#define HASH_FILE_PAGE     65536UL
+#define HASH_FILE_NAME_LEN 256
 
 /*13 kB ring buffer size. can hold more than three of the longest allowed
   UCI commands.*/
@@ -141,6 +190,10 @@ enum E_FEN_SCAN {
 
 #define PERFT_CHECK_NODES  100000ULL
 
+/*defaults for the "bench" command*/
+#define BENCH_HASH_DEFAULT 16   /*in MB*/
+#define BENCH_DEPTH_DEFAULT 12
+
 
 /*now for some GCC specific attributes, builtins and pragmas. this is
   encapsulated via defines so that switching to another compiler will be
@@ -157,7 +210,18 @@ enum E_FEN_SCAN {
   have a function prototype match.*/
 #define VAR_UNUSED         __attribute__((unused))
 
-enum E_PROT_TYPE {PROT_NONE, PROT_UCI};
+/*thread local storage for the search state. every search thread has its
+  own board, piece lists, stacks and move ordering tables. the helper threads
+  of a parallel search copy the main hash table pointers so that they share
+  the tables. in the library build, independent engine contexts can search
+  in different threads at the same time.*/
+#define THREAD_LOCAL       __thread
+
+/*atomic increment that returns the previous value, for handing out work
+  to several threads.*/
+#define ATOMIC_FETCH_INC(x) __sync_fetch_and_add((x), 1)
+
+enum E_PROT_TYPE {PROT_UNDEF, PROT_UCI, PROT_BENCH};
 
 /*UCI time mode*/
 enum E_TIME_CONTROL {
@@ -208,7 +272,20 @@ enum E_CURRMOVE {
 enum E_CMD_TYPE {
     CMD_GENERIC,
     CMD_STOP,
-    CMD_POSITION
+    CMD_POSITION,
+    CMD_STRING_OPTION
+};
+
+/*return codes from saving and loading the hash tables*/
+enum E_HASH_FILE {
+    HASH_FILE_OK,
+    HASH_FILE_MAPPED,
+    HASH_FILE_OPEN,
+    HASH_FILE_IO,
+    HASH_FILE_FORMAT,
+    HASH_FILE_KEYS,
+    HASH_FILE_SIZE,
+    HASH_FILE_CRC
 };
 
 /*for throttling depending on the cause*/
@@ -406,6 +483,7 @@ typedef union
 #define MVV_LVA_KILLER_0     2
 #define MVV_LVA_KILLER_1     1
 #define MVV_LVA_TACTICAL     0
+#define MVV_LVA_LOSING    -120
 #define MVV_LVA_ILLEGAL   -126
 /*mate searcher*/
 #define MVV_LVA_CHECK      126
@@ -445,14 +523,32 @@ typedef struct piece_st
     int8_t mobility; /* for pieces : number of moves - max_per piece/2 , for pawns: passed pawn evaluation */
 } PIECE;
 
+/*pinned pieces for the legality test without make/unmake*/
+typedef struct t_pin_info
+{
+    int in_check;
+    int n_pins;
+    uint8_t pinned[8]; /*square of the pinned piece*/
+    uint8_t pinner[8]; /*square of the pinning slider*/
+    int8_t dir[8];     /*step from the king towards the pinner*/
+} PIN_INFO;
+
+/*piece counts in the move stack, 4 bits per piece type: white pawns to
+  queens in the lower bits, then black pawns to queens. no kings.*/
+#define PCNT_SHIFT(type)    ((((type) >= BPAWN) ? ((type) - BPAWN + 5) : ((type) - WPAWN)) * 4)
+#define PCNT_ONE(type)      (1ULL << PCNT_SHIFT(type))
+#define PCNT_GET(cnt, type) ((int32_t)(((cnt) >> PCNT_SHIFT(type)) & 0x0FU))
+
 /*struct for the main move stack*/
 typedef struct mvst
 {
     uint64_t mv_pos_hash;
     uint64_t mv_pawn_hash;
+    uint64_t piece_cnt; /*see PCNT_SHIFT*/
     MOVE move;
     PIECE *captured;
     int16_t material;
+    int16_t psq;        /*piece-square sum*/
     int8_t capt;
     uint8_t special;   /* values: NORMAL,CASTL,PROMOT */
 } MVST;
@@ -464,6 +560,7 @@ So only 32bit are saved, 6 more bits get fiddled into some free space within the
 index serves also as part of the hash sum. All in all, that gives around 48bits of hash without
 wasting 20kB.*/
 
+#ifndef TT_BUCKETS
 typedef struct tt_st
 {
     /*if the cashed entry is not a terminal node, it is even more valuable because it represents a whole
@@ -485,8 +582,8 @@ typedef struct tt_st
     position hash length of 32+6+10=48 bits.*/
     uint8_t flag;
     /*the lower 6 bits of depth contain the actual depth. The upper 2 bits contain the hash clear
-    counter which is increased upon every search so that before each search, the oldest 25% of
-    the entries are cleared.*/
+    counter of the search that has written the entry. the counter is increased upon every search,
+    and entries from older searches lose their depth preference for the replacement.*/
     uint8_t depth;
 #if (MAX_DEPTH > 63)
     #error "Review the TT_ST data structure with depth (too high) and clear counter!"
@@ -496,38 +593,85 @@ typedef struct tt_st
 #endif
 } TT_ST;
 
+#else /*TT_BUCKETS*/
+
+#define BUCKET_SIZE        5
+#define TT_GEN_SHIFT       2
+#define TT_GEN_MASK        0x3FU
+
+typedef struct tt_entry_st
+{
+    /*bits 16 to 63 of the position hash, and the index adds the lowest bits.
+    the pseudo legality check for the move is done as in the cluster layout.*/
+    uint32_t pos_hash_upper;
+    uint16_t pos_hash_mid;
+    CMOVE cmove;
+    int16_t value;
+    /*only the depth, no clear counter bits.*/
+    uint8_t depth;
+    /*the lowest two bits hold the value type as in the cluster layout, with 0 for
+    an empty entry. the upper 6 bits are the generation, i.e. the hash clear counter
+    of the search that has written the entry.*/
+    uint8_t flag;
+} TT_ENTRY_ST;
 
+/*one bucket is 5*12+4 = 64 bytes, and the table is allocated on a 64 byte
+boundary so that every probe touches exactly one cache line.*/
+typedef struct tt_st
+{
+    TT_ENTRY_ST entry[BUCKET_SIZE];
+    uint32_t reserved;
+} TT_ST;
+#if (MAX_DEPTH > 255)
+    #error "Review the TT_ENTRY_ST data structure with depth (too high)!"
+#endif
+#if (MAX_AGE_CNT > TT_GEN_MASK)
+    #error "Review the TT_ENTRY_ST data structure with clear counter (too high)!"
+#endif
+#endif /*TT_BUCKETS*/
+
+
+/*pawn hash entry. it holds the complete result of the pawn structure
+evaluation, i.e. both the middle game and the endgame pawn value, so that a
+hit never needs the pawn evaluation, not even during the transition from
+middle game to endgame.*/
 typedef struct tt_ptt_st
 {
-    /*here, we use only 32bits from the position hash plus 11 bits indirectly from the index,
-    so that the effective stored hash length becomes 43. 5 more hash bits get fiddled into the
-    value variable, which is only used in the range of +/-511. Then we are at 48 bits of hash.*/
+    /*48 bits of the pawn hash. the lower bits are also covered by the index.*/
     uint32_t pawn_hash_upper;
-#define PTT_VALUE_BITS     0x01FFUL
-#define PTT_SIGN_BIT       0x0200UL
-#define PTT_MG_BIT         0x0400UL
-#define PTT_HASH_BITS      0xF800UL
-    /*the lowest 9 bits of the value hold the absolute value, the 10th is for the sign.
-    1 bit is for storing whether the pawn structure eval was only middlegame (MG) or
-    with the endgame modifications.
-    this gives 5 more bits to stuff in a bigger portion of the pawn hash value, as to
-    minimise hash collisions.
-
-    Of course, the bit twiddling could be done with a signed 16bit integer as well, but
-    the C standard doesn't specify how a signed int is implemented. On ARM as well as
-    on x86, it is the two's complement, but the unsigned int is specified (though not
-    in the byte order, of course)*/
-    uint16_t value;
+    uint16_t pawn_hash_mid;
+    int16_t mg_value;
+    int16_t eg_value;
     uint8_t w_pawn_mask; /*files with white pawns. LSB is the A file.*/
     uint8_t b_pawn_mask;
+    uint8_t w_rook_files;
+    uint8_t b_rook_files;
+    uint8_t used;
+    uint8_t reserved;
 } TT_PTT_ST;
 
-/*make this a separate table to avoid padding issues (or performance penalty).*/
-typedef struct tt_ptt_rook_st
+/*4 entries of 16 bytes make up one cache line. the newest entry is first.*/
+#define PTT_BUCKET_SIZE    4
+typedef struct tt_ptt_bucket_st
 {
-    uint8_t w_rook_files;
-    uint8_t b_rook_files;
-} TT_PTT_ROOK_ST;
+    TT_PTT_ST entry[PTT_BUCKET_SIZE];
+} TT_PTT_BUCKET_ST;
+
+/*eval cache entry. the key is the position hash mixed with the search
+  context, see eval.c. the file masks fit into 8 bits. the stage values
+  are for repeating the lazy eval exits with a different window.*/
+typedef struct tt_eval_st
+{
+    uint64_t key;
+    int16_t value;
+    int16_t material_stage;
+    int16_t pawn_stage;
+    uint8_t lazy_stages;
+    uint8_t enough_material;
+    uint8_t is_endgame;
+    uint8_t w_passed_mask;
+    uint8_t b_passed_mask;
+} TT_EVAL_ST;
 
 typedef struct t_game_info
 {
@@ -593,3 +737,60 @@ typedef struct t_piece_info
     int32_t w_bishop_colour;
     int32_t b_bishop_colour;
 } PIECE_INFO;
+
+/*endgame types from the material signature. from EG_EXACT on, the special
+evaluation replaces the whole endgame evaluation.*/
+enum E_EG_TYPE {
+    EG_NONE,
+    EG_MINOR_PAWNS,     /*one minor piece with pawns, e.g. KBp:K*/
+    EG_PAWNS_ONLY,      /*several pawns against the lone king*/
+    EG_KQKP, EG_KPKQ,
+    EG_KRKP, EG_KPKR,
+    EG_EXACT,
+    EG_KPK, EG_KKP,
+    EG_KRK, EG_KKR,
+    EG_KQK, EG_KKQ,
+    EG_KRKB, EG_KBKR,
+    EG_KRKN, EG_KNKR,
+    EG_KBNK, EG_KKBN,
+    EG_KNNK, EG_KKNN,
+    EG_KQKR, EG_KRKQ
+};
+
+#define EG_FLAG_DRAWISH     0x01U /*no pawns and less than the winning margin*/
+
+typedef struct t_eg_material
+{
+    uint64_t piece_cnt; /*the key, see PCNT_SHIFT*/
+    uint8_t eg_type;
+    uint8_t scale;      /*the endgame eval gets divided by this*/
+    uint8_t flags;
+} EG_MATERIAL_ST;
+
+/*search statistics, counted per search thread and reported with the UCI
+command "stats". the node types are PV and zero window nodes of the main
+search and the quiescence search. the TT counters are per table: T_T for
+the positions with the root side to move, Opp_T_T for the others. with
+TT_BUCKETS, both are the same table, and everything counts as T_T.*/
+enum E_STAT_NODE {STAT_PV, STAT_NON_PV, STAT_QS, STAT_NODE_TYPES};
+enum E_STAT_TT {STAT_TT_OWN, STAT_TT_OPP, STAT_TT_TABLES};
+
+typedef struct t_search_stats
+{
+    uint64_t nodes[STAT_NODE_TYPES];
+    uint64_t tt_probes[STAT_TT_TABLES][STAT_NODE_TYPES];
+    uint64_t tt_hits[STAT_TT_TABLES][STAT_NODE_TYPES];   /*entry found*/
+    uint64_t tt_cutoffs[STAT_TT_TABLES][STAT_NODE_TYPES];/*value usable without search*/
+    uint64_t beta_cutoffs;
+    uint64_t first_move_cutoffs;
+    uint64_t null_tries;
+    uint64_t null_cutoffs;
+    uint64_t lmr_reductions;
+    uint64_t lmr_researches;             /*reduced search failed high*/
+    uint64_t futility_prunes;
+    uint64_t rvrs_futility_prunes;
+    uint64_t pawn_probes;
+    uint64_t pawn_hits;
+    uint64_t eval_probes;
+    uint64_t eval_hits;
+} SEARCH_STATS;
@@ -31,6 +31,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ctdefs.h"
@@ -39,15 +40,15 @@
 
 /*---------- external variables ----------*/
 /*-- READ-ONLY --*/
-extern int wking, bking;
-extern PIECE *board[120];
-extern int game_started_from_0;
-extern int32_t start_moves;
-extern GAME_INFO game_info;
-extern enum E_COLOUR computer_side;
-extern unsigned int gflags;
-extern int mv_stack_p;
-extern MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL int wking, bking;
+extern THREAD_LOCAL PIECE *board[120];
+extern THREAD_LOCAL int game_started_from_0;
+extern THREAD_LOCAL int32_t start_moves;
+extern THREAD_LOCAL GAME_INFO game_info;
+extern THREAD_LOCAL enum E_COLOUR computer_side;
+extern THREAD_LOCAL unsigned int gflags;
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
 extern const int8_t boardXY[120];
 extern const int8_t RowNum[120];
 extern const int8_t ColNum[120];
@@ -57,15 +58,18 @@ extern const int8_t board64[64];
 extern int32_t eval_noise;
 
 /*-- READ-WRITE--*/
-extern PIECE Wpieces[16];
-extern PIECE Bpieces[16];
-extern TT_PTT_ST P_T_T[PMAX_TT+1];
-extern TT_PTT_ROOK_ST P_T_T_Rooks[PMAX_TT+1];
-extern uint64_t tb_hits;
+extern THREAD_LOCAL PIECE Wpieces[16];
+extern THREAD_LOCAL PIECE Bpieces[16];
+extern THREAD_LOCAL TT_PTT_BUCKET_ST *P_T_T;
+extern THREAD_LOCAL uintptr_t PMAX_TT;
+extern THREAD_LOCAL uint64_t tb_hits;
+extern THREAD_LOCAL SEARCH_STATS search_stats;
 
 /*---------- module global variables ----------*/
 
-static int32_t W_Pawn_E[120], B_Pawn_E[120];
+/*the piece-square values for pawns, knights and bishops, with the sign
+  for white's view. the sum over the board is kept in the move stack.*/
+int16_t psq_table[PIECEMAX][ENDSQ];
 
 /*for the logic when and what to trade.
 they get set up in Eval_Setup_Initial_Material() which is called before the computer starts calculating its response move,
@@ -73,10 +77,41 @@ so they reflect the material situation on the board.
 that will get evaluated in Eval_Static_Evaluation() during the search tree to examine what exchanges have been taking place
 within the search tree. every exchange that has occurred between the current board position and the leaves of
 the search tree will be considered.*/
-static int start_material, start_qdiff, start_rdiff, start_mdiff, start_pdiff, start_piece_diff, start_pieces;
+static THREAD_LOCAL int start_material, start_qdiff, start_rdiff, start_mdiff, start_pdiff, start_piece_diff, start_pieces;
 
 /*also used in search.c for flattening the difference.*/
-int start_pawns;
+THREAD_LOCAL int start_pawns;
+
+#if (EVAL_CACHE_BITS > 0)
+/*direct-mapped eval cache. besides the position, the eval depends on the
+side to move, on the game phase via the move counter, and on the search
+context (start material, computer side, last valid eval). the latter is
+covered by a salt that changes with every Eval_Setup_Initial_Material().
+the mobility values come from the last move generation, and the castled
+flags for the king safety are not in the position hash either. both are
+mixed into the key so that the cache does not change the search.*/
+#define EVAL_CACHE_SIZE    (1UL << EVAL_CACHE_BITS)
+#define EVAL_CACHE_MASK    (EVAL_CACHE_SIZE - 1UL)
+#define EVAL_CACHE_BLACK   0x9E3779B97F4A7C15ULL
+#define EVAL_CACHE_PLY     0xC2B2AE3D27D4EB4FULL
+#define EVAL_CACHE_MOBILITY 0x165667B19E3779F9ULL
+#define EVAL_CACHE_CASTLED  0xD6E8FEB86659FD93ULL
+#define EVAL_NO_STAGE      INT_MIN
+static THREAD_LOCAL TT_EVAL_ST eval_cache[EVAL_CACHE_SIZE];
+static THREAD_LOCAL uint64_t eval_cache_salt;
+#endif
+
+/*endgame types and scaling for all material signatures with up to three
+pieces besides the kings, keyed by the piece counts in the move stack. this
+is filled in Eval_Init_Material() and read-only afterwards, so all threads
+share it.*/
+#define EG_MAT_TABLE_PIECES 5
+#define EG_MAT_TABLE_BITS   9
+#define EG_MAT_TABLE_SIZE   (1U << EG_MAT_TABLE_BITS)
+#define EG_MAT_TABLE_MASK   (EG_MAT_TABLE_SIZE - 1U)
+#define EG_MAT_TABLE_EMPTY  0xFFFFFFFFFFFFFFFFULL
+#define EG_MAT_INDEX(cnt)   ((unsigned int) (((cnt) * 0x9E3779B97F4A7C15ULL) >> (64 - EG_MAT_TABLE_BITS)))
+static EG_MATERIAL_ST eg_mat_table[EG_MAT_TABLE_SIZE];
 
 static const int8_t BishopSquareColour[2] = {DARK_SQ,LIGHT_SQ};
 
@@ -1815,19 +1850,22 @@ static void Eval_Pawn_Evaluation(PAWN_INFO *restrict pawn_info)
     pawn_info->extra_pawn_val = extra_pawn_val;
 } /*end of pawn evaluation (endgame pawn modification will follow further down in the endgame eval)*/
 
-static int Eval_Middlegame_Evaluation(PAWN_INFO *restrict pawn_info, const PIECE_INFO *restrict piece_info, int pawn_hash_hit)
+/*the middle game pawn value for the pawn hash table, from the result of
+the pawn evaluation.*/
+static int Eval_Middlegame_Pawn_Value(const PAWN_INFO *restrict pawn_info)
 {
-    int xy, i, ret = 0;
+    /*general centre pawn distribution. in the middle game, central pawns are more worth than others.*/
+    int CentrePawnVal;
+    CentrePawnVal = CentreTable[(pawn_info->w_pawn_mask >> 2) & 0x0f];
+    CentrePawnVal += CentreTable[(pawn_info->w_d_pawnmask >> 2) & 0x0f] >> 2;
+    CentrePawnVal -= CentreTable[(pawn_info->b_pawn_mask >> 2) & 0x0f];
+    CentrePawnVal -= CentreTable[(pawn_info->b_d_pawnmask >> 2) & 0x0f] >> 2;
+    return(pawn_info->extra_pawn_val + CentrePawnVal);
+}
 
-    if (!pawn_hash_hit) {
-        /*general centre pawn distribution. in the middle game, central pawns are more worth than others.*/
-        int CentrePawnVal;
-        CentrePawnVal = CentreTable[(pawn_info->w_pawn_mask >> 2) & 0x0f];
-        CentrePawnVal += CentreTable[(pawn_info->w_d_pawnmask >> 2) & 0x0f] >> 2;
-        CentrePawnVal -= CentreTable[(pawn_info->b_pawn_mask >> 2) & 0x0f];
-        CentrePawnVal -= CentreTable[(pawn_info->b_d_pawnmask >> 2) & 0x0f] >> 2;
-        pawn_info->extra_pawn_val += CentrePawnVal;
-    }
+static int Eval_Middlegame_Evaluation(const PAWN_INFO *restrict pawn_info, const PIECE_INFO *restrict piece_info)
+{
+    int xy, i, ret = 0;
 
     ret += pawn_info->extra_pawn_val;
 
@@ -2311,130 +2349,500 @@ static int Eval_Middlegame_Evaluation(PAWN_INFO *restrict pawn_info, const PIECE
     return(ret);
 }
 
-/*unlike the other partial eval functions, this is a void return type; instead,
-it takes the existing eval (from Eval_Static_Evaluation) as 2nd argument by reference. The
-reason is that unlike the other functions, this is not only addition/subtraction
-on the existing value, but sometimes also a plain overwrite, e.g. in KNB-K. This
-is only possible by reference.*/
-static void Eval_Endgame_Evaluation(PAWN_INFO *restrict pawn_info, int *current_eval,
-                                    const PIECE_INFO *restrict piece_info, int pawn_hash_hit,
-                                    enum E_COLOUR side_to_move, int pure_material)
+/*the endgame pawn value for the pawn hash table, from the result of the
+pawn evaluation.*/
+static int Eval_Endgame_Pawn_Value(const PAWN_INFO *restrict pawn_info)
 {
-    int xy, i, ret;
+    int i;
     unsigned int bin_col;
-    int three_or_four_pieces_no_pawns = (piece_info->all_pieces < 5) && (pawn_info->all_pawns==0);
-    int king_halts_passed, basic_endgames, disregard_centre;
+    int max_passed_connected;
+    int extra_pawn_val = pawn_info->extra_pawn_val;
 
-    ret = *current_eval;
+    /*Add a penalty for no pawns at endgame*/
+    if (pawn_info->w_pawns == 0)
+        extra_pawn_val -= 50;
+    if (pawn_info->b_pawns == 0)
+        extra_pawn_val += 50;
+    /* Give some extra malus for endgame isolated pawns.
+    pay attention that the overall sum for making black pawns "f6, g6, h6" (best
+    constellation) to "f6, h6, h5" (worst constellation) is less than 100 points
+    difference - don't sacrifice a pawn for that change! */
+    if (pawn_info->w_isolani) {
+        if (pawn_info->w_isolani>2)
+            extra_pawn_val -= (pawn_info->w_isolani<<2);
+        else
+            extra_pawn_val -= (pawn_info->w_isolani<<1);
+    }
+    if (pawn_info->b_isolani) {
+        if (pawn_info->b_isolani>2)
+            extra_pawn_val += (pawn_info->b_isolani<<2);
+        else
+            extra_pawn_val += (pawn_info->b_isolani<<1);
+    }
+    /*choice of the factor:
+    - the base worth of an outside passer is already 20 points.
+    - bishop is 5 points more worth than a knight.
+    - with spread pawns (necessary for an outward passer) even 5 more, makes 10.
+    => for encouraging trading the bishop versus the knight for making an
+    outside passer, we must add more than 10 points.*/
+    if (pawn_info->w_outpassed)
+        extra_pawn_val += (pawn_info->w_outpassed << 4);
+    if (pawn_info->b_outpassed)
+        extra_pawn_val -= (pawn_info->b_outpassed << 4);
+
+    /*similar for devalued pawn majority: base penalty is 18, the bishop pair's worth
+    in the opening. in the endgame, we add another 10 points penalty, making it 28 points,
+    less then the bishop pair bonus. DON'T bitshift because that variable is
+    negative in case of a black devalued majority.*/
+    extra_pawn_val -= pawn_info->deval_pawn_majority*10;
+
+    /* endgame adjustments for passed pawns: double their base value in the endgame.*/
+    extra_pawn_val += pawn_info->w_passed_mobility - pawn_info->b_passed_mobility;
 
-    if (!pawn_hash_hit)
+    /*now check for connected white passed pawns. we're only checking for the
+    most advanced connected pair. it doesn't make sense to check for three connected
+    passed pawns, that doesn't happen in real games - or the game is decided anyway.*/
+    if (pawn_info->w_passed_pawns > 1) /*connected pawns require at least two of them*/
     {
-        int max_passed_connected;
-        int extra_pawn_val = pawn_info->extra_pawn_val;
-        /*Add a penalty for no pawns at endgame*/
-        if (pawn_info->w_pawns == 0)
-            extra_pawn_val -= 50;
-        if (pawn_info->b_pawns == 0)
-            extra_pawn_val += 50;
-        /* Give some extra malus for endgame isolated pawns.
-        pay attention that the overall sum for making black pawns "f6, g6, h6" (best
-        constellation) to "f6, h6, h5" (worst constellation) is less than 100 points
-        difference - don't sacrifice a pawn for that change! */
-        if (pawn_info->w_isolani) {
-            if (pawn_info->w_isolani>2)
-                extra_pawn_val -= (pawn_info->w_isolani<<2);
-            else
-                extra_pawn_val -= (pawn_info->w_isolani<<1);
-        }
-        if (pawn_info->b_isolani) {
-            if (pawn_info->b_isolani>2)
-                extra_pawn_val += (pawn_info->b_isolani<<2);
-            else
-                extra_pawn_val += (pawn_info->b_isolani<<1);
-        }
-        /*choice of the factor:
-        - the base worth of an outside passer is already 20 points.
-        - bishop is 5 points more worth than a knight.
-        - with spread pawns (necessary for an outward passer) even 5 more, makes 10.
-        => for encouraging trading the bishop versus the knight for making an
-        outside passer, we must add more than 10 points.*/
-        if (pawn_info->w_outpassed)
-            extra_pawn_val += (pawn_info->w_outpassed << 4);
-        if (pawn_info->b_outpassed)
-            extra_pawn_val -= (pawn_info->b_outpassed << 4);
-
-        /*similar for devalued pawn majority: base penalty is 18, the bishop pair's worth
-        in the opening. in the endgame, we add another 10 points penalty, making it 28 points,
-        less then the bishop pair bonus. DON'T bitshift because that variable is
-        negative in case of a black devalued majority.*/
-        extra_pawn_val -= pawn_info->deval_pawn_majority*10;
-
-        /* endgame adjustments for passed pawns: double their base value in the endgame.*/
-        extra_pawn_val += pawn_info->w_passed_mobility - pawn_info->b_passed_mobility;
-
-        /*now check for connected white passed pawns. we're only checking for the
-        most advanced connected pair. it doesn't make sense to check for three connected
-        passed pawns, that doesn't happen in real games - or the game is decided anyway.*/
-        if (pawn_info->w_passed_pawns > 1) /*connected pawns require at least two of them*/
+        if (ConnectedTable[pawn_info->w_passed_mask]) /*and in adjacent files*/
         {
-            if (ConnectedTable[pawn_info->w_passed_mask]) /*and in adjacent files*/
+            max_passed_connected = 0;
+            /*scan the adjacent files*/
+            for (i = 0, bin_col = (A_FILE | B_FILE); i < 7; bin_col <<= 1, i++)
             {
-                max_passed_connected = 0;
-                /*scan the adjacent files*/
-                for (i = 0, bin_col = (A_FILE | B_FILE); i < 7; bin_col <<= 1, i++)
+                if ((pawn_info->w_passed_mask & bin_col) == bin_col) /*found two connected passed pawns!*/
                 {
-                    if ((pawn_info->w_passed_mask & bin_col) == bin_col) /*found two connected passed pawns!*/
-                    {
-                        int Passed;
-                        int _abs_diff;
-                        _abs_diff = pawn_info->w_passed_rows[i] - pawn_info->w_passed_rows[i+1];
-                        _abs_diff = Abs(_abs_diff);
-                        if (_abs_diff <= 1) /*adjacent and connected*/
-                            Passed = (pawn_info->w_passed_rows[i] + pawn_info->w_passed_rows[i+1]) << 2;
-                        else
-                            Passed = (pawn_info->w_passed_rows[i] + pawn_info->w_passed_rows[i+1]) << 1;
-                        if (Passed > max_passed_connected)
-                            max_passed_connected = Passed;
-                    }
+                    int Passed;
+                    int _abs_diff;
+                    _abs_diff = pawn_info->w_passed_rows[i] - pawn_info->w_passed_rows[i+1];
+                    _abs_diff = Abs(_abs_diff);
+                    if (_abs_diff <= 1) /*adjacent and connected*/
+                        Passed = (pawn_info->w_passed_rows[i] + pawn_info->w_passed_rows[i+1]) << 2;
+                    else
+                        Passed = (pawn_info->w_passed_rows[i] + pawn_info->w_passed_rows[i+1]) << 1;
+                    if (Passed > max_passed_connected)
+                        max_passed_connected = Passed;
                 }
-                extra_pawn_val += max_passed_connected;
             }
+            extra_pawn_val += max_passed_connected;
         }
+    }
 
-        /*now check for connected black passed pawns.*/
-        if (pawn_info->b_passed_pawns > 1) /*connected pawns require at least two of them*/
+    /*now check for connected black passed pawns.*/
+    if (pawn_info->b_passed_pawns > 1) /*connected pawns require at least two of them*/
+    {
+        if (ConnectedTable[pawn_info->b_passed_mask]) /*and in adjacent files*/
         {
-            if (ConnectedTable[pawn_info->b_passed_mask]) /*and in adjacent files*/
+            max_passed_connected = 0;
+            /*scan the adjacent files*/
+            for (i = 0, bin_col = (A_FILE | B_FILE); i < 7; bin_col <<= 1, i++)
             {
-                max_passed_connected = 0;
-                /*scan the adjacent files*/
-                for (i = 0, bin_col = (A_FILE | B_FILE); i < 7; bin_col <<= 1, i++)
+                if ((pawn_info->b_passed_mask & bin_col) == bin_col) /*found two connected passed pawns!*/
                 {
-                    if ((pawn_info->b_passed_mask & bin_col) == bin_col) /*found two connected passed pawns!*/
-                    {
-                        int Passed;
-                        int _abs_diff;
-                        _abs_diff = pawn_info->b_passed_rows[i] - pawn_info->b_passed_rows[i+1];
-                        _abs_diff = Abs(_abs_diff);
-                        if (_abs_diff <= 1) /*adjacent and connected*/
-                            Passed = (18-(pawn_info->b_passed_rows[i] + pawn_info->b_passed_rows[i+1])) << 2;
-                        else
-                            Passed = (18-(pawn_info->b_passed_rows[i] + pawn_info->b_passed_rows[i+1])) << 1;
-                        if (Passed > max_passed_connected)
-                            max_passed_connected = Passed;
-                    }
+                    int Passed;
+                    int _abs_diff;
+                    _abs_diff = pawn_info->b_passed_rows[i] - pawn_info->b_passed_rows[i+1];
+                    _abs_diff = Abs(_abs_diff);
+                    if (_abs_diff <= 1) /*adjacent and connected*/
+                        Passed = (18-(pawn_info->b_passed_rows[i] + pawn_info->b_passed_rows[i+1])) << 2;
+                    else
+                        Passed = (18-(pawn_info->b_passed_rows[i] + pawn_info->b_passed_rows[i+1])) << 1;
+                    if (Passed > max_passed_connected)
+                        max_passed_connected = Passed;
                 }
-                extra_pawn_val -= max_passed_connected;
             }
+            extra_pawn_val -= max_passed_connected;
+        }
+    }
+    /*limit the range. 511 is already for totally unrealistic positions.*/
+    if (UNLIKELY(extra_pawn_val > 511))
+        extra_pawn_val = 511;
+    else if (UNLIKELY(extra_pawn_val < -511))
+        extra_pawn_val = -511;
+
+    return(extra_pawn_val);
+}
+
+/*unlike the other partial eval functions, this is a void return type; instead,
+it takes the existing eval (from Eval_Static_Evaluation) as 2nd argument by reference. The
+reason is that unlike the other functions, this is not only addition/subtraction
+on the existing value, but sometimes also a plain overwrite, e.g. in KNB-K. This
+is only possible by reference.*/
+/*the elementary endgames where the special evaluation replaces the whole
+endgame evaluation.*/
+static int Eval_Endgame_Exact(enum E_EG_TYPE eg_type, const PIECE_INFO *restrict piece_info,
+                              enum E_COLOUR side_to_move)
+{
+    int xy, i, j, _abs_diff, is_won, ret = 0;
+    int cdiff, rdiff, king_dist, rook_dist, rook_xy;
+    PIECE *p;
+
+    switch (eg_type)
+    {
+    case EG_KPK:
+        tb_hits++;
+        /*find the white pawn*/
+        xy = Wpieces[0].next->xy;
+
+        if (side_to_move == WHITE) /*white to move*/
+            is_won = Kpk_Probe(0, boardXY[wking], boardXY[xy], boardXY[bking]);
+        else
+            is_won = Kpk_Probe(1, boardXY[wking], boardXY[xy], boardXY[bking]);
+
+        if (is_won == 0)
+        {
+            /*if the computer has the pawn advantage, it is still draw, but push the pawn
+            forward because that will force the game to the end much faster, and maybe the opponent
+            goes wrong.*/
+            ret = (2+(RowNum[xy]-2)*2);
         }
-        /*limit the range. 511 is already for totally unrealistic positions.*/
-        if (UNLIKELY(extra_pawn_val > 511))
-            extra_pawn_val = 511;
-        else if (UNLIKELY(extra_pawn_val < -511))
-            extra_pawn_val = -511;
+        else
+        {
+            /*this is won, and a won position is better if the pawn is more advanced.
+            but it must be worth less than a queen to reward promotion.*/
+            ret = (ROOK_V + (RowNum[xy]-2)*20);
+        }
+        break;
+    case EG_KKP:
+        tb_hits++;
+        /*find the black pawn*/
+        xy = Bpieces[0].next->xy;
+
+        if (side_to_move == WHITE) /*white to move*/
+            is_won = Kpk_Probe_Reverse(1, boardXY[wking], boardXY[xy], boardXY[bking]);
+        else
+            is_won = Kpk_Probe_Reverse(0, boardXY[wking], boardXY[xy], boardXY[bking]);
 
-        pawn_info->extra_pawn_val = extra_pawn_val;
+        if (is_won == 0)
+        {
+            /*if the computer has the pawn advantage, it is still draw, but push the pawn
+            forward because that will force the game to the end much faster, and maybe the opponent
+            goes wrong.*/
+            ret = -(2+(7-RowNum[xy])*2);
+        }
+        else
+        {
+            /*this is won, and a won position is better if the pawn is more advanced.
+            but it must be worth less than a queen to reward promotion.*/
+            ret = -(ROOK_V + (7-RowNum[xy])*20);
+        }
+        break;
+    case EG_KRK:
+        tb_hits++;
+        ret = Eval_KingRook_King(bking, wking, Wpieces[0].next->xy);
+        break;
+    case EG_KKR:
+        tb_hits++;
+        ret = -Eval_KingRook_King(wking, bking, Bpieces[0].next->xy);
+        break;
+    case EG_KQK:
+        tb_hits++;
+        ret = Eval_KingQueen_King(bking, wking);
+        break;
+    case EG_KKQ:
+        tb_hits++;
+        ret = -Eval_KingQueen_King(wking, bking);
+        break;
+    case EG_KRKB:
+        /*K+R vs. K+B is draw if the king with the bishop keeps away from the corner that
+        has the colour of his bishop.*/
+        tb_hits++;
+        if (piece_info->b_bishop_colour == LIGHT_SQ)
+            ret = (ROOK_V-BISHOP_V) + LightBishopRook[bking];
+        else
+            ret = (ROOK_V-BISHOP_V) + DarkBishopRook[bking];
+        /*make the difference clearly smaller than the material difference to indicate it is
+        tending towards draw. Note that if the king with the bishop is in the "wrong" corner, this
+        will still be greater than the difference in material.*/
+        ret /= 2;
+        break;
+    case EG_KBKR:
+        tb_hits++;
+        if (piece_info->w_bishop_colour == LIGHT_SQ)
+            ret = - ((ROOK_V-BISHOP_V) + LightBishopRook[wking]);
+        else
+            ret = - ((ROOK_V-BISHOP_V) + DarkBishopRook[wking]);
+        /*make the difference clearly smaller than the material difference to indicate it is
+        tending towards draw. Note that if the king with the bishop is in the "wrong" corner, this
+        will still be greater than the difference in material.*/
+        ret /= 2;
+        break;
+    case EG_KRKN:
+        /*K+R vs. K+N: the weaker party has to keep the king as centralised as possible and
+        must keep the knight close to the king.*/
+        /*find the black knights's position*/
+        xy = Bpieces[0].next->xy;
+
+        /*get the distance between knight and king, counted in king moves*/
+        _abs_diff = ColNum[bking] - ColNum[xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[bking] - RowNum[xy];
+        j = Abs(_abs_diff);
+        xy = (i > j) ? i : j;
+
+        xy--; /*neighbouring squares count as "no distance"*/
+
+        /*keeping the knight close.*/
+        if (xy > 0)
+        {
+            xy *= 80;
+            xy -= 20;
+        } else
+            xy = 0;
+
+        tb_hits++;
+        ret = ((ROOK_V-KNIGHT_V) + KnightRook[bking] + xy)/2;
+        break;
+    case EG_KNKR:
+        /*K+R vs. K+N: the weaker party has to keep the king as centralised as possible and
+        must keep the knight close to the king.*/
+        /*find the white knights's position*/
+        xy = Wpieces[0].next->xy;
+
+        /*get the distance between knight and king, counted in king moves*/
+        _abs_diff = ColNum[wking] - ColNum[xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[wking] - RowNum[xy];
+        j = Abs(_abs_diff);
+        xy = (i > j) ? i : j;
+
+        xy--; /*neighbouring squares count as "no distance"*/
+
+        /*keeping the knight close.*/
+        if (xy > 0)
+        {
+            xy *= 80;
+            xy -= 20;
+        } else
+            xy = 0;
+
+        tb_hits++;
+        ret = -((ROOK_V-KNIGHT_V) + KnightRook[wking] + xy)/2;
+        break;
+    case EG_KBNK:
+        /*find the knight*/
+        p = Wpieces[0].next;
+        i = (p->type == WKNIGHT) ? p->xy : p->next->xy;
+        tb_hits++;
+        ret = BISHOP_V + KNIGHT_V + PAWN_V + Eval_KingKnightBishop_King(bking, wking, piece_info->w_bishop_colour, i);
+        break;
+    case EG_KKBN:
+        /*find the knight*/
+        p = Bpieces[0].next;
+        i = (p->type == BKNIGHT) ? p->xy : p->next->xy;
+        tb_hits++;
+        ret = -(BISHOP_V + KNIGHT_V + PAWN_V + Eval_KingKnightBishop_King(wking, bking, piece_info->b_bishop_colour, i));
+        break;
+    case EG_KNNK:
+        /*get the distance between the kings, counted in king moves*/
+        _abs_diff = ColNum[wking] - ColNum[bking];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[wking] - RowNum[bking];
+        j = Abs(_abs_diff);
+        xy = (i > j) ? i : j;
+
+        tb_hits++;
+        /*still draw, but reward forcing the black king to the border and getting the white king close.
+        maybe the opponent commits an error?*/
+        ret = (30 - KnightE[bking] - xy);
+
+        /*get the knights close*/
+
+        p = Wpieces[0].next;
+        _abs_diff = ColNum[wking] - ColNum[p->xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[wking] - RowNum[p->xy];
+        j = Abs(_abs_diff);
+        ret -= (i > j) ? i : j;
+
+        p = p->next;
+        _abs_diff = ColNum[wking] - ColNum[p->xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[wking] - RowNum[p->xy];
+        j = Abs(_abs_diff);
+        ret -= (i > j) ? i : j;
+
+        /*worst case scenario: eval is still positive*/
+        break;
+    case EG_KKNN:
+        /*get the distance between the kings, counted in king moves*/
+        _abs_diff = ColNum[wking] - ColNum[bking];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[wking] - RowNum[bking];
+        j = Abs(_abs_diff);               
+        xy = (i > j) ? i : j;
+
+        tb_hits++;
+        /*still draw, but reward forcing the black king to the border and getting the white king close.
+        maybe the opponent commits an error?*/
+        ret = -(30 - KnightE[wking] - xy);
+
+        /*get the knights close*/
+
+        p = Bpieces[0].next;
+        _abs_diff = ColNum[bking] - ColNum[p->xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[bking] - RowNum[p->xy];
+        j = Abs(_abs_diff);
+        ret += (i > j) ? i : j;
+
+        p = p->next;
+        _abs_diff = ColNum[bking] - ColNum[p->xy];
+        i = Abs(_abs_diff);
+        _abs_diff = RowNum[bking] - RowNum[p->xy];
+        j = Abs(_abs_diff);
+        ret += (i > j) ? i : j;
+        /*worst case scenario: eval is still negative*/
+        break;
+    case EG_KQKR:
+        /*KQ vs KR*/
+
+        cdiff = ColNum[wking] - ColNum[bking];
+        rdiff = RowNum[wking] - RowNum[bking];
+        king_dist = Abs(cdiff) + Abs(rdiff);
+
+        rook_xy = Bpieces[0].next->xy;
+        cdiff = ColNum[rook_xy] - ColNum[bking];
+        rdiff = RowNum[rook_xy] - RowNum[bking];
+        rook_dist = Abs(cdiff) + Abs(rdiff);
+
+        ret = (PAWN_V + PAWN_V/2 + QUEEN_V - ROOK_V) + (CentreDist[bking] << 1) - (king_dist << 3) + (rook_dist << 2);
+        break;
+    case EG_KRKQ:
+        /*KR vs KQ*/
+
+        cdiff = ColNum[wking] - ColNum[bking];
+        rdiff = RowNum[wking] - RowNum[bking];
+        king_dist = Abs(cdiff) + Abs(rdiff);
+
+        rook_xy = Wpieces[0].next->xy;
+        cdiff = ColNum[rook_xy] - ColNum[wking];
+        rdiff = RowNum[rook_xy] - RowNum[wking];
+        rook_dist = Abs(cdiff) + Abs(rdiff);
+
+        ret = -((PAWN_V + PAWN_V/2 + QUEEN_V - ROOK_V) + (CentreDist[wking] << 1) - (king_dist << 3) + (rook_dist << 2));
+        break;
+    default:
+        break;
     }
+    return(ret);
+}
+
+/*gets the endgame type and the scaling from the material, which is just
+what the piece counts in the move stack give. this fills the material
+table at startup and is called directly for positions with more pieces
+than the table covers.*/
+static void Eval_Endgame_Material(const PAWN_INFO *restrict pawn_info, const PIECE_INFO *restrict piece_info,
+                                  int pure_material, EG_MATERIAL_ST *eg_mat)
+{
+    eg_mat->eg_type = EG_NONE;
+    eg_mat->scale = 1U;
+    eg_mat->flags = 0;
+
+    /*if there are no pawns, being less than a rook up (e.g. just a minor piece)
+    is usually a draw.*/
+    if ((pawn_info->all_pawns == 0) && (Abs(pure_material) < EG_WINNING_MARGIN))
+        eg_mat->flags |= EG_FLAG_DRAWISH;
+
+    if ((piece_info->all_minor_pieces == 1) && (pawn_info->all_pawns != 0) && (piece_info->all_pieces - pawn_info->all_pawns == 3))
+        eg_mat->eg_type = EG_MINOR_PAWNS;
+    else if ((piece_info->all_pieces - pawn_info->all_pawns == 2 /*only pawns - 2 is the kings*/) && (pawn_info->all_pawns > 1) && ((pawn_info->w_pawns == 0) || (pawn_info->b_pawns == 0)))
+        eg_mat->eg_type = EG_PAWNS_ONLY;
+    else if (piece_info->all_pieces == 4)
+    {
+        if (piece_info->all_minor_pieces != 0)
+        {
+            if ((piece_info->w_rooks == 1) && (piece_info->b_bishops == 1))
+                eg_mat->eg_type = EG_KRKB;
+            else if ((piece_info->b_rooks == 1) && (piece_info->w_bishops == 1))
+                eg_mat->eg_type = EG_KBKR;
+            else if ((piece_info->w_rooks == 1) && (piece_info->b_knights == 1))
+                eg_mat->eg_type = EG_KRKN;
+            else if ((piece_info->b_rooks == 1) && (piece_info->w_knights == 1))
+                eg_mat->eg_type = EG_KNKR;
+            else if ((piece_info->w_bishops == 1) && (piece_info->w_knights == 1))
+                eg_mat->eg_type = EG_KBNK;
+            else if ((piece_info->b_bishops == 1) && (piece_info->b_knights == 1))
+                eg_mat->eg_type = EG_KKBN;
+            else if (piece_info->w_knights == 2)
+                eg_mat->eg_type = EG_KNNK;
+            else if (piece_info->b_knights == 2)
+                eg_mat->eg_type = EG_KKNN;
+        } else
+        {
+            if ((piece_info->w_queens == 1) && (pawn_info->b_pawns == 1))
+                eg_mat->eg_type = EG_KQKP;
+            else if ((piece_info->b_queens == 1) && (pawn_info->w_pawns == 1))
+                eg_mat->eg_type = EG_KPKQ;
+            else if ((piece_info->w_rooks == 1) && (pawn_info->b_pawns == 1))
+                eg_mat->eg_type = EG_KRKP;
+            else if ((piece_info->b_rooks == 1) && (pawn_info->w_pawns == 1))
+                eg_mat->eg_type = EG_KPKR;
+            else if ((piece_info->w_queens == 1) && (piece_info->b_rooks == 1))
+                eg_mat->eg_type = EG_KQKR;
+            else if ((piece_info->b_queens == 1) && (piece_info->w_rooks == 1))
+                eg_mat->eg_type = EG_KRKQ;
+        }
+    } else if (piece_info->all_pieces == 3)
+    {
+        if (pawn_info->w_pawns == 1)
+            eg_mat->eg_type = EG_KPK;
+        else if (pawn_info->b_pawns == 1)
+            eg_mat->eg_type = EG_KKP;
+        else if (piece_info->w_rooks == 1)
+            eg_mat->eg_type = EG_KRK;
+        else if (piece_info->b_rooks == 1)
+            eg_mat->eg_type = EG_KKR;
+        else if (piece_info->w_queens == 1)
+            eg_mat->eg_type = EG_KQK;
+        else if (piece_info->b_queens == 1)
+            eg_mat->eg_type = EG_KKQ;
+    } else if ((piece_info->all_pieces == 5) && (piece_info->all_minor_pieces == 3))
+    {
+        if ((piece_info->w_knights+piece_info->w_bishops > 0) && (piece_info->b_knights+piece_info->b_bishops > 0))
+            /*technically, KBBKN is a win, but only with tablebases. Even grandmasters have overlooked this
+            until the arrival of tablebases. If an opponent has tablebases, that means it is a PC program,
+            and with the computing power and the big hash tables of a PC, the opponent would have won long
+            before this endgame situation could arise anyway.*/
+            eg_mat->scale = 10U;
+    }
+}
+
+/*material table lookup, or classification for more pieces. the table has
+all signatures up to its size, so the probing always ends.*/
+static const EG_MATERIAL_ST *Eval_Get_Endgame_Material(uint64_t piece_cnt, const PAWN_INFO *restrict pawn_info,
+                                                       const PIECE_INFO *restrict piece_info, int pure_material,
+                                                       EG_MATERIAL_ST *eg_buf)
+{
+    if (piece_info->all_pieces <= EG_MAT_TABLE_PIECES)
+    {
+        unsigned int idx = EG_MAT_INDEX(piece_cnt);
+
+        while (eg_mat_table[idx].piece_cnt != piece_cnt)
+            idx = (idx + 1U) & EG_MAT_TABLE_MASK;
+        return(&eg_mat_table[idx]);
+    }
+    Eval_Endgame_Material(pawn_info, piece_info, pure_material, eg_buf);
+    return(eg_buf);
+}
+
+static void Eval_Endgame_Evaluation(const PAWN_INFO *restrict pawn_info, int *current_eval,
+                                    const PIECE_INFO *restrict piece_info, const EG_MATERIAL_ST *restrict eg_mat,
+                                    enum E_COLOUR side_to_move)
+{
+    int xy, i, ret;
+    unsigned int bin_col;
+    int three_or_four_pieces_no_pawns = (piece_info->all_pieces < 5) && (pawn_info->all_pawns==0);
+    int king_halts_passed, basic_endgames, disregard_centre;
+
+    /*the elementary endgames replace the general endgame evaluation.*/
+    if (eg_mat->eg_type > EG_EXACT)
+    {
+        *current_eval = Eval_Endgame_Exact((enum E_EG_TYPE) eg_mat->eg_type, piece_info, side_to_move);
+        return;
+    }
+
+    ret = *current_eval;
 
     ret += pawn_info->extra_pawn_val;
 
@@ -3011,7 +3419,7 @@ static void Eval_Endgame_Evaluation(PAWN_INFO *restrict pawn_info, int *current_
     {
         /*if there are no pawns, being less than a rook up (e.g. just a minor piece)
         is usually a draw.*/
-        if (Abs(pure_material) < EG_WINNING_MARGIN)
+        if (eg_mat->flags & EG_FLAG_DRAWISH)
         {
             tb_hits++;
             ret /= 4;
@@ -3054,7 +3462,7 @@ static void Eval_Endgame_Evaluation(PAWN_INFO *restrict pawn_info, int *current_
         }
     }
 
-    if ((piece_info->all_minor_pieces == 1) && (pawn_info->all_pawns != 0) && (piece_info->all_pieces - pawn_info->all_pawns == 3))
+    if (eg_mat->eg_type == EG_MINOR_PAWNS)
     {
         /*check KBp vs. K. That is draw with A or H pawn and the "wrong" bishop
         if the enemy king controls the promotion square. This implementation works also
@@ -3212,7 +3620,7 @@ static void Eval_Endgame_Evaluation(PAWN_INFO *restrict pawn_info, int *current_
                 }
             }
         }
-    } else if ((piece_info->all_pieces - pawn_info->all_pawns == 2 /*only pawns - 2 is the kings*/) && (pawn_info->all_pawns > 1) && ((pawn_info->w_pawns == 0) || (pawn_info->b_pawns == 0)))
+    } else if (eg_mat->eg_type == EG_PAWNS_ONLY)
     {
         /*check for the configuration with a doubled, tripled or whatever'ed pawn on the
         A or H file against the lone king. that is draw if the defender controls the
@@ -3254,539 +3662,267 @@ static void Eval_Endgame_Evaluation(PAWN_INFO *restrict pawn_info, int *current_
                 }
             }
         }
-    }
-    else if (piece_info->all_pieces == 4)
+    } else if (eg_mat->eg_type == EG_KQKP)
     {
-        if (piece_info->all_minor_pieces != 0)
+        /*queen draws against a/c/f/h pawn on 2nd rank with close king*/
+        int pawn_xy = Bpieces[0].next->xy;
+        if (RowNum[pawn_xy] == 2)
         {
-            if ((piece_info->w_rooks == 1) && (piece_info->b_bishops == 1)) /*K+R vs. K+B*/
-                /*K+R vs. K+B is draw if the king with the bishop keeps away from the corner that
-                has the colour of his bishop.*/
+            if ((pawn_xy == A2) || (pawn_xy == C2) || (pawn_xy == F2) || (pawn_xy == H2))
             {
-                tb_hits++;
-                if (piece_info->b_bishop_colour == LIGHT_SQ)
-                    ret = (ROOK_V-BISHOP_V) + LightBishopRook[bking];
-                else
-                    ret = (ROOK_V-BISHOP_V) + DarkBishopRook[bking];
-                /*make the difference clearly smaller than the material difference to indicate it is
-                tending towards draw. Note that if the king with the bishop is in the "wrong" corner, this
-                will still be greater than the difference in material.*/
-                ret /= 2;
-            } else if ((piece_info->b_rooks == 1) && (piece_info->w_bishops == 1)) /*K+B vs. K+R*/
-            {
-                tb_hits++;
-                if (piece_info->w_bishop_colour == LIGHT_SQ)
-                    ret = - ((ROOK_V-BISHOP_V) + LightBishopRook[wking]);
-                else
-                    ret = - ((ROOK_V-BISHOP_V) + DarkBishopRook[wking]);
-                /*make the difference clearly smaller than the material difference to indicate it is
-                tending towards draw. Note that if the king with the bishop is in the "wrong" corner, this
-                will still be greater than the difference in material.*/
-                ret /= 2;
-            } else if ((piece_info->w_rooks == 1) && (piece_info->b_knights == 1))
-                /*K+R vs. K+N: the weaker party has to keep the king as centralised as possible and
-                must keep the knight close to the king.*/
-            {
-                int _abs_diff, j;
-                /*find the black knights's position*/
-                xy = Bpieces[0].next->xy;
-
-                /*get the distance between knight and king, counted in king moves*/
-                _abs_diff = ColNum[bking] - ColNum[xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[bking] - RowNum[xy];
-                j = Abs(_abs_diff);
-                xy = (i > j) ? i : j;
-
-                xy--; /*neighbouring squares count as "no distance"*/
+                int _abs_diff, king_dist, king_col_dist, king_row_dist, def_to_move;
 
-                /*keeping the knight close.*/
-                if (xy > 0)
-                {
-                    xy *= 80;
-                    xy -= 20;
-                } else
-                    xy = 0;
-
-                tb_hits++;
-                ret = ((ROOK_V-KNIGHT_V) + KnightRook[bking] + xy)/2;
-            } else if ((piece_info->b_rooks == 1) && (piece_info->w_knights == 1))
-                /*K+R vs. K+N: the weaker party has to keep the king as centralised as possible and
-                must keep the knight close to the king.*/
-            {
-                int _abs_diff, j;
-                /*find the white knights's position*/
-                xy = Wpieces[0].next->xy;
+                _abs_diff = ColNum[wking] - ColNum[pawn_xy];
+                king_col_dist = Abs(_abs_diff);
+                _abs_diff = RowNum[wking] - RowNum[pawn_xy];
+                king_row_dist = Abs(_abs_diff);
 
-                /*get the distance between knight and king, counted in king moves*/
-                _abs_diff = ColNum[wking] - ColNum[xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[wking] - RowNum[xy];
-                j = Abs(_abs_diff);
-                xy = (i > j) ? i : j;
+                if (king_col_dist > king_row_dist)
+                    king_dist = king_col_dist;
+                else
+                    king_dist = king_row_dist;
 
-                xy--; /*neighbouring squares count as "no distance"*/
+                if (side_to_move == BLACK) def_to_move = 1; else def_to_move = 0;
+                /*if the defender, i.e. the side with the pawn, is to move, the attacking
+                  king may be closer by one square without changing the result.*/
 
-                /*keeping the knight close.*/
-                if (xy > 0)
+                if (pawn_xy == C2)
                 {
-                    xy *= 80;
-                    xy -= 20;
-                } else
-                    xy = 0;
-
-                tb_hits++;
-                ret = -((ROOK_V-KNIGHT_V) + KnightRook[wking] + xy)/2;
-            } else if ((piece_info->w_bishops == 1) && (piece_info->w_knights == 1))
-            {
-                /*find the knight*/
-                PIECE *p = Wpieces[0].next;
-                i = (p->type == WKNIGHT) ? p->xy : p->next->xy;
-                tb_hits++;
-                ret = BISHOP_V + KNIGHT_V + PAWN_V + Eval_KingKnightBishop_King(bking, wking, piece_info->w_bishop_colour, i);
-            }
-            else if ((piece_info->b_bishops == 1) && (piece_info->b_knights == 1))
-            {
-                /*find the knight*/
-                PIECE *p = Bpieces[0].next;
-                i = (p->type == BKNIGHT) ? p->xy : p->next->xy;
-                tb_hits++;
-                ret = -(BISHOP_V + KNIGHT_V + PAWN_V + Eval_KingKnightBishop_King(wking, bking, piece_info->b_bishop_colour, i));
-            } else if (piece_info->w_knights == 2)
-            {
-                int _abs_diff, j;
-                PIECE *p;
-                /*get the distance between the kings, counted in king moves*/
-                _abs_diff = ColNum[wking] - ColNum[bking];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[wking] - RowNum[bking];
-                j = Abs(_abs_diff);
-                xy = (i > j) ? i : j;
-
-                tb_hits++;
-                /*still draw, but reward forcing the black king to the border and getting the white king close.
-                maybe the opponent commits an error?*/
-                ret = (30 - KnightE[bking] - xy);
-
-                /*get the knights close*/
-
-                p = Wpieces[0].next;
-                _abs_diff = ColNum[wking] - ColNum[p->xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[wking] - RowNum[p->xy];
-                j = Abs(_abs_diff);
-                ret -= (i > j) ? i : j;
-
-                p = p->next;
-                _abs_diff = ColNum[wking] - ColNum[p->xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[wking] - RowNum[p->xy];
-                j = Abs(_abs_diff);
-                ret -= (i > j) ? i : j;
-
-                /*worst case scenario: eval is still positive*/
-            } else if (piece_info->b_knights == 2)
-            {
-                int _abs_diff, j;
-                PIECE *p;
-                /*get the distance between the kings, counted in king moves*/
-                _abs_diff = ColNum[wking] - ColNum[bking];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[wking] - RowNum[bking];
-                j = Abs(_abs_diff);               
-                xy = (i > j) ? i : j;
-
-                tb_hits++;
-                /*still draw, but reward forcing the black king to the border and getting the white king close.
-                maybe the opponent commits an error?*/
-                ret = -(30 - KnightE[wking] - xy);
-
-                /*get the knights close*/
-
-                p = Bpieces[0].next;
-                _abs_diff = ColNum[bking] - ColNum[p->xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[bking] - RowNum[p->xy];
-                j = Abs(_abs_diff);
-                ret += (i > j) ? i : j;
-
-                p = p->next;
-                _abs_diff = ColNum[bking] - ColNum[p->xy];
-                i = Abs(_abs_diff);
-                _abs_diff = RowNum[bking] - RowNum[p->xy];
-                j = Abs(_abs_diff);
-                ret += (i > j) ? i : j;
-                /*worst case scenario: eval is still negative*/
-            }
-        } else /*4 pieces without minor pieces*/
-        {
-            if ((piece_info->w_queens == 1) && (pawn_info->b_pawns == 1))
-            {
-                /*queen draws against a/c/f/h pawn on 2nd rank with close king*/
-                int pawn_xy = Bpieces[0].next->xy;
-                if (RowNum[pawn_xy] == 2)
+                    if (king_dist >= 3-def_to_move)
+                    {
+                        tb_hits++;
+                        if ((bking == B1) || (bking == B2))
+                            ret = 10;
+                        else if (bking == A1) /*only go to a1 if b2 or b1 are not possible*/
+                            ret = 15;
+                    } else ret += (16 - 8 * king_dist);
+                } else if (pawn_xy == F2)
                 {
-                    if ((pawn_xy == A2) || (pawn_xy == C2) || (pawn_xy == F2) || (pawn_xy == H2))
+                    if (king_dist >= 3-def_to_move)
                     {
-                        int _abs_diff, king_dist, king_col_dist, king_row_dist, def_to_move;
-
-                        _abs_diff = ColNum[wking] - ColNum[pawn_xy];
-                        king_col_dist = Abs(_abs_diff);
-                        _abs_diff = RowNum[wking] - RowNum[pawn_xy];
-                        king_row_dist = Abs(_abs_diff);
-
-                        if (king_col_dist > king_row_dist)
-                            king_dist = king_col_dist;
-                        else
-                            king_dist = king_row_dist;
-
-                        if (side_to_move == BLACK) def_to_move = 1; else def_to_move = 0;
-                        /*if the defender, i.e. the side with the pawn, is to move, the attacking
-                          king may be closer by one square without changing the result.*/
-
-                        if (pawn_xy == C2)
-                        {
-                            if (king_dist >= 3-def_to_move)
-                            {
-                                tb_hits++;
-                                if ((bking == B1) || (bking == B2))
-                                    ret = 10;
-                                else if (bking == A1) /*only go to a1 if b2 or b1 are not possible*/
-                                    ret = 15;
-                            } else ret += (16 - 8 * king_dist);
-                        } else if (pawn_xy == F2)
-                        {
-                            if (king_dist >= 3-def_to_move)
-                            {
-                                tb_hits++;
-                                if ((bking == G1) || (bking == G2))
-                                    ret = 10;
-                                else if (bking == H1) /*only go to h1 if g2 or g1 are not possible*/
-                                    ret = 15;
-                            } else ret += (16 - 8 * king_dist);
-                        } else if (pawn_xy == A2)
-                        {
-                            if ((bking == A1) && (def_to_move) &&
-                                (((ColNum[Wpieces[0].next->xy] == BOARD_B_FILE) && (RowNum[Wpieces[0].next->xy] >= 3)) ||
-                                (Wpieces[0].next->xy == C2) || (king_dist >= 5)))
-                            /*stalemate conditions or attacking king far enough away to get out of the corner*/
-                            {
-                                tb_hits++;
-                                ret = 10;
-                            } else if (king_dist >= 5-def_to_move)
-                            {
-                                if ((bking == B1) || (bking == B2) ||
-                                    ((bking == A1) && (ColNum[Wpieces[0].next->xy] == BOARD_B_FILE)))
-                                {
-                                    tb_hits++;
-                                    ret = 10;
-                                }
-                            } else ret += (40 - 8 * king_dist);
-                        } else if (pawn_xy == H2)
+                        tb_hits++;
+                        if ((bking == G1) || (bking == G2))
+                            ret = 10;
+                        else if (bking == H1) /*only go to h1 if g2 or g1 are not possible*/
+                            ret = 15;
+                    } else ret += (16 - 8 * king_dist);
+                } else if (pawn_xy == A2)
+                {
+                    if ((bking == A1) && (def_to_move) &&
+                        (((ColNum[Wpieces[0].next->xy] == BOARD_B_FILE) && (RowNum[Wpieces[0].next->xy] >= 3)) ||
+                        (Wpieces[0].next->xy == C2) || (king_dist >= 5)))
+                    /*stalemate conditions or attacking king far enough away to get out of the corner*/
+                    {
+                        tb_hits++;
+                        ret = 10;
+                    } else if (king_dist >= 5-def_to_move)
+                    {
+                        if ((bking == B1) || (bking == B2) ||
+                            ((bking == A1) && (ColNum[Wpieces[0].next->xy] == BOARD_B_FILE)))
                         {
-                            if ((bking == H1) && (def_to_move) &&
-                                (((ColNum[Wpieces[0].next->xy] == BOARD_G_FILE) && (RowNum[Wpieces[0].next->xy] >= 3)) ||
-                                (Wpieces[0].next->xy == F2) || (king_dist >= 5)))
-                            /*stalemate conditions or attacking king far enough away to get out of the corner*/
-                            {
-                                tb_hits++;
-                                ret = 10;
-                            } else if (king_dist >= 5-def_to_move)
-                            {
-                                if ((bking == G1) || (bking == G2) ||
-                                    ((bking == H1) && (ColNum[Wpieces[0].next->xy] == BOARD_G_FILE)))
-                                {
-                                    tb_hits++;
-                                    ret = 10;
-                                }
-                            } else ret += (40 - 8 * king_dist);
+                            tb_hits++;
+                            ret = 10;
                         }
-                    }
-                }
-            } else if ((piece_info->b_queens == 1) && (pawn_info->w_pawns == 1))
-            {
-                /*queen draws against a/c/f/h pawn on 7th rank with close king*/
-                int pawn_xy = Wpieces[0].next->xy;
-                if (RowNum[pawn_xy] == 7)
+                    } else ret += (40 - 8 * king_dist);
+                } else if (pawn_xy == H2)
                 {
-                    if ((pawn_xy == A7) || (pawn_xy == C7) || (pawn_xy == F7) || (pawn_xy == H7))
+                    if ((bking == H1) && (def_to_move) &&
+                        (((ColNum[Wpieces[0].next->xy] == BOARD_G_FILE) && (RowNum[Wpieces[0].next->xy] >= 3)) ||
+                        (Wpieces[0].next->xy == F2) || (king_dist >= 5)))
+                    /*stalemate conditions or attacking king far enough away to get out of the corner*/
                     {
-                        int _abs_diff, king_dist, king_col_dist, king_row_dist, def_to_move;
-
-                        _abs_diff = ColNum[bking] - ColNum[pawn_xy];
-                        king_col_dist = Abs(_abs_diff);
-                        _abs_diff = RowNum[bking] - RowNum[pawn_xy];
-                        king_row_dist = Abs(_abs_diff);
-
-                        if (king_col_dist > king_row_dist)
-                            king_dist = king_col_dist;
-                        else
-                            king_dist = king_row_dist;
-
-                        if (side_to_move == WHITE) def_to_move = 1; else def_to_move = 0;
-                        /*if the defender, i.e. the side with the pawn, is to move, the attacking
-                          king may be closer by one square without changing the result.*/
-
-                        if (pawn_xy == C7)
-                        {
-                            if (king_dist >= 3-def_to_move)
-                            {
-                                tb_hits++;
-                                if ((wking == B8) || (wking == B7))
-                                    ret = -10;
-                                else if (wking == A8) /*only go to a8 if b7 or b8 are not possible*/
-                                    ret = -15;
-                            } else ret -= (16 - 8 * king_dist);
-                        } else if (pawn_xy == F7)
-                        {
-                            if (king_dist >= 3-def_to_move)
-                            {
-                                tb_hits++;
-                                if ((wking == G8) || (wking == G7))
-                                    ret = -10;
-                                else if (wking == H8) /*only go to h8 if g7 or g8 are not possible*/
-                                    ret = -15;
-                            } else ret -= (16 - 8 * king_dist);
-                        } else if (pawn_xy == A7)
-                        {
-                            if ((wking == A8) && (def_to_move) &&
-                                (((ColNum[Bpieces[0].next->xy] == BOARD_B_FILE) && (RowNum[Bpieces[0].next->xy] <= 6)) ||
-                                (Bpieces[0].next->xy == C7) || (king_dist >= 5)))
-                            /*stalemate conditions or attacking king far enough away to get out of the corner*/
-                            {
-                                tb_hits++;
-                                ret = -10;
-                            } else if (king_dist >= 5-def_to_move)
-                            {
-                                if ((wking == B8) || (wking == B7) ||
-                                    ((wking == A8) && (ColNum[Bpieces[0].next->xy] == BOARD_B_FILE)))
-                                {
-                                    tb_hits++;
-                                    ret = -10;
-                                }
-                            } else ret -= (40 - 8 * king_dist);
-                        } else if (pawn_xy == H7)
+                        tb_hits++;
+                        ret = 10;
+                    } else if (king_dist >= 5-def_to_move)
+                    {
+                        if ((bking == G1) || (bking == G2) ||
+                            ((bking == H1) && (ColNum[Wpieces[0].next->xy] == BOARD_G_FILE)))
                         {
-                            if ((wking == H8) && (def_to_move) &&
-                                (((ColNum[Bpieces[0].next->xy] == BOARD_G_FILE) && (RowNum[Bpieces[0].next->xy] <= 6)) ||
-                                (Bpieces[0].next->xy == F7) || (king_dist >= 5)))
-                            /*stalemate conditions or attacking king far enough away to get out of the corner*/
-                            {
-                                tb_hits++;
-                                ret = -10;
-                            } else if (king_dist >= 5-def_to_move)
-                            {
-                                if ((wking == G8) || (wking == G7) ||
-                                    ((wking == H8) && (ColNum[Bpieces[0].next->xy] == BOARD_G_FILE)))
-                                {
-                                    tb_hits++;
-                                    ret = -10;
-                                }
-                            } else ret -= (40 - 8 * king_dist);
+                            tb_hits++;
+                            ret = 10;
                         }
-                    }
+                    } else ret += (40 - 8 * king_dist);
                 }
-            } else if ((piece_info->w_rooks == 1) && (pawn_info->b_pawns == 1))
+            }
+        }
+    } else if (eg_mat->eg_type == EG_KPKQ)
+    {
+        /*queen draws against a/c/f/h pawn on 7th rank with close king*/
+        int pawn_xy = Wpieces[0].next->xy;
+        if (RowNum[pawn_xy] == 7)
+        {
+            if ((pawn_xy == A7) || (pawn_xy == C7) || (pawn_xy == F7) || (pawn_xy == H7))
             {
-                /*since draw with queen against a/c/f/h pawn is implemented,
-                  rook against pawn on 2nd/7th rank also has to be there because otherwise,
-                  the engine would underpromote to a rook.*/
-                int pawn_xy = Bpieces[0].next->xy;
-                if (RowNum[pawn_xy] == 2)
-                {
-                    int _abs_diff, def_king_pawn_dist, king_col_dist, king_row_dist;
+                int _abs_diff, king_dist, king_col_dist, king_row_dist, def_to_move;
 
-                    /*distance of defending king to promotion square*/
-                    _abs_diff = ColNum[bking] - ColNum[pawn_xy];
-                    king_col_dist = Abs(_abs_diff);
-                    _abs_diff = RowNum[bking] - RowNum[pawn_xy-10];
-                    king_row_dist = Abs(_abs_diff);
+                _abs_diff = ColNum[bking] - ColNum[pawn_xy];
+                king_col_dist = Abs(_abs_diff);
+                _abs_diff = RowNum[bking] - RowNum[pawn_xy];
+                king_row_dist = Abs(_abs_diff);
 
-                    if (king_col_dist > king_row_dist)
-                        def_king_pawn_dist = king_col_dist;
-                    else
-                        def_king_pawn_dist = king_row_dist;
+                if (king_col_dist > king_row_dist)
+                    king_dist = king_col_dist;
+                else
+                    king_dist = king_row_dist;
 
-                    /*if the rook side could take the pawn while not losing the rook,
-                      then quiescence search would not have lead to KRKP.*/
-                    if (def_king_pawn_dist <= 2)
+                if (side_to_move == WHITE) def_to_move = 1; else def_to_move = 0;
+                /*if the defender, i.e. the side with the pawn, is to move, the attacking
+                  king may be closer by one square without changing the result.*/
+
+                if (pawn_xy == C7)
+                {
+                    if (king_dist >= 3-def_to_move)
                     {
-                        int att_king_pawn_dist;
-                        /*distance from attacking king to promotion square*/
-                        _abs_diff = ColNum[wking] - ColNum[pawn_xy];
-                        king_col_dist = Abs(_abs_diff);
-                        _abs_diff = RowNum[wking] - RowNum[pawn_xy-10];
-                        king_row_dist = Abs(_abs_diff);
-
-                        if (king_col_dist > king_row_dist)
-                            att_king_pawn_dist = king_col_dist;
-                        else
-                            att_king_pawn_dist = king_row_dist;
-
-                        if (bking == pawn_xy - 10) att_king_pawn_dist--;
-                        if (side_to_move == WHITE) att_king_pawn_dist--;
-
-                        if (att_king_pawn_dist >= def_king_pawn_dist + 1)
-                            ret = -50;
-                    }
-                }
-            }  else if ((piece_info->b_rooks == 1) && (pawn_info->w_pawns == 1))
-            {
-                /*since draw with queen against a/c/f/h pawn is implemented,
-                  rook against pawn on 2nd/7th rank also has to be there because otherwise,
-                  the engine would underpromote to a rook.*/
-                int pawn_xy = Wpieces[0].next->xy;
-                if (RowNum[pawn_xy] == 7)
+                        tb_hits++;
+                        if ((wking == B8) || (wking == B7))
+                            ret = -10;
+                        else if (wking == A8) /*only go to a8 if b7 or b8 are not possible*/
+                            ret = -15;
+                    } else ret -= (16 - 8 * king_dist);
+                } else if (pawn_xy == F7)
                 {
-                    int _abs_diff, def_king_pawn_dist, king_col_dist, king_row_dist;
-
-                    /*distance of defending king to promotion square*/
-                    _abs_diff = ColNum[wking] - ColNum[pawn_xy];
-                    king_col_dist = Abs(_abs_diff);
-                    _abs_diff = RowNum[wking] - RowNum[pawn_xy-10];
-                    king_row_dist = Abs(_abs_diff);
-
-                    if (king_col_dist > king_row_dist)
-                        def_king_pawn_dist = king_col_dist;
-                    else
-                        def_king_pawn_dist = king_row_dist;
-
-                    /*if the rook side could take the pawn while not losing the rook,
-                      then quiescence search would not have lead to KRKP.*/
-                    if (def_king_pawn_dist <= 2)
+                    if (king_dist >= 3-def_to_move)
                     {
-                        int att_king_pawn_dist;
-                        /*distance from attacking king to promotion square*/
-                        _abs_diff = ColNum[bking] - ColNum[pawn_xy];
-                        king_col_dist = Abs(_abs_diff);
-                        _abs_diff = RowNum[bking] - RowNum[pawn_xy-10];
-                        king_row_dist = Abs(_abs_diff);
-
-                        if (king_col_dist > king_row_dist)
-                            att_king_pawn_dist = king_col_dist;
-                        else
-                            att_king_pawn_dist = king_row_dist;
-
-                        if (wking == pawn_xy + 10) att_king_pawn_dist--;
-                        if (side_to_move == BLACK) att_king_pawn_dist--;
-
-                        if (att_king_pawn_dist >= def_king_pawn_dist + 1)
-                            ret = 50;
-                    }
+                        tb_hits++;
+                        if ((wking == G8) || (wking == G7))
+                            ret = -10;
+                        else if (wking == H8) /*only go to h8 if g7 or g8 are not possible*/
+                            ret = -15;
+                    } else ret -= (16 - 8 * king_dist);
+                } else if (pawn_xy == A7)
+                {
+                    if ((wking == A8) && (def_to_move) &&
+                        (((ColNum[Bpieces[0].next->xy] == BOARD_B_FILE) && (RowNum[Bpieces[0].next->xy] <= 6)) ||
+                        (Bpieces[0].next->xy == C7) || (king_dist >= 5)))
+                    /*stalemate conditions or attacking king far enough away to get out of the corner*/
+                    {
+                        tb_hits++;
+                        ret = -10;
+                    } else if (king_dist >= 5-def_to_move)
+                    {
+                        if ((wking == B8) || (wking == B7) ||
+                            ((wking == A8) && (ColNum[Bpieces[0].next->xy] == BOARD_B_FILE)))
+                        {
+                            tb_hits++;
+                            ret = -10;
+                        }
+                    } else ret -= (40 - 8 * king_dist);
+                } else if (pawn_xy == H7)
+                {
+                    if ((wking == H8) && (def_to_move) &&
+                        (((ColNum[Bpieces[0].next->xy] == BOARD_G_FILE) && (RowNum[Bpieces[0].next->xy] <= 6)) ||
+                        (Bpieces[0].next->xy == F7) || (king_dist >= 5)))
+                    /*stalemate conditions or attacking king far enough away to get out of the corner*/
+                    {
+                        tb_hits++;
+                        ret = -10;
+                    } else if (king_dist >= 5-def_to_move)
+                    {
+                        if ((wking == G8) || (wking == G7) ||
+                            ((wking == H8) && (ColNum[Bpieces[0].next->xy] == BOARD_G_FILE)))
+                        {
+                            tb_hits++;
+                            ret = -10;
+                        }
+                    } else ret -= (40 - 8 * king_dist);
                 }
-            } else if ((piece_info->w_queens == 1) && (piece_info->b_rooks == 1))
-            {
-                /*KQ vs KR*/
-                int cdiff, rdiff, king_dist, rook_dist, rook_xy;
+            }
+        }
+    } else if (eg_mat->eg_type == EG_KRKP)
+    {
+        /*since draw with queen against a/c/f/h pawn is implemented,
+          rook against pawn on 2nd/7th rank also has to be there because otherwise,
+          the engine would underpromote to a rook.*/
+        int pawn_xy = Bpieces[0].next->xy;
+        if (RowNum[pawn_xy] == 2)
+        {
+            int _abs_diff, def_king_pawn_dist, king_col_dist, king_row_dist;
 
-                cdiff = ColNum[wking] - ColNum[bking];
-                rdiff = RowNum[wking] - RowNum[bking];
-                king_dist = Abs(cdiff) + Abs(rdiff);
+            /*distance of defending king to promotion square*/
+            _abs_diff = ColNum[bking] - ColNum[pawn_xy];
+            king_col_dist = Abs(_abs_diff);
+            _abs_diff = RowNum[bking] - RowNum[pawn_xy-10];
+            king_row_dist = Abs(_abs_diff);
 
-                rook_xy = Bpieces[0].next->xy;
-                cdiff = ColNum[rook_xy] - ColNum[bking];
-                rdiff = RowNum[rook_xy] - RowNum[bking];
-                rook_dist = Abs(cdiff) + Abs(rdiff);
+            if (king_col_dist > king_row_dist)
+                def_king_pawn_dist = king_col_dist;
+            else
+                def_king_pawn_dist = king_row_dist;
 
-                ret = (PAWN_V + PAWN_V/2 + QUEEN_V - ROOK_V) + (CentreDist[bking] << 1) - (king_dist << 3) + (rook_dist << 2);
-            }  else if ((piece_info->b_queens == 1) && (piece_info->w_rooks == 1))
+            /*if the rook side could take the pawn while not losing the rook,
+              then quiescence search would not have lead to KRKP.*/
+            if (def_king_pawn_dist <= 2)
             {
-                /*KR vs KQ*/
-                int cdiff, rdiff, king_dist, rook_dist, rook_xy;
-
-                cdiff = ColNum[wking] - ColNum[bking];
-                rdiff = RowNum[wking] - RowNum[bking];
-                king_dist = Abs(cdiff) + Abs(rdiff);
+                int att_king_pawn_dist;
+                /*distance from attacking king to promotion square*/
+                _abs_diff = ColNum[wking] - ColNum[pawn_xy];
+                king_col_dist = Abs(_abs_diff);
+                _abs_diff = RowNum[wking] - RowNum[pawn_xy-10];
+                king_row_dist = Abs(_abs_diff);
+
+                if (king_col_dist > king_row_dist)
+                    att_king_pawn_dist = king_col_dist;
+                else
+                    att_king_pawn_dist = king_row_dist;
 
-                rook_xy = Wpieces[0].next->xy;
-                cdiff = ColNum[rook_xy] - ColNum[wking];
-                rdiff = RowNum[rook_xy] - RowNum[wking];
-                rook_dist = Abs(cdiff) + Abs(rdiff);
+                if (bking == pawn_xy - 10) att_king_pawn_dist--;
+                if (side_to_move == WHITE) att_king_pawn_dist--;
 
-                ret = -((PAWN_V + PAWN_V/2 + QUEEN_V - ROOK_V) + (CentreDist[wking] << 1) - (king_dist << 3) + (rook_dist << 2));
-            } 
-        } /*end of 4 pieces without minor pieces*/
-    } else if (piece_info->all_pieces == 3)
+                if (att_king_pawn_dist >= def_king_pawn_dist + 1)
+                    ret = -50;
+            }
+        }
+    } else if (eg_mat->eg_type == EG_KPKR)
     {
-        if (pawn_info->all_pawns == 1) /*Kp vs K or K vs Kp*/
+        /*since draw with queen against a/c/f/h pawn is implemented,
+          rook against pawn on 2nd/7th rank also has to be there because otherwise,
+          the engine would underpromote to a rook.*/
+        int pawn_xy = Wpieces[0].next->xy;
+        if (RowNum[pawn_xy] == 7)
         {
-            int is_won;
-            tb_hits++;
-            if (pawn_info->w_pawns == 1) /*Kp vs K*/
-            {
-                /*find the white pawn*/
-                xy = Wpieces[0].next->xy;
+            int _abs_diff, def_king_pawn_dist, king_col_dist, king_row_dist;
 
-                if (side_to_move == WHITE) /*white to move*/
-                    is_won = Kpk_Probe(0, boardXY[wking], boardXY[xy], boardXY[bking]);
-                else
-                    is_won = Kpk_Probe(1, boardXY[wking], boardXY[xy], boardXY[bking]);
+            /*distance of defending king to promotion square*/
+            _abs_diff = ColNum[wking] - ColNum[pawn_xy];
+            king_col_dist = Abs(_abs_diff);
+            _abs_diff = RowNum[wking] - RowNum[pawn_xy-10];
+            king_row_dist = Abs(_abs_diff);
 
-                if (is_won == 0)
-                {
-                    /*if the computer has the pawn advantage, it is still draw, but push the pawn
-                    forward because that will force the game to the end much faster, and maybe the opponent
-                    goes wrong.*/
-                    ret = (2+(RowNum[xy]-2)*2);
-                }
-                else
-                {
-                    /*this is won, and a won position is better if the pawn is more advanced.
-                    but it must be worth less than a queen to reward promotion.*/
-                    ret = (ROOK_V + (RowNum[xy]-2)*20);
-                }
-            } else /*K vs. Kp*/
-            {
-                /*find the black pawn*/
-                xy = Bpieces[0].next->xy;
+            if (king_col_dist > king_row_dist)
+                def_king_pawn_dist = king_col_dist;
+            else
+                def_king_pawn_dist = king_row_dist;
 
-                if (side_to_move == WHITE) /*white to move*/
-                    is_won = Kpk_Probe_Reverse(1, boardXY[wking], boardXY[xy], boardXY[bking]);
+            /*if the rook side could take the pawn while not losing the rook,
+              then quiescence search would not have lead to KRKP.*/
+            if (def_king_pawn_dist <= 2)
+            {
+                int att_king_pawn_dist;
+                /*distance from attacking king to promotion square*/
+                _abs_diff = ColNum[bking] - ColNum[pawn_xy];
+                king_col_dist = Abs(_abs_diff);
+                _abs_diff = RowNum[bking] - RowNum[pawn_xy-10];
+                king_row_dist = Abs(_abs_diff);
+
+                if (king_col_dist > king_row_dist)
+                    att_king_pawn_dist = king_col_dist;
                 else
-                    is_won = Kpk_Probe_Reverse(0, boardXY[wking], boardXY[xy], boardXY[bking]);
+                    att_king_pawn_dist = king_row_dist;
 
-                if (is_won == 0)
-                {
-                    /*if the computer has the pawn advantage, it is still draw, but push the pawn
-                    forward because that will force the game to the end much faster, and maybe the opponent
-                    goes wrong.*/
-                    ret = -(2+(7-RowNum[xy])*2);
-                }
-                else
-                {
-                    /*this is won, and a won position is better if the pawn is more advanced.
-                    but it must be worth less than a queen to reward promotion.*/
-                    ret = -(ROOK_V + (7-RowNum[xy])*20);
-                }
+                if (wking == pawn_xy + 10) att_king_pawn_dist--;
+                if (side_to_move == BLACK) att_king_pawn_dist--;
+
+                if (att_king_pawn_dist >= def_king_pawn_dist + 1)
+                    ret = 50;
             }
-        } else if (piece_info->w_rooks == 1) /*K+R vs. K*/
-        {
-            tb_hits++;
-            ret = Eval_KingRook_King(bking, wking, Wpieces[0].next->xy);
-        } else if (piece_info->b_rooks == 1) /*K vs. K+R*/
-        {
-            tb_hits++;
-            ret = -Eval_KingRook_King(wking, bking, Bpieces[0].next->xy);
-        } else if (piece_info->w_queens == 1)
-        {
-            tb_hits++;
-            ret = Eval_KingQueen_King(bking, wking);
-        } else if (piece_info->b_queens == 1)
-        {
-            tb_hits++;
-            ret = -Eval_KingQueen_King(wking, bking);
         }
-    } else if ((piece_info->all_pieces == 5) && (piece_info->all_minor_pieces == 3))
+    }
+
+    /*e.g. two minor pieces against one.*/
+    if (eg_mat->scale > 1U)
     {
-        if ((piece_info->w_knights+piece_info->w_bishops > 0) && (piece_info->b_knights+piece_info->b_bishops > 0))
-            /*technically, KBBKN is a win, but only with tablebases. Even grandmasters have overlooked this
-            until the arrival of tablebases. If an opponent has tablebases, that means it is a PC program,
-            and with the computing power and the big hash tables of a PC, the opponent would have won long
-            before this endgame situation could arise anyway.*/
-        {
-            tb_hits++;
-            ret /= 10;
-        }
+        tb_hits++;
+        ret /= (int) eg_mat->scale;
     }
     *current_eval = ret;
 }
@@ -3928,9 +4064,8 @@ int Eval_Is_Light_Square(int square)
 void Eval_Init_Pawns(void)
 {
     int i;
-    for (i=0; i<120; i++) {
-        W_Pawn_E[i] = B_Pawn_E[i] = 0;
-    }
+
+    memset(psq_table, 0, sizeof(psq_table));
 
     for (i=0; i<64; i++) {
         int ret;
@@ -3942,7 +4077,7 @@ void Eval_Init_Pawns(void)
         if (xy >= A5) ret += 2;
         if (xy >= A6) ret += 5;
         if (xy >= A7) ret += 20;
-        W_Pawn_E[xy] = ret;
+        psq_table[WPAWN][xy] = ret;
         ret=0;
         if ((xy==D7) || (xy==E7)) ret += 8;
         if (xy==C7) ret += 6;
@@ -3950,7 +4085,77 @@ void Eval_Init_Pawns(void)
         if (xy<=H4) ret -= 2;
         if (xy<=H3) ret -= 5;
         if (xy<=H2) ret -= 20;
-        B_Pawn_E[xy] = ret;
+        psq_table[BPAWN][xy] = ret;
+
+        psq_table[WKNIGHT][xy] =  KnightE[xy];
+        psq_table[BKNIGHT][xy] = -KnightE[xy];
+        psq_table[WBISHOP][xy] =  BishopE[xy];
+        psq_table[BBISHOP][xy] = -BishopE[xy];
+    }
+}
+
+/*fills the material table with all combinations of up to three pieces
+besides the kings.*/
+void Eval_Init_Material(void)
+{
+    static const int types[10] = {WPAWN, WKNIGHT, WBISHOP, WROOK, WQUEEN,
+                                  BPAWN, BKNIGHT, BBISHOP, BROOK, BQUEEN};
+    static const int values[10] = {PAWN_V, KNIGHT_V, BISHOP_V, ROOK_V, QUEEN_V,
+                                   -PAWN_V, -KNIGHT_V, -BISHOP_V, -ROOK_V, -QUEEN_V};
+    int a, b, c;
+
+    for (a = 0; a < (int) EG_MAT_TABLE_SIZE; a++)
+        eg_mat_table[a].piece_cnt = EG_MAT_TABLE_EMPTY;
+
+    /*index 10 means no piece, and the indices are ordered to get every
+    combination only once.*/
+    for (a = 0; a <= 10; a++)
+    {
+        for (b = a; b <= 10; b++)
+        {
+            for (c = b; c <= 10; c++)
+            {
+                PAWN_INFO pawn_info;
+                PIECE_INFO piece_info;
+                EG_MATERIAL_ST eg_mat;
+                uint64_t piece_cnt = 0;
+                int counts[10] = {0};
+                int material = 0;
+                unsigned int idx;
+
+                if (a < 10) {counts[a]++; piece_cnt += PCNT_ONE(types[a]); material += values[a];}
+                if (b < 10) {counts[b]++; piece_cnt += PCNT_ONE(types[b]); material += values[b];}
+                if (c < 10) {counts[c]++; piece_cnt += PCNT_ONE(types[c]); material += values[c];}
+
+                memset(&pawn_info, 0, sizeof(pawn_info));
+                memset(&piece_info, 0, sizeof(piece_info));
+                pawn_info.w_pawns     = counts[0];
+                piece_info.w_knights  = counts[1];
+                piece_info.w_bishops  = counts[2];
+                piece_info.w_rooks    = counts[3];
+                piece_info.w_queens   = counts[4];
+                pawn_info.b_pawns     = counts[5];
+                piece_info.b_knights  = counts[6];
+                piece_info.b_bishops  = counts[7];
+                piece_info.b_rooks    = counts[8];
+                piece_info.b_queens   = counts[9];
+                pawn_info.all_pawns = pawn_info.w_pawns + pawn_info.b_pawns;
+                piece_info.white_pieces = 1 + counts[0] + counts[1] + counts[2] + counts[3] + counts[4];
+                piece_info.black_pieces = 1 + counts[5] + counts[6] + counts[7] + counts[8] + counts[9];
+                piece_info.all_pieces = piece_info.white_pieces + piece_info.black_pieces;
+                piece_info.all_rooks = counts[3] + counts[8];
+                piece_info.all_queens = counts[4] + counts[9];
+                piece_info.all_minor_pieces = counts[1] + counts[2] + counts[6] + counts[7];
+
+                Eval_Endgame_Material(&pawn_info, &piece_info, material, &eg_mat);
+                eg_mat.piece_cnt = piece_cnt;
+
+                idx = EG_MAT_INDEX(piece_cnt);
+                while (eg_mat_table[idx].piece_cnt != EG_MAT_TABLE_EMPTY)
+                    idx = (idx + 1U) & EG_MAT_TABLE_MASK;
+                eg_mat_table[idx] = eg_mat;
+            }
+        }
     }
 }
 
@@ -4016,54 +4221,74 @@ search tree.
 - write back the pawn evaluation including the middle/endgame modifications.
 There is also a bit for storing whether the pawn eval is a middle or
 endgame one. This is important during the transition from middle game to
-endgame.*/
-int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
-                           unsigned *is_endgame, unsigned *w_passed_mask, unsigned *b_passed_mask)
+endgame.
+the values at the two lazy eval stages go to material_stage and pawn_stage
+for the eval cache. they are only set in the middle game.*/
+static int Eval_Evaluate_Position(int *restrict enough_material, enum E_COLOUR side_to_move,
+                                  unsigned *is_endgame, unsigned *w_passed_mask, unsigned *b_passed_mask,
+                                  int lower, int upper, int *material_stage, int *pawn_stage)
 {
     /*use a common array to init the structs in one shot. aliasing isn't
       a problem because these structs are made up of uint32_t and int32_t,
       which are allowed to alias.
       defined as static because putting them on the stack (which would be fine)
       costs 3% performance on ARM.*/
-    static uint32_t eval_info[(sizeof(PAWN_INFO) + sizeof(PIECE_INFO))/sizeof(uint32_t)];
-    static PAWN_INFO  *pawn_info  = (PAWN_INFO *)   eval_info;
-    static PIECE_INFO *piece_info = (PIECE_INFO *) (eval_info + (sizeof(PAWN_INFO)/sizeof(uint32_t)));
+    static THREAD_LOCAL uint32_t eval_info[(sizeof(PAWN_INFO) + sizeof(PIECE_INFO))/sizeof(uint32_t)];
+    PAWN_INFO  *pawn_info  = (PAWN_INFO *)   eval_info;
+    PIECE_INFO *piece_info = (PIECE_INFO *) (eval_info + (sizeof(PAWN_INFO)/sizeof(uint32_t)));
     int ret;
     int pure_material;
     int middle_game;
-    int pawn_hash_hit;
     int total_mobility, minor_mobility = 0, rook_mobility = 0, queen_mobility = 0;
     int w_minors, b_minors;
+    uint64_t piece_cnt;
     PIECE *p;
 
     memset(eval_info, 0, sizeof(eval_info));
-
-    ret = pure_material = move_stack[mv_stack_p].material;
+#ifndef LAZY_EVAL_WINDOW
+    /*without the lazy exits, the window is not needed.*/
+    (void) lower;
+    (void) upper;
+    (void) material_stage;
+    (void) pawn_stage;
+#endif
+
+    /*material, piece-square values and piece counts are kept in the move
+      stack, so the piece lists are only needed for the mobility and the
+      bishops.*/
+    pure_material = move_stack[mv_stack_p].material;
+    ret = pure_material + move_stack[mv_stack_p].psq;
+
+    piece_cnt = move_stack[mv_stack_p].piece_cnt;
+    pawn_info->w_pawns     = PCNT_GET(piece_cnt, WPAWN);
+    piece_info->w_knights  = PCNT_GET(piece_cnt, WKNIGHT);
+    piece_info->w_bishops  = PCNT_GET(piece_cnt, WBISHOP);
+    piece_info->w_rooks    = PCNT_GET(piece_cnt, WROOK);
+    piece_info->w_queens   = PCNT_GET(piece_cnt, WQUEEN);
+    pawn_info->b_pawns     = PCNT_GET(piece_cnt, BPAWN);
+    piece_info->b_knights  = PCNT_GET(piece_cnt, BKNIGHT);
+    piece_info->b_bishops  = PCNT_GET(piece_cnt, BBISHOP);
+    piece_info->b_rooks    = PCNT_GET(piece_cnt, BROOK);
+    piece_info->b_queens   = PCNT_GET(piece_cnt, BQUEEN);
+    piece_info->white_pieces = pawn_info->w_pawns + piece_info->w_knights + piece_info->w_bishops +
+                               piece_info->w_rooks + piece_info->w_queens;
+    piece_info->black_pieces = pawn_info->b_pawns + piece_info->b_knights + piece_info->b_bishops +
+                               piece_info->b_rooks + piece_info->b_queens;
 
     for (p = Wpieces[0].next; p != NULL; p = p->next)
     {
         int p_xy;
-        piece_info->white_pieces++;
         switch (p->type)
         {
-        case WPAWN:
-            pawn_info->w_pawns++;
-            ret += W_Pawn_E[p->xy];
-            break;
         case WROOK:
             rook_mobility += p->mobility;
-            piece_info->w_rooks++;
             break;
         case WKNIGHT:
             minor_mobility += p->mobility;
-            ret += KnightE[p->xy];
-            piece_info->w_knights++;
             break;
         case WBISHOP:
             p_xy = p->xy;
             minor_mobility += p->mobility;
-            piece_info->w_bishops++;
-            ret += BishopE[p_xy];
             piece_info->w_bishop_colour |= BishopSquareColour[WhiteSq[p_xy]];
             if (p_xy == H7)
             /*poisened pawn detection - if the bishop can get out, the search will show it*/
@@ -4088,7 +4313,6 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
             break;
         case WQUEEN:
             queen_mobility += p->mobility;
-            piece_info->w_queens++;
             break;
         default:
             break;
@@ -4098,27 +4322,17 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
     for (p = Bpieces[0].next; p != NULL; p = p->next)
     {
         int p_xy;
-        piece_info->black_pieces++;
         switch (p->type)
         {
-        case BPAWN:
-            pawn_info->b_pawns++;
-            ret += B_Pawn_E[p->xy];
-            break;
         case BROOK:
             rook_mobility -= p->mobility;
-            piece_info->b_rooks++;
             break;
         case BKNIGHT:
             minor_mobility -= p->mobility;
-            ret -= KnightE[p->xy];
-            piece_info->b_knights++;
             break;
         case BBISHOP:
             p_xy = p->xy;
             minor_mobility -= p->mobility;
-            piece_info->b_bishops++;
-            ret -= BishopE[p_xy];
             piece_info->b_bishop_colour |= BishopSquareColour[WhiteSq[p_xy]];
             if (p_xy == A2)
             /*poisened pawn detection - if the bishop can get out, the search will show it*/
@@ -4142,7 +4356,6 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
             break;
         case BQUEEN:
             queen_mobility -= p->mobility;
-            piece_info->b_queens++;
             break;
         default:
             break;
@@ -4192,6 +4405,19 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
                 return(ret);
             }
         }
+#ifdef LAZY_EVAL_WINDOW
+        /*windowed eval: if even the margin for everything except the
+          material cannot bring the eval into the window, return the
+          approximate bound.*/
+        if (eval_noise == 0)
+        {
+            *material_stage = ret;
+            if (ret - LAZY_MARGIN_MATERIAL >= upper)
+                return(ret - LAZY_MARGIN_MATERIAL);
+            if (ret + LAZY_MARGIN_MATERIAL <= lower)
+                return(ret + LAZY_MARGIN_MATERIAL);
+        }
+#endif
     }
 
     w_minors = piece_info->w_bishops + piece_info->w_knights;
@@ -4316,38 +4542,65 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
     if (piece_info->b_knights >= 2)
         ret += 5;
 
-    /*now for the pawn evaluation, which maybe is in the pawn hash table.*/
+    /*now for the pawn evaluation, which maybe is in the pawn hash table.
+    the entries have both the middle game and the endgame pawn value because
+    the transition from middle game to endgame might be anywhere in the
+    search tree.*/
     uint64_t pawnkey64 = move_stack[mv_stack_p].mv_pawn_hash;
     uint32_t pawnhashupper = (uint32_t)(pawnkey64 >> 32u);
-    uint32_t pawnhashadditional = (uint32_t)((pawnkey64 >> 24u) & PTT_HASH_BITS);
+    uint16_t pawnhashmid = (uint16_t)(pawnkey64 >> 16u);
+    TT_PTT_ST *ptt_ptr = P_T_T[pawnkey64 & PMAX_TT].entry;
+    int ptt_i;
 
-    /*the endgame pawn eval has some modifications. so if we are at the transition from middlegame
-    to endgame, the pawn eval is not independent from the piece situation. since that might be
-    anywhere in the search tree, we must avoid taking a middle game pawn eval in an endgame
-    situation. that's why the middlegame bit gets fiddled into the additional bits.*/
-    if (middle_game)
-        pawnhashadditional |= PTT_MG_BIT;
-    size_t Indx = (size_t) (pawnkey64 & PMAX_TT);
-    TT_PTT_ST *ptt_ptr = &(P_T_T[Indx]);
-    TT_PTT_ROOK_ST *ptt_rook_ptr = &(P_T_T_Rooks[Indx]);
-    uint32_t ptt_val = ptt_ptr->value;
+    search_stats.pawn_probes++;
+    for (ptt_i = 0; ptt_i < PTT_BUCKET_SIZE; ptt_i++)
+    {
+        if ((ptt_ptr[ptt_i].pawn_hash_upper == pawnhashupper) && (ptt_ptr[ptt_i].pawn_hash_mid == pawnhashmid) &&
+            (ptt_ptr[ptt_i].used))
+            break;
+    }
 
-    if ((ptt_ptr->pawn_hash_upper == pawnhashupper) && ((ptt_val & (PTT_HASH_BITS | PTT_MG_BIT)) == pawnhashadditional))
+    if (ptt_i < PTT_BUCKET_SIZE)
     {
-        if (ptt_val & PTT_SIGN_BIT)
-            pawn_info->extra_pawn_val = -((int)(ptt_val & PTT_VALUE_BITS));
-        else
-            pawn_info->extra_pawn_val = (int)(ptt_val & PTT_VALUE_BITS);
-        pawn_info->w_pawn_mask = ptt_ptr->w_pawn_mask;
-        pawn_info->b_pawn_mask = ptt_ptr->b_pawn_mask;
-        pawn_info->w_rook_files = ptt_rook_ptr->w_rook_files;
-        pawn_info->b_rook_files = ptt_rook_ptr->b_rook_files;
-        pawn_hash_hit = 1;
+        search_stats.pawn_hits++;
+        ptt_ptr += ptt_i;
     } else {
-        /*not found in the hash table, so calculate.*/
-        pawn_hash_hit = 0;
+        /*not found in the hash table, so calculate. the newest entry goes
+        first in the bucket, and the oldest one drops out.*/
+        int mg_value, eg_value;
         Eval_Pawn_Evaluation(pawn_info);
+        mg_value = Eval_Middlegame_Pawn_Value(pawn_info);
+        eg_value = Eval_Endgame_Pawn_Value(pawn_info);
+
+        memmove(ptt_ptr + 1, ptt_ptr, (PTT_BUCKET_SIZE - 1) * sizeof(TT_PTT_ST));
+        ptt_ptr->pawn_hash_upper = pawnhashupper;
+        ptt_ptr->pawn_hash_mid = pawnhashmid;
+        ptt_ptr->mg_value = (int16_t) mg_value;
+        ptt_ptr->eg_value = (int16_t) eg_value;
+        ptt_ptr->w_pawn_mask = (uint8_t) pawn_info->w_pawn_mask;
+        ptt_ptr->b_pawn_mask = (uint8_t) pawn_info->b_pawn_mask;
+        ptt_ptr->w_rook_files = (uint8_t) pawn_info->w_rook_files;
+        ptt_ptr->b_rook_files = (uint8_t) pawn_info->b_rook_files;
+        ptt_ptr->used = 1U;
     }
+    pawn_info->extra_pawn_val = (middle_game) ? ptt_ptr->mg_value : ptt_ptr->eg_value;
+    pawn_info->w_pawn_mask = ptt_ptr->w_pawn_mask;
+    pawn_info->b_pawn_mask = ptt_ptr->b_pawn_mask;
+    pawn_info->w_rook_files = ptt_ptr->w_rook_files;
+    pawn_info->b_rook_files = ptt_ptr->b_rook_files;
+
+#ifdef LAZY_EVAL_WINDOW
+    /*second stage of the windowed eval, with the pawn structure.*/
+    if ((middle_game) && (eval_noise == 0))
+    {
+        int pawn_ret = ret + pawn_info->extra_pawn_val;
+        *pawn_stage = pawn_ret;
+        if (pawn_ret - LAZY_MARGIN_PAWNS >= upper)
+            return(pawn_ret - LAZY_MARGIN_PAWNS);
+        if (pawn_ret + LAZY_MARGIN_PAWNS <= lower)
+            return(pawn_ret + LAZY_MARGIN_PAWNS);
+    }
+#endif
 
     /*both middle- and endgame: knight versus bishop: are the pawns very spread?*/
     if (piece_info->all_minor_pieces == 2)
@@ -4378,7 +4631,7 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
     if (middle_game)
     {
         /*middle game specific evaluation*/
-        ret += Eval_Middlegame_Evaluation(pawn_info, piece_info, pawn_hash_hit);
+        ret += Eval_Middlegame_Evaluation(pawn_info, piece_info);
     } else
     {   /* Endgame Eval.
         unlike the other partial eval functions, this is a void return type; instead,
@@ -4394,23 +4647,11 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
         /*same for black.*/
         *b_passed_mask = ((pawn_info->b_pawn_mask) & (pawn_info->b_rook_files));
 
-        Eval_Endgame_Evaluation(pawn_info, &ret, piece_info, pawn_hash_hit, side_to_move, pure_material);
-    }
-
-    if (!pawn_hash_hit)
-    {
-        /*no cache hit, so the values were recalculated. store them in the pawn cache.*/
-        ptt_ptr->pawn_hash_upper = pawnhashupper;
+        EG_MATERIAL_ST eg_buf;
+        const EG_MATERIAL_ST *eg_mat;
 
-        /*fiddle 6 more pawn hash bits into the value*/
-        if (pawn_info->extra_pawn_val >= 0)
-            ptt_ptr->value = (uint16_t)((uint32_t)((pawn_info->extra_pawn_val)) | pawnhashadditional);
-        else
-            ptt_ptr->value = (uint16_t)((uint32_t)((-pawn_info->extra_pawn_val)) | pawnhashadditional | PTT_SIGN_BIT);
-        ptt_ptr->w_pawn_mask = (uint8_t) pawn_info->w_pawn_mask;
-        ptt_ptr->b_pawn_mask = (uint8_t) pawn_info->b_pawn_mask;
-        ptt_rook_ptr->w_rook_files = (uint8_t) pawn_info->w_rook_files;
-        ptt_rook_ptr->b_rook_files = (uint8_t) pawn_info->b_rook_files;
+        eg_mat = Eval_Get_Endgame_Material(piece_cnt, pawn_info, piece_info, pure_material, &eg_buf);
+        Eval_Endgame_Evaluation(pawn_info, &ret, piece_info, eg_mat, side_to_move);
     }
 
     /*attention to differently coloured bishops - that tends to be drawish.*/
@@ -4447,6 +4688,170 @@ int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_
     return (ret);
 }
 
+#if (EVAL_CACHE_BITS > 0)
+/*the mobility sums as used in Eval_Evaluate_Position(), packed for the
+cache key. they come from the last move generation, which depends on the
+path through the search tree and not only on the position.*/
+static uint64_t Eval_Mobility_Key(void)
+{
+    int minor_mobility = 0, rook_mobility = 0, queen_mobility = 0;
+    PIECE *p;
+
+    for (p = Wpieces[0].next; p != NULL; p = p->next)
+    {
+        switch (p->type)
+        {
+        case WROOK:
+            rook_mobility += p->mobility;
+            break;
+        case WKNIGHT:
+        case WBISHOP:
+            minor_mobility += p->mobility;
+            break;
+        case WQUEEN:
+            queen_mobility += p->mobility;
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (p = Bpieces[0].next; p != NULL; p = p->next)
+    {
+        switch (p->type)
+        {
+        case BROOK:
+            rook_mobility -= p->mobility;
+            break;
+        case BKNIGHT:
+        case BBISHOP:
+            minor_mobility -= p->mobility;
+            break;
+        case BQUEEN:
+            queen_mobility -= p->mobility;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return(((uint64_t)(uint16_t) minor_mobility) |
+           (((uint64_t)(uint16_t) rook_mobility) << 16) |
+           (((uint64_t)(uint16_t) queen_mobility) << 32));
+}
+#endif
+
+/*the static eval through the eval cache. with eval noise, the cache is
+bypassed because every call shall get new noise.
+lower and upper are the window from white's point of view. results outside
+the window may be bounds from the lazy eval and are not cached. a hit
+repeats the lazy eval exits with the stored stage values so that the
+result is the same as without the cache.*/
+static int Eval_Cached_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
+                                  unsigned *is_endgame, unsigned *w_passed_mask, unsigned *b_passed_mask,
+                                  int lower, int upper)
+{
+#if (EVAL_CACHE_BITS > 0)
+    TT_EVAL_ST *entry;
+    uint64_t key;
+    unsigned endgame, w_mask, b_mask;
+    int ret, material, material_stage, pawn_stage;
+
+    if (eval_noise != 0)
+        return(Eval_Evaluate_Position(enough_material, side_to_move, is_endgame, w_passed_mask, b_passed_mask,
+                                      lower, upper, &material_stage, &pawn_stage));
+
+    key = move_stack[mv_stack_p].mv_pos_hash ^ eval_cache_salt;
+    key ^= EVAL_CACHE_MOBILITY * Eval_Mobility_Key();
+    key ^= EVAL_CACHE_CASTLED * (uint64_t)(gflags & (WCASTLED | BCASTLED));
+    if (side_to_move == BLACK)
+        key ^= EVAL_CACHE_BLACK;
+    /*in the opening phase, the eval depends on the move counter.*/
+    if ((mv_stack_p + start_moves < 36) && (game_started_from_0))
+        key ^= EVAL_CACHE_PLY * (uint64_t)(mv_stack_p + 1);
+
+    entry = &(eval_cache[key & EVAL_CACHE_MASK]);
+    search_stats.eval_probes++;
+    if (entry->key == key)
+    {
+        search_stats.eval_hits++;
+        *enough_material = entry->enough_material;
+        *is_endgame = entry->is_endgame;
+        *w_passed_mask = entry->w_passed_mask;
+        *b_passed_mask = entry->b_passed_mask;
+        if (entry->lazy_stages)
+        {
+            if (entry->material_stage - LAZY_MARGIN_MATERIAL >= upper)
+                return(entry->material_stage - LAZY_MARGIN_MATERIAL);
+            if (entry->material_stage + LAZY_MARGIN_MATERIAL <= lower)
+                return(entry->material_stage + LAZY_MARGIN_MATERIAL);
+            if (entry->pawn_stage - LAZY_MARGIN_PAWNS >= upper)
+                return(entry->pawn_stage - LAZY_MARGIN_PAWNS);
+            if (entry->pawn_stage + LAZY_MARGIN_PAWNS <= lower)
+                return(entry->pawn_stage + LAZY_MARGIN_PAWNS);
+        }
+        return(entry->value);
+    }
+
+    /*not every path through the eval sets the endgame outputs.*/
+    endgame = w_mask = b_mask = 0;
+    material_stage = pawn_stage = EVAL_NO_STAGE;
+    ret = Eval_Evaluate_Position(&material, side_to_move, &endgame, &w_mask, &b_mask,
+                                 lower, upper, &material_stage, &pawn_stage);
+
+    if ((ret > lower) && (ret < upper))
+    {
+        entry->key = key;
+        entry->value = (int16_t) ret;
+        entry->material_stage = (int16_t) material_stage;
+        entry->pawn_stage = (int16_t) pawn_stage;
+        entry->lazy_stages = (uint8_t) (pawn_stage != EVAL_NO_STAGE);
+        entry->enough_material = (uint8_t) material;
+        entry->is_endgame = (uint8_t) endgame;
+        entry->w_passed_mask = (uint8_t) w_mask;
+        entry->b_passed_mask = (uint8_t) b_mask;
+    }
+
+    *enough_material = material;
+    *is_endgame = endgame;
+    *w_passed_mask = w_mask;
+    *b_passed_mask = b_mask;
+    return(ret);
+#else
+    int material_stage, pawn_stage;
+
+    return(Eval_Evaluate_Position(enough_material, side_to_move, is_endgame, w_passed_mask, b_passed_mask,
+                                  lower, upper, &material_stage, &pawn_stage));
+#endif
+}
+
+/*the full static eval, from white's point of view.*/
+int Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
+                           unsigned *is_endgame, unsigned *w_passed_mask, unsigned *b_passed_mask)
+{
+    return(Eval_Cached_Evaluation(enough_material, side_to_move, is_endgame, w_passed_mask, b_passed_mask,
+                                  -INFINITY_, INFINITY_));
+}
+
+/*the static eval with a window [lower, upper] from white's point of view.
+only with LAZY_EVAL_WINDOW defined at build time, the eval may stop early
+in the middle game if the cheap parts already indicate that the result is
+outside the window. a result >= upper is then meant as a lower bound of
+the full eval, and a result <= lower as an upper bound. the margins per
+stage are LAZY_MARGIN_MATERIAL and LAZY_MARGIN_PAWNS, which are
+statistical, so in rare cases the full eval would be on the other side of
+the bound. the search tree is therefore not the same as with the full
+eval. without LAZY_EVAL_WINDOW, this is the full eval.
+the endgame and passed pawn outputs are not available here.*/
+int Eval_Window_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
+                           int lower, int upper)
+{
+    unsigned dummy;
+
+    return(Eval_Cached_Evaluation(enough_material, side_to_move, &dummy, &dummy, &dummy,
+                                  lower, upper));
+}
+
 /*set up the initial material affairs before the computer starts calculating.
 calls Eval_Static_Evaluation() once so that also the pawn evaluation runs through and we can
 extract the value from the hash table.
@@ -4459,6 +4864,7 @@ int Eval_Setup_Initial_Material(void)
     int enough_material;
     int start_wqueens = 0, start_wrooks = 0, start_wminors = 0, start_wpawns = 0;
     int start_bqueens = 0, start_brooks = 0, start_bminors = 0, start_bpawns = 0;
+    int stage;
     unsigned dummy;
 
     for (p = Wpieces[0].next; p != NULL; p = p->next)
@@ -4516,9 +4922,14 @@ int Eval_Setup_Initial_Material(void)
     start_pieces = start_wqueens+start_bqueens+start_wrooks+start_brooks+start_wminors+start_bminors;
 
     /*we're just interested in the draw material evaluation.*/
-    (void) Eval_Static_Evaluation(&enough_material, computer_side, &dummy, &dummy, &dummy);
+    (void) Eval_Evaluate_Position(&enough_material, computer_side, &dummy, &dummy, &dummy,
+                                  -INFINITY_, INFINITY_, &stage, &stage);
 
     start_material = move_stack[mv_stack_p].material;
+#if (EVAL_CACHE_BITS > 0)
+    /*invalidate the eval cache for the new search context.*/
+    eval_cache_salt += 0x2545F4914F6CDD1DULL;
+#endif
     return(enough_material);
 }
 
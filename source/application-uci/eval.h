@@ -21,8 +21,11 @@
 
 int     Eval_Is_Light_Square(int square);
 void    Eval_Init_Pawns(void);
+void    Eval_Init_Material(void);
 int     Eval_Static_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
                                unsigned *is_endgame, unsigned *w_passed_mask,
                                unsigned *b_passed_mask);
+int     Eval_Window_Evaluation(int *restrict enough_material, enum E_COLOUR side_to_move,
+                               int lower, int upper);
 int     Eval_Setup_Initial_Material(void);
 void    Eval_Zero_Initial_Material(void);
@@ -22,36 +22,46 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "ctdefs.h"
 #include "util.h"
 #include "move_gen.h"
 #include "search.h"
 
+/*---------- external functions ----------*/
+extern void *Play_Alloc_Hash_Mem(size_t bytes);
+extern void Play_Free_Hash_Mem(void *mem);
+extern void Play_Clear_Hash_Mem(void *mem, size_t bytes);
+extern void *Play_Map_Hash_File(const char *file_name, uint64_t data_offset, size_t bytes);
+
 /*---------- external variables ----------*/
 /*-- READ-ONLY  --*/
-extern PIECE *board[120];
+extern THREAD_LOCAL PIECE *board[120];
 extern PIECE empty_p;
-extern PIECE Wpieces[16];
-extern PIECE Bpieces[16];
-extern int mv_stack_p;
-extern int Starting_Mv;
-extern uint16_t cstack[MAX_STACK+1];
-extern int cst_p;
-extern int fifty_moves;
-extern int en_passant_sq;
-extern unsigned int gflags;
+extern THREAD_LOCAL PIECE Wpieces[16];
+extern THREAD_LOCAL PIECE Bpieces[16];
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL int Starting_Mv;
+extern THREAD_LOCAL uint16_t cstack[MAX_STACK+1];
+extern THREAD_LOCAL int cst_p;
+extern THREAD_LOCAL int fifty_moves;
+extern THREAD_LOCAL int en_passant_sq;
+extern THREAD_LOCAL unsigned int gflags;
 extern const int8_t RowNum[120];
 extern const int8_t ColNum[120];
 extern const int8_t boardXY[120];
-extern uintptr_t MAX_TT;
-extern unsigned int hash_clear_counter;
+extern THREAD_LOCAL uintptr_t MAX_TT;
+extern int16_t psq_table[PIECEMAX][ENDSQ];
 
 /*-- READ-WRITE --*/
-extern MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL unsigned int hash_clear_counter;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
 
-extern TT_ST *T_T;
-extern TT_ST *Opp_T_T;
+extern THREAD_LOCAL TT_ST *T_T;
+extern THREAD_LOCAL TT_ST *Opp_T_T;
+extern THREAD_LOCAL TT_PTT_BUCKET_ST *P_T_T;
+extern THREAD_LOCAL uintptr_t PMAX_TT;
 
 /*---------- module global variables ----------*/
 
@@ -64,6 +74,53 @@ static unsigned int idx;
 static uint64_t hash_board[PIECEMAX][ENDSQ];
 static uint64_t hash_ep[64];
 
+#define HASH_MT_SEED       3571U
+
+/*header of the saved main hash tables. a file is only accepted for the same
+  table layout, the same table size and the same Zobrist keys.*/
+#define HASH_FILE_VERSION  1U
+
+typedef struct hash_file_hdr_st
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t tables;
+    uint32_t zobrist_seed;
+    uint32_t zobrist_crc;
+    uint32_t generation;
+    uint64_t max_tt;
+    uint64_t table_bytes;
+    uint32_t data_crc[2];
+    uint32_t hdr_crc;      /*over everything before*/
+    uint32_t reserved;
+} HASH_FILE_HDR;
+
+static const char hash_file_magic[8] = "CT800TT";
+
+#ifdef DBGTTSTALL
+#if !(defined(__x86_64__) || defined(__i386__))
+    #error "DBGTTSTALL needs the x86 time stamp counter."
+#endif
+/*a probe counts as stalled if the first access to the entry takes longer
+  than this many time stamp counter ticks, which is beyond a cache hit.*/
+#define TT_STALL_TICKS 150ULL
+THREAD_LOCAL uint64_t tt_probes, tt_stalls;
+#endif
+
+/*entries found by the TT probes of this thread. the search attributes
+  them to the node types for the statistics.*/
+THREAD_LOCAL uint64_t tt_hits;
+
+/*for the piece counts in the move stack*/
+static const uint64_t piece_cnt_table[PIECEMAX] =
+{
+    0, 0,
+    PCNT_ONE(WPAWN), PCNT_ONE(WKNIGHT), PCNT_ONE(WBISHOP), PCNT_ONE(WROOK), PCNT_ONE(WQUEEN), 0 /*king*/,
+    0, 0, 0, 0,
+    PCNT_ONE(BPAWN), PCNT_ONE(BKNIGHT), PCNT_ONE(BBISHOP), PCNT_ONE(BROOK), PCNT_ONE(BQUEEN), 0 /*king*/
+};
+
 static int signed_material_table[PIECEMAX] =
            {0, 0,  PAWN_V,  KNIGHT_V,  BISHOP_V,  ROOK_V,  QUEEN_V, 0, 0, 0,
             0, 0, -PAWN_V, -KNIGHT_V, -BISHOP_V, -ROOK_V, -QUEEN_V, 0
@@ -113,42 +170,111 @@ static uint64_t Hash_Get_Random64_MT(void)
     return ret;
 }
 
+#ifdef DBGTTSTALL
+static void Hash_Count_Stall(const void *entry)
+{
+    unsigned int aux;
+    uint64_t ticks = __builtin_ia32_rdtscp(&aux);
+    (void) *((const volatile uint8_t *) entry);
+    ticks = __builtin_ia32_rdtscp(&aux) - ticks;
+    tt_probes++;
+    if (ticks > TT_STALL_TICKS)
+        tt_stalls++;
+}
+#endif
+
 
 /*---------- global functions ----------*/
 
 
-void Hash_Clear_Tables(void)
+#ifdef TT_BUCKETS
+
+#define TT_BLACK_KEY  0x9E3779B97F4A7C15ULL
+
+size_t Hash_Get_Table_Bytes(uintptr_t max_tt)
 {
-    memset(T_T, 0,     (MAX_TT + CLUSTER_SIZE) * sizeof(TT_ST));
-    memset(Opp_T_T, 0, (MAX_TT + CLUSTER_SIZE) * sizeof(TT_ST));
+    return((max_tt + 1) * sizeof(TT_ST));
 }
 
-/*clear the oldest entries in the hash tables to deal with aging.*/
-void Hash_Cut_Tables(unsigned int clear_counter)
+/*there is only one table for both sides since the side to move is part of
+the position hash. both table pointers refer to it so that the search does
+not need to know the layout.*/
+int Hash_Alloc_Tables(uintptr_t max_tt, TT_ST **tt, TT_ST **opp_tt)
 {
-    size_t i;
+    *tt = *opp_tt = (TT_ST *) Play_Alloc_Hash_Mem(Hash_Get_Table_Bytes(max_tt));
+    return((*tt == NULL) ? 1 : 0);
+}
 
-    /*shift that over the depth length*/
-    clear_counter <<= 6;
+void Hash_Free_Tables(TT_ST *tt, TT_ST *opp_tt)
+{
+    (void) opp_tt;
+    Play_Free_Hash_Mem(tt);
+}
+
+void Hash_Clear_Tables(void)
+{
+    Play_Clear_Hash_Mem(T_T, Hash_Get_Table_Bytes(MAX_TT));
+}
 
-    for (i = 0; i < MAX_TT+CLUSTER_SIZE; i++)
+/*checks only the first DEF_MAX_TT buckets, that is the minimum size.
+only entries from the current search count since older ones are not cleared.
+returns the hash usage in permill.*/
+unsigned Hash_Get_Usage(void)
+{
+    uint32_t i;
+    uint64_t hash_used;
+    for (i = 0, hash_used = 0; i < DEF_MAX_TT; i++)
     {
-        TT_ST *ttentry;
+        int j;
+        for (j = 0; j < BUCKET_SIZE; j++)
+        {
+            unsigned int flag = T_T[i].entry[j].flag;
+            if (((flag & 0x03U) != NO_FLAG) && ((flag >> TT_GEN_SHIFT) == hash_clear_counter))
+                hash_used++;
+        }
+    }
+    hash_used = (hash_used * 1000ULL) / (DEF_MAX_TT * BUCKET_SIZE);
+    return((unsigned) hash_used);
+}
 
-        ttentry = T_T + i;
-        if (((ttentry->depth) & 0xC0) == clear_counter)
-            memset(ttentry, 0, sizeof(TT_ST));
+#else /*TT_BUCKETS*/
 
-        ttentry = Opp_T_T + i;
-        if (((ttentry->depth) & 0xC0) == clear_counter)
-            memset(ttentry, 0, sizeof(TT_ST));
+size_t Hash_Get_Table_Bytes(uintptr_t max_tt)
+{
+    return((max_tt + CLUSTER_SIZE) * sizeof(TT_ST));
+}
+
+void Hash_Free_Tables(TT_ST *tt, TT_ST *opp_tt)
+{
+    Play_Free_Hash_Mem(tt);
+    Play_Free_Hash_Mem(opp_tt);
+}
+
+/*returns 0 if OK and 1 if one of the tables cannot be allocated.*/
+int Hash_Alloc_Tables(uintptr_t max_tt, TT_ST **tt, TT_ST **opp_tt)
+{
+    *tt     = (TT_ST *) Play_Alloc_Hash_Mem(Hash_Get_Table_Bytes(max_tt));
+    *opp_tt = (TT_ST *) Play_Alloc_Hash_Mem(Hash_Get_Table_Bytes(max_tt));
+
+    if ((*tt == NULL) || (*opp_tt == NULL))
+    {
+        Hash_Free_Tables(*tt, *opp_tt);
+        *tt = *opp_tt = NULL;
+        return(1);
     }
+    return(0);
 }
 
+void Hash_Clear_Tables(void)
+{
+    Play_Clear_Hash_Mem(T_T,     Hash_Get_Table_Bytes(MAX_TT));
+    Play_Clear_Hash_Mem(Opp_T_T, Hash_Get_Table_Bytes(MAX_TT));
+}
 
 /*checks only the first DEF_MAX_TT entries, that is the minimum size. if
 the hash table is bigger, this fragment is still representative for the
-whole table.
+whole table. only entries from the current search count since older ones
+are not cleared.
 returns the hash usage in permill.*/
 unsigned Hash_Get_Usage(void)
 {
@@ -156,17 +282,59 @@ unsigned Hash_Get_Usage(void)
     uint64_t hash_used;
     for (i = 0, hash_used = 0; i < DEF_MAX_TT; i++)
     {
-        if (T_T[i].flag != 0) hash_used++;
-        if (Opp_T_T[i].flag != 0) hash_used++;
+        if ((T_T[i].flag != 0) && ((unsigned) (T_T[i].depth >> 6) == hash_clear_counter))
+            hash_used++;
+        if ((Opp_T_T[i].flag != 0) && ((unsigned) (Opp_T_T[i].depth >> 6) == hash_clear_counter))
+            hash_used++;
     }
     hash_used = (hash_used * (1000ULL / 2ULL)) / DEF_MAX_TT;
     return((unsigned) hash_used);
 }
+#endif /*TT_BUCKETS*/
+
+/*returns the number of pawn hash buckets minus 1 for the highest power of 2
+that does not exceed the given size in MB.*/
+uintptr_t Hash_Get_Pawn_TT_Max(size_t pawn_hash_size)
+{
+    uintptr_t buckets;
+
+    if (pawn_hash_size < PAWN_HASH_MIN)
+        pawn_hash_size = PAWN_HASH_MIN;
+    if (pawn_hash_size > PAWN_HASH_MAX)
+        pawn_hash_size = PAWN_HASH_MAX;
+
+    pawn_hash_size *= 1024UL * 1024UL; /*now in bytes*/
+
+    for (buckets = 1; 2 * buckets * sizeof(TT_PTT_BUCKET_ST) <= pawn_hash_size; buckets *= 2)
+    {
+        ;
+    }
+    return(buckets - 1);
+}
+
+/*the pawn hash table is per search thread. the memory is zeroed.
+returns 0 if OK and 1 if the table cannot be allocated.*/
+int Hash_Alloc_Pawn_Table(uintptr_t pmax_tt, TT_PTT_BUCKET_ST **ptt)
+{
+    *ptt = (TT_PTT_BUCKET_ST *) Play_Alloc_Hash_Mem((pmax_tt + 1) * sizeof(TT_PTT_BUCKET_ST));
+    return((*ptt == NULL) ? 1 : 0);
+}
+
+void Hash_Free_Pawn_Table(TT_PTT_BUCKET_ST *ptt)
+{
+    Play_Free_Hash_Mem(ptt);
+}
+
+void Hash_Clear_Pawn_Table(void)
+{
+    if (P_T_T != NULL)
+        Play_Clear_Hash_Mem(P_T_T, (PMAX_TT + 1) * sizeof(TT_PTT_BUCKET_ST));
+}
 
 void Hash_Init(void)
 {
     int i, j;
-    Hash_Init_Rand32_MT(3571U);
+    Hash_Init_Rand32_MT(HASH_MT_SEED);
 
     for (i = 0; i < PIECEMAX; i++) {
         for (j = 0; j < ENDSQ; j++) {
@@ -178,15 +346,195 @@ void Hash_Init(void)
     }
 }
 
+/*the tables start on HASH_FILE_PAGE boundaries in the file, and each one has
+  a free page in front of it for the memory header when it is mapped.*/
+static uint64_t Hash_File_Offset(int table, uint64_t table_bytes)
+{
+    uint64_t table_pages = (table_bytes + HASH_FILE_PAGE - 1U) / HASH_FILE_PAGE;
+    return(HASH_FILE_PAGE + (uint64_t) table * (table_pages + 1U) * HASH_FILE_PAGE);
+}
+
+static void Hash_Fill_File_Hdr(HASH_FILE_HDR *hdr)
+{
+    memset(hdr, 0, sizeof(HASH_FILE_HDR));
+    memcpy(hdr->magic, hash_file_magic, sizeof(hdr->magic));
+    hdr->version = HASH_FILE_VERSION;
+    hdr->entry_size = sizeof(TT_ST);
+    hdr->tables = TT_TABLES;
+    hdr->zobrist_seed = HASH_MT_SEED;
+    hdr->zobrist_crc = Util_Crc32(hash_board, sizeof(hash_board)) ^ Util_Crc32(hash_ep, sizeof(hash_ep));
+    hdr->generation = hash_clear_counter;
+    hdr->max_tt = MAX_TT;
+    hdr->table_bytes = Hash_Get_Table_Bytes(MAX_TT);
+}
+
+static enum E_HASH_FILE Hash_Check_File_Hdr(const HASH_FILE_HDR *hdr)
+{
+    HASH_FILE_HDR ref_hdr;
+
+    Hash_Fill_File_Hdr(&ref_hdr);
+    if ((memcmp(hdr->magic, ref_hdr.magic, sizeof(ref_hdr.magic)) != 0) ||
+        (hdr->hdr_crc != Util_Crc32(hdr, offsetof(HASH_FILE_HDR, hdr_crc))) ||
+        (hdr->version != ref_hdr.version) || (hdr->entry_size != ref_hdr.entry_size) ||
+        (hdr->tables != ref_hdr.tables) || (hdr->generation > MAX_AGE_CNT))
+        return(HASH_FILE_FORMAT);
+    /*with other random keys, the stored positions would be garbage.*/
+    if ((hdr->zobrist_seed != ref_hdr.zobrist_seed) || (hdr->zobrist_crc != ref_hdr.zobrist_crc))
+        return(HASH_FILE_KEYS);
+    if ((hdr->max_tt != ref_hdr.max_tt) || (hdr->table_bytes != ref_hdr.table_bytes))
+        return(HASH_FILE_SIZE);
+    return(HASH_FILE_OK);
+}
+
+/*no fseek() between the tables because that only takes a long, which may
+  have 32 bits even with 64 bit builds.*/
+static int Hash_File_Pad(FILE *hash_file, uint64_t len)
+{
+    static const uint8_t zeros[1024];
+    while (len > 0)
+    {
+        size_t chunk = (len > sizeof(zeros)) ? sizeof(zeros) : (size_t) len;
+        if (fwrite(zeros, 1, chunk, hash_file) != chunk)
+            return(1);
+        len -= chunk;
+    }
+    return(0);
+}
+
+static int Hash_File_Skip(FILE *hash_file, uint64_t len)
+{
+    uint8_t skip_buf[1024];
+    while (len > 0)
+    {
+        size_t chunk = (len > sizeof(skip_buf)) ? sizeof(skip_buf) : (size_t) len;
+        if (fread(skip_buf, 1, chunk, hash_file) != chunk)
+            return(1);
+        len -= chunk;
+    }
+    return(0);
+}
+
+/*saves the main hash tables together with a header for checking them when
+  loading.*/
+enum E_HASH_FILE Hash_Save_Tables(const char *file_name)
+{
+    HASH_FILE_HDR hdr;
+    TT_ST *tables[2];
+    uint64_t file_pos;
+    enum E_HASH_FILE ret = HASH_FILE_OK;
+    FILE *hash_file;
+    int i;
+
+    tables[0] = T_T;
+    tables[1] = Opp_T_T;
+    Hash_Fill_File_Hdr(&hdr);
+    for (i = 0; i < TT_TABLES; i++)
+        hdr.data_crc[i] = Util_Crc32(tables[i], (size_t) hdr.table_bytes);
+    hdr.hdr_crc = Util_Crc32(&hdr, offsetof(HASH_FILE_HDR, hdr_crc));
+
+    hash_file = fopen(file_name, "wb");
+    if (hash_file == NULL)
+        return(HASH_FILE_OPEN);
+
+    if (fwrite(&hdr, sizeof(hdr), 1, hash_file) != 1)
+        ret = HASH_FILE_IO;
+    file_pos = sizeof(hdr);
+    for (i = 0; (i < TT_TABLES) && (ret == HASH_FILE_OK); i++)
+    {
+        uint64_t table_pos = Hash_File_Offset(i, hdr.table_bytes);
+        if ((Hash_File_Pad(hash_file, table_pos - file_pos)) ||
+            (fwrite(tables[i], (size_t) hdr.table_bytes, 1, hash_file) != 1))
+            ret = HASH_FILE_IO;
+        file_pos = table_pos + hdr.table_bytes;
+    }
+    if (fclose(hash_file) != 0)
+        ret = HASH_FILE_IO;
+    return(ret);
+}
+
+/*loads the main hash tables if the file matches the current tables.
+  with map_file, the tables are mapped from the file where the platform
+  supports that. only the header is checked then because computing the
+  checksum would read the whole file, which is what mapping avoids.
+  otherwise, the tables are read and checked. if the data turn out to be
+  bad, the tables are cleared.*/
+enum E_HASH_FILE Hash_Load_Tables(const char *file_name, int map_file)
+{
+    HASH_FILE_HDR hdr;
+    TT_ST *tables[2];
+    uint64_t file_pos;
+    enum E_HASH_FILE ret;
+    FILE *hash_file;
+    int i;
+
+    hash_file = fopen(file_name, "rb");
+    if (hash_file == NULL)
+        return(HASH_FILE_OPEN);
+
+    if (fread(&hdr, sizeof(hdr), 1, hash_file) != 1)
+        ret = HASH_FILE_FORMAT;
+    else
+        ret = Hash_Check_File_Hdr(&hdr);
+
+    if ((ret == HASH_FILE_OK) && (map_file))
+    {
+        int mapped = 0;
+        for (i = 0; i < TT_TABLES; i++)
+        {
+            tables[i] = (TT_ST *) Play_Map_Hash_File(file_name, Hash_File_Offset(i, hdr.table_bytes),
+                                                     (size_t) hdr.table_bytes);
+            if (tables[i] != NULL)
+                mapped++;
+        }
+        if (mapped == TT_TABLES)
+        {
+            (void) fclose(hash_file);
+            Hash_Free_Tables(T_T, Opp_T_T);
+            T_T = tables[0];
+            Opp_T_T = tables[TT_TABLES - 1];
+            hash_clear_counter = hdr.generation;
+            return(HASH_FILE_MAPPED);
+        }
+        /*not possible here, so read the file instead.*/
+        for (i = 0; i < TT_TABLES; i++)
+            Play_Free_Hash_Mem(tables[i]);
+    }
+
+    tables[0] = T_T;
+    tables[1] = Opp_T_T;
+    file_pos = sizeof(hdr);
+    for (i = 0; (i < TT_TABLES) && (ret == HASH_FILE_OK); i++)
+    {
+        uint64_t table_pos = Hash_File_Offset(i, hdr.table_bytes);
+        if ((Hash_File_Skip(hash_file, table_pos - file_pos)) ||
+            (fread(tables[i], (size_t) hdr.table_bytes, 1, hash_file) != 1))
+            ret = HASH_FILE_IO;
+        else if (Util_Crc32(tables[i], (size_t) hdr.table_bytes) != hdr.data_crc[i])
+            ret = HASH_FILE_CRC;
+        file_pos = table_pos + hdr.table_bytes;
+    }
+    (void) fclose(hash_file);
+
+    if (ret == HASH_FILE_OK)
+        hash_clear_counter = hdr.generation;
+    else if ((ret == HASH_FILE_IO) || (ret == HASH_FILE_CRC))
+        Hash_Clear_Tables();
+    return(ret);
+}
+
 void Hash_Init_Stack(void)
 {
     uint64_t ret;
     uint64_t tmp;
     int i;
     ret = move_stack[0].mv_pawn_hash = move_stack[0].material = 0;
+    move_stack[0].piece_cnt = 0;
+    move_stack[0].psq = 0;
     for (i = 0; i < 16; i++) {
         if (Wpieces[i].xy) {
             move_stack[0].material += signed_material_table[Wpieces[i].type];
+            move_stack[0].piece_cnt += piece_cnt_table[Wpieces[i].type];
+            move_stack[0].psq += psq_table[Wpieces[i].type][Wpieces[i].xy];
             tmp = hash_board[ Wpieces[i].type ][Wpieces[i].xy];
             if (Wpieces[i].type == WPAWN) {
                 move_stack[0].mv_pawn_hash ^= tmp;
@@ -195,6 +543,8 @@ void Hash_Init_Stack(void)
         }
         if (Bpieces[i].xy) {
             move_stack[0].material += signed_material_table[Bpieces[i].type];
+            move_stack[0].piece_cnt += piece_cnt_table[Bpieces[i].type];
+            move_stack[0].psq += psq_table[Bpieces[i].type][Bpieces[i].xy];
             tmp = hash_board[ Bpieces[i].type ][Bpieces[i].xy];
             if (Bpieces[i].type == BPAWN) {
                 move_stack[0].mv_pawn_hash ^= tmp;
@@ -348,27 +698,36 @@ uint64_t Hash_Get_Position_Value(uint64_t *pawn_hash)
     tmp_pawn_hash = p_prev->mv_pawn_hash;
     ptype = board[xy2]->type;
     p->material = p_prev->material;
+    p->piece_cnt = p_prev->piece_cnt;
+    p->psq = p_prev->psq + psq_table[ptype][xy2];
     if (p->special == NORMAL)
     {
         ret ^= hash_board[ ptype ][xy1];
+        p->psq -= psq_table[ ptype ][xy1];
         if (ptype==WPAWN || ptype==BPAWN)
             tmp_pawn_hash ^= hash_board[ ptype ][xy1];
     } else if (p->special == PROMOT)
     {
         p->material += signed_material_table[ptype];
+        p->piece_cnt += piece_cnt_table[ptype];
         if (ptype > BLACK)
         {
             p->material += PAWN_V;
+            p->piece_cnt -= PCNT_ONE(BPAWN);
+            p->psq -= psq_table[ BPAWN ][xy1];
             ret ^= hash_board[ BPAWN ][xy1];
             tmp_pawn_hash ^= hash_board[ BPAWN ][xy1];
         } else
         {
             p->material -= PAWN_V;
+            p->piece_cnt -= PCNT_ONE(WPAWN);
+            p->psq -= psq_table[ WPAWN ][xy1];
             ret ^= hash_board[ WPAWN ][xy1];
             tmp_pawn_hash ^= hash_board[ WPAWN ][xy1];
         }
     } else if (p->special == CASTL)
     {
+        /*kings and rooks have no piece-square values here.*/
         ret ^= hash_board[ ptype ][xy1];
         if (xy2==G1)
         {
@@ -392,6 +751,8 @@ uint64_t Hash_Get_Position_Value(uint64_t *pawn_hash)
     if (ptype)
     {
         p->material -= signed_material_table[ptype];
+        p->piece_cnt -= piece_cnt_table[ptype];
+        p->psq -= psq_table[ptype][p->capt];
         ret ^= hash_board[ ptype ][p->capt];
         if (ptype==WPAWN || ptype==BPAWN)
             tmp_pawn_hash ^= hash_board[ ptype ][p->capt];
@@ -415,6 +776,175 @@ uint64_t Hash_Get_Position_Value(uint64_t *pawn_hash)
     return ret;
 }
 
+#ifdef TT_BUCKETS
+
+int Hash_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int pdepth, uint64_t pos_hash, int *valueP, MOVE* hmvp)
+{
+    int i;
+    const TT_ENTRY_ST *ttentry;
+    uint32_t key_upper;
+    uint16_t key_mid;
+
+    /*the null move keeps the position hash, so the side to move must be
+    part of the key. the cluster layout has one table per side instead.*/
+    if (colour == BLACK)
+        pos_hash ^= TT_BLACK_KEY;
+    key_upper = (uint32_t) (pos_hash >> 32);
+    key_mid = (uint16_t) ((pos_hash >> 16) & 0xFFFFU);
+
+    ttentry = tt[pos_hash & MAX_TT].entry;
+#ifdef DBGTTSTALL
+    Hash_Count_Stall(ttentry);
+#endif
+    for (i = 0; i < BUCKET_SIZE; i++, ttentry++)
+    {
+        if ((ttentry->pos_hash_upper == key_upper) && (ttentry->pos_hash_mid == key_mid) &&
+            ((ttentry->flag & 0x03U) != NO_FLAG)) /*hit*/
+        {
+            if (ttentry->cmove)
+            {
+                MOVE tt_move = Mvgen_Decompress_Move(ttentry->cmove);
+                if (UNLIKELY(Mvgen_Check_Move_Legality(tt_move, colour) == 0))
+                    continue;
+                *hmvp = tt_move;
+            }
+            tt_hits++;
+            if ((int) ttentry->depth >= pdepth)
+            {
+                if (((ttentry->flag) & 0x03U)==EXACT)
+                {
+                    *valueP = ttentry->value;
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int Hash_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, int pdepth, uint64_t pos_hash, int *valueP, MOVE* hmvp)
+{
+    int i;
+    const TT_ENTRY_ST *ttentry;
+    uint32_t key_upper;
+    uint16_t key_mid;
+
+    if (colour == BLACK)
+        pos_hash ^= TT_BLACK_KEY;
+    key_upper = (uint32_t) (pos_hash >> 32);
+    key_mid = (uint16_t) ((pos_hash >> 16) & 0xFFFFU);
+
+    ttentry = tt[pos_hash & MAX_TT].entry;
+#ifdef DBGTTSTALL
+    Hash_Count_Stall(ttentry);
+#endif
+    for (i = 0; i < BUCKET_SIZE; i++, ttentry++)
+    {
+        if ((ttentry->pos_hash_upper == key_upper) && (ttentry->pos_hash_mid == key_mid) &&
+            ((ttentry->flag & 0x03U) != NO_FLAG)) /*hit*/
+        {
+            if (ttentry->cmove)
+            {
+                MOVE tt_move = Mvgen_Decompress_Move(ttentry->cmove);
+                if (UNLIKELY(Mvgen_Check_Move_Legality(tt_move, colour) == 0))
+                    continue;
+                *hmvp = tt_move;
+            }
+            tt_hits++;
+            if ((int) ttentry->depth >= pdepth)
+            {
+                unsigned int lflag = ((ttentry->flag) & 0x03U);
+                switch (lflag)
+                {
+                case CHECK_ALPHA:
+                    if (ttentry->value <= alpha)
+                    {
+                        *valueP = alpha;
+                        return 1;
+                    }
+                    break;
+                case CHECK_BETA:
+                    if (ttentry->value >= beta)
+                    {
+                        *valueP = beta;
+                        return 1;
+                    }
+                    break;
+                case EXACT:
+                    *valueP = ttentry->value;
+                    return 1;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/*the same position is updated in place. otherwise, an empty entry is used,
+or the one with the lowest depth where older generations count less. so the
+aging needs no sweep over the table before every search.*/
+void Hash_Update_TT(TT_ST *tt, enum E_COLOUR colour, int pdepth, int pvalue, unsigned int pflag, uint64_t pos_hash, MOVE hmv)
+{
+    int i, replace_prio;
+    TT_ENTRY_ST *ttentry, *replace;
+    uint32_t key_upper;
+    uint16_t key_mid;
+    unsigned int gen_bits = hash_clear_counter << TT_GEN_SHIFT;
+
+    if (colour == BLACK)
+        pos_hash ^= TT_BLACK_KEY;
+    key_upper = (uint32_t) (pos_hash >> 32);
+    key_mid = (uint16_t) ((pos_hash >> 16) & 0xFFFFU);
+
+    ttentry = replace = tt[pos_hash & MAX_TT].entry;
+    replace_prio = INFINITY_;
+
+    for (i = 0; i < BUCKET_SIZE; i++, ttentry++)
+    {
+        unsigned int t_flag = ttentry->flag & 0x03U;
+        int prio;
+
+        if (t_flag == NO_FLAG)
+        {
+            prio = -INFINITY_;
+        } else if ((ttentry->pos_hash_upper == key_upper) && (ttentry->pos_hash_mid == key_mid))
+        {
+            /*same position already saved with more depth? then don't store.*/
+            if ((pdepth < (int) ttentry->depth) && ((t_flag == EXACT) || (t_flag == pflag)))
+            {
+                ttentry->flag = (uint8_t) (t_flag | gen_bits);
+                return;
+            }
+            if (hmv.u != MV_NO_MOVE_MASK) /*if no new move then preserve old one*/
+                ttentry->cmove = Mvgen_Compress_Move(hmv);
+            ttentry->flag  = (uint8_t) (pflag | gen_bits);
+            ttentry->depth = (uint8_t) pdepth;
+            ttentry->value = (int16_t) pvalue;
+            return;
+        } else
+        {
+            unsigned int age = (hash_clear_counter - (((unsigned int) ttentry->flag) >> TT_GEN_SHIFT)) & MAX_AGE_CNT;
+            prio = (int) ttentry->depth - 8 * (int) age;
+        }
+        if (prio < replace_prio)
+        {
+            replace_prio = prio;
+            replace = ttentry;
+        }
+    }
+
+    replace->pos_hash_upper = key_upper;
+    replace->pos_hash_mid = key_mid;
+    replace->cmove = Mvgen_Compress_Move(hmv);
+    replace->flag  = (uint8_t) (pflag | gen_bits);
+    replace->depth = (uint8_t) pdepth;
+    replace->value = (int16_t) pvalue;
+}
+
+#else /*TT_BUCKETS*/
+
 int Hash_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int pdepth, uint64_t pos_hash, int *valueP, MOVE* hmvp)
 {
     int i;
@@ -425,6 +955,9 @@ int Hash_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int pdepth, uint64_t
     uint32_t additional_bits = ((uint32_t)((pos_hash >> 24) & 0xFCU));
 
     ttentry = &tt[pos_hash & MAX_TT];
+#ifdef DBGTTSTALL
+    Hash_Count_Stall(ttentry);
+#endif
     for (i = 0; i < CLUSTER_SIZE; i++)
     {
         if ((ttentry->pos_hash_upper_h == key32_h) && (ttentry->pos_hash_upper_l == key32_l)) /*potential hit*/
@@ -438,6 +971,7 @@ int Hash_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int pdepth, uint64_t
                         continue;
                     *hmvp = tt_move;
                 }
+                tt_hits++;
                 if (((int) (ttentry->depth & 0x3FU)) >= pdepth)
                 {
                     if (((ttentry->flag) & 0x03U)==EXACT)
@@ -462,6 +996,9 @@ int Hash_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, in
     uint16_t key32_l = key32 & 0xFFFFU;
     uint32_t additional_bits = ((uint32_t)((pos_hash >> 24) & 0xFCU));
     ttentry = &tt[pos_hash & MAX_TT];
+#ifdef DBGTTSTALL
+    Hash_Count_Stall(ttentry);
+#endif
 
     for (i = 0; i < CLUSTER_SIZE; i++)
     {
@@ -476,6 +1013,7 @@ int Hash_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, in
                         continue;
                     *hmvp = tt_move;
                 }
+                tt_hits++;
                 if (((int) (ttentry->depth & 0x3FU)) >= pdepth)
                 {
                     unsigned int lflag = ((ttentry->flag) & 0x03U);
@@ -509,17 +1047,19 @@ int Hash_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, in
     return 0;
 }
 
-void Hash_Update_TT(TT_ST *tt, int pdepth, int pvalue, unsigned int pflag, uint64_t pos_hash, MOVE hmv)
+void Hash_Update_TT(TT_ST *tt, enum E_COLOUR colour, int pdepth, int pvalue, unsigned int pflag, uint64_t pos_hash, MOVE hmv)
 {
     TT_ST *ttentry;
     uint32_t key32 = pos_hash >> 32;
     uint16_t key32_h = key32 >> 16;
     uint16_t key32_l = key32 & 0xFFFFU;
     uint32_t additional_bits = (uint32_t)((pos_hash >> 24) & 0xFCU);
+    (void) colour; /*the two tables already separate the sides.*/
     ttentry = &tt[pos_hash & MAX_TT];
 
-    /*1st cluster place: depth preferred*/
-    if (pdepth < (int)(ttentry->depth & 0x3FU))
+    /*1st cluster place: depth preferred, but not for entries from older searches.
+    that replaces the sweep over the whole tables before every search.*/
+    if ((pdepth < (int)(ttentry->depth & 0x3FU)) && (((unsigned) (ttentry->depth >> 6)) == hash_clear_counter))
     {
         /*same position as the current one already saved, only with more depth? then don't store.*/
         if ((ttentry->pos_hash_upper_h == key32_h) && (ttentry->pos_hash_upper_l == key32_l))
@@ -549,8 +1089,12 @@ void Hash_Update_TT(TT_ST *tt, int pdepth, int pvalue, unsigned int pflag, uint6
         }
     } else
     {
-        /*3rd cluster place: always replace*/
+        /*3rd cluster place: always replace, except that QS entries don't
+        push out main search entries of the current search.*/
         ttentry++;
+        if ((pdepth == QS_TT_DEPTH) && ((ttentry->depth & 0x3FU) != QS_TT_DEPTH) &&
+            (((unsigned) (ttentry->depth >> 6)) == hash_clear_counter))
+            return;
         ttentry->cmove = Mvgen_Compress_Move(hmv);
         ttentry->pos_hash_upper_h = key32_h;
         ttentry->pos_hash_upper_l = key32_l;
@@ -559,3 +1103,29 @@ void Hash_Update_TT(TT_ST *tt, int pdepth, int pvalue, unsigned int pflag, uint6
     ttentry->depth = (uint8_t) (((unsigned) pdepth) | (hash_clear_counter << 6));
     ttentry->value = (int16_t) pvalue;
 }
+
+#endif /*TT_BUCKETS*/
+
+/*start loading the hash table entry for a position that will be probed soon.
+the move loop still does the legality and draw checks before the child node
+probes, which hides a good part of the memory latency with big tables.*/
+void Hash_Prefetch_TT(const TT_ST *tt, enum E_COLOUR colour, uint64_t pos_hash)
+{
+#ifdef TT_BUCKETS
+    if (colour == BLACK)
+        pos_hash ^= TT_BLACK_KEY;
+    __builtin_prefetch(&tt[pos_hash & MAX_TT]);
+#else
+    const TT_ST *ttentry = &tt[pos_hash & MAX_TT];
+    (void) colour;
+    /*the cluster may span two cache lines.*/
+    __builtin_prefetch(ttentry);
+    __builtin_prefetch(&ttentry[CLUSTER_SIZE-1]);
+#endif
+}
+
+/*the pawn hash tables are probed in the evaluation of nearly every node.*/
+void Hash_Prefetch_Pawn_TT(uint64_t pawn_hash)
+{
+    __builtin_prefetch(&P_T_T[pawn_hash & PMAX_TT]);
+}
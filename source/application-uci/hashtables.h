@@ -19,14 +19,24 @@
  *
  */
 
+size_t      Hash_Get_Table_Bytes(uintptr_t max_tt);
+int         Hash_Alloc_Tables(uintptr_t max_tt, TT_ST **tt, TT_ST **opp_tt);
+void        Hash_Free_Tables(TT_ST *tt, TT_ST *opp_tt);
 void        Hash_Clear_Tables(void);
-void        Hash_Cut_Tables(unsigned int clear_counter);
+uintptr_t   Hash_Get_Pawn_TT_Max(size_t pawn_hash_size);
+int         Hash_Alloc_Pawn_Table(uintptr_t pmax_tt, TT_PTT_BUCKET_ST **ptt);
+void        Hash_Free_Pawn_Table(TT_PTT_BUCKET_ST *ptt);
+void        Hash_Clear_Pawn_Table(void);
 void        Hash_Init_Stack(void);
 void        Hash_Init(void);
+enum E_HASH_FILE Hash_Save_Tables(const char *file_name);
+enum E_HASH_FILE Hash_Load_Tables(const char *file_name, int map_file);
 int         Hash_Repetitions(void);
 int         Hash_Check_For_Draw(void);
 unsigned    Hash_Get_Usage(void);
 uint64_t    Hash_Get_Position_Value(uint64_t *pawn_hash);
 int         Hash_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int pdepth, uint64_t pos_hash, int *valueP, MOVE* hmvp);
 int         Hash_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, int pdepth, uint64_t pos_hash, int *valueP, MOVE* hmvp);
-void        Hash_Update_TT(TT_ST *tt, int pdepth, int pvalue, unsigned int pflag, uint64_t pos_hash, MOVE hmv);
+void        Hash_Prefetch_TT(const TT_ST *tt, enum E_COLOUR colour, uint64_t pos_hash);
+void        Hash_Prefetch_Pawn_TT(uint64_t pawn_hash);
+void        Hash_Update_TT(TT_ST *tt, enum E_COLOUR colour, int pdepth, int pvalue, unsigned int pflag, uint64_t pos_hash, MOVE hmv);
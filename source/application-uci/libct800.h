@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ *  Copyright (C) 2015-2020, Rasmus Althoff <althoff@ct800.net>
+ *
+ *  This file is part of CT800/NGPlay (library interface).
+ *
+ *  CT800/NGPlay is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  CT800/NGPlay is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CT800/NGPlay. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*public interface of libct800, the engine as embeddable library. unlike
+  the other headers, this one is self-contained because it is meant for
+  applications outside of the engine source tree.
+
+  every engine context owns its position, PV and main hash tables. the
+  board, stacks and pawn hash table are per thread, and a context is bound
+  to the calling thread for the duration of each call. so any number of
+  contexts can search at the same time as long as each of them is only used
+  by one thread at a time. CT800_Stop() is the exception and may be called
+  from any thread.*/
+
+#ifndef LIBCT800_H
+#define LIBCT800_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CT800_MOVE_LEN     6   /*UCI move notation plus null terminator*/
+#define CT800_PV_LEN       64  /*maximum returned PV length*/
+
+typedef struct ct800_ctx CT800_CTX;
+
+enum E_CT800_STATUS {CT800_OK, CT800_ERR_NO_MEM, CT800_ERR_BAD_FEN,
+                     CT800_ERR_BAD_MOVE, CT800_ERR_NO_MOVE};
+
+/*a value of 0 means no limit. without any limit, the search only ends via
+  CT800_Stop().*/
+typedef struct {
+    int      depth;      /*in plies*/
+    int64_t  move_time;  /*exact time in milliseconds*/
+    uint64_t nodes;
+    int      multipv;    /*number of PV lines in the info output, 0 for 1*/
+} CT800_LIMITS;
+
+typedef struct {
+    char     best_move[CT800_MOVE_LEN]; /*"0000" if there is none*/
+    int      score;      /*in centipawns from the side to move*/
+    int      mate;       /*mate in moves, negative if being mated, else 0*/
+    int      depth;
+    uint64_t nodes;
+    int64_t  time;       /*in milliseconds*/
+    int      pv_len;
+    char     pv[CT800_PV_LEN][CT800_MOVE_LEN];
+} CT800_RESULT;
+
+/*receives the UCI style "info" output during the search.*/
+typedef void (*CT800_INFO_FUNC)(void *info_data, const char *info_line);
+
+void                CT800_Init(void);
+CT800_CTX          *CT800_New_Context(size_t hash_mb);
+void                CT800_Free_Context(CT800_CTX *ctx);
+void                CT800_New_Game(CT800_CTX *ctx);
+void                CT800_Set_Info_Callback(CT800_CTX *ctx, CT800_INFO_FUNC info_func, void *info_data);
+enum E_CT800_STATUS CT800_Set_Position(CT800_CTX *ctx, const char *fen, const char *moves);
+enum E_CT800_STATUS CT800_Search(CT800_CTX *ctx, const CT800_LIMITS *limits, CT800_RESULT *result);
+void                CT800_Stop(CT800_CTX *ctx);
+
+#endif
@@ -0,0 +1,11 @@
+#!/bin/bash
+# builds libct800 as static and shared library, see libct800.h for the API.
+fw_ver="V1.40"
+compiler_options="-DCTLIB -DTARGET_BUILD=64 -m64 -pthread -fPIC -Wall -Wextra -Wlogical-op -Wstrict-prototypes -Werror -O02 -std=c99 -faggressive-loop-optimizations -fno-unsafe-loop-optimizations -fgcse-sm -fgcse-las -fgcse-after-reload -fno-strict-aliasing -fno-strict-overflow"
+for src in play kpk eval move_gen hashtables search util book; do
+    gcc $compiler_options -c $src.c -o output/lib_$src.o || exit 1
+done
+rm -f output/libct800.a
+ar rcs output/libct800.a output/lib_*.o
+gcc -shared -m64 -pthread -o output/libct800.so output/lib_*.o -lrt -Wl,-s
+rm -f output/lib_*.o
@@ -0,0 +1,4 @@
+#!/bin/bash
+# builds the micro benchmarks of the hot engine functions, see microbench.c.
+fw_ver="V1.40"
+gcc -DCTLIB -DTARGET_BUILD=64 -m64 -pthread -Wall -Wextra -Wlogical-op -Wstrict-prototypes -Werror -O02 -flto -std=c99 -faggressive-loop-optimizations -fno-unsafe-loop-optimizations -fgcse-sm -fgcse-las -fgcse-after-reload -fno-strict-aliasing -fno-strict-overflow -o output/microbench_${fw_ver}_x64 microbench.c play.c kpk.c eval.c move_gen.c hashtables.c search.c util.c book.c -lrt -Wl,-s
@@ -0,0 +1,402 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later */
+/*
+ *  Copyright (C) 2015-2020, Rasmus Althoff <althoff@ct800.net>
+ *
+ *  This file is part of CT800/NGPlay (micro benchmarks).
+ *
+ *  CT800/NGPlay is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  CT800/NGPlay is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with CT800/NGPlay. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*standalone micro benchmarks of the hot engine functions, built together
+  with the library sources by make_microbench_pc_x64.sh. each function is
+  timed separately over a fixed set of positions so that a change can be
+  measured where it happens instead of only via the overall node rate.
+
+  usage: microbench_V1.40_x64 [scale] [hash]
+  scale multiplies the number of operations (default: 1), hash is the main
+  hash table size in MB for the TT benchmarks (default: 16).
+
+  the output is CSV with the header "name,ops,ns_per_op" on stdout:
+  movegen       Mvgen_Find_All_White_Moves() / Mvgen_Find_All_Black_Moves()
+  make_retract  Search_Make_Move() plus Search_Retract_Last_Move()
+  eval          Eval_Static_Evaluation(), missing the eval cache
+  eval_cached   Eval_Static_Evaluation(), hitting the eval cache if it is
+                built with -DEVAL_CACHE_BITS=n
+  tt_update     Hash_Update_TT() with random keys
+  tt_probe_hit  Hash_Check_TT() with the keys just stored
+  tt_probe_miss Hash_Check_TT() with keys that were not stored
+  kpk_probe     Kpk_Probe() with random KPK positions*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ctdefs.h"
+#include "move_gen.h"
+#include "hashtables.h"
+#include "eval.h"
+#include "search.h"
+#include "kpk.h"
+#include "libct800.h"
+
+/*---------- external variables ----------*/
+/*-- READ-WRITE --*/
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL int cst_p;
+extern THREAD_LOCAL uint16_t cstack[MAX_STACK+1];
+extern THREAD_LOCAL int en_passant_sq;
+extern THREAD_LOCAL unsigned int gflags;
+extern THREAD_LOCAL enum E_COLOUR computer_side;
+extern THREAD_LOCAL TT_ST *T_T;
+extern THREAD_LOCAL TT_ST *Opp_T_T;
+extern THREAD_LOCAL uintptr_t MAX_TT;
+extern THREAD_LOCAL TT_PTT_BUCKET_ST *P_T_T;
+extern THREAD_LOCAL uintptr_t PMAX_TT;
+
+/*the number of operations per benchmark at scale 1. they are chosen so
+  that every benchmark runs roughly 0.1 to 0.5 seconds on a usual PC.*/
+#define MB_MOVEGEN_REPS    100000L
+#define MB_MAKE_REPS       20000L
+#define MB_EVAL_REPS       20000L
+#define MB_TT_KEYS         (1L << 16)
+#define MB_TT_REPS         32L
+#define MB_KPK_POS         4096L
+#define MB_KPK_REPS        1000L
+#define MB_HASH_DEFAULT    16 /*in MB*/
+
+/*openings, middle games and endgames with and without pawns so that all
+  parts of the move generator and the evaluation get their share.*/
+static const char *const mb_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkb1r/pp1p1ppp/2p2n2/4p3/2B1P3/2N5/PPPP1PPP/R1BQK1NR w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 1",
+    "r1b2rk1/2q1bppp/p2p1n2/np2p3/3PP3/5N1P/PPBN1PP1/R1BQR1K1 w - - 0 1",
+    "r2q1rk1/ppp2ppp/2n1bn2/2b1p3/3pP3/3P1NPP/PPP1NPB1/R1BQ1RK1 b - - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 0 10",
+    "2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 b - - 0 1",
+    "8/8/8/4k3/8/8/8/KBN5 w - - 0 1"
+};
+
+#define MB_POSITIONS ((int) (sizeof(mb_positions) / sizeof(mb_positions[0])))
+
+/*results go here so that the compiler cannot drop the benchmarked calls.*/
+static volatile uint64_t mb_sink;
+
+static uint64_t mb_rand_state = 0x9E3779B97F4A7C15ULL;
+
+/*xorshift64, the benchmarks must not depend on the C library rand().*/
+static uint64_t Mb_Rand(void)
+{
+    mb_rand_state ^= mb_rand_state << 13;
+    mb_rand_state ^= mb_rand_state >> 7;
+    mb_rand_state ^= mb_rand_state << 17;
+    return(mb_rand_state);
+}
+
+static int64_t Mb_Get_Nanosecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return(((int64_t) now.tv_sec) * 1000000000LL + (int64_t) now.tv_nsec);
+}
+
+static void Mb_Report(const char *name, uint64_t ops, int64_t nanosecs)
+{
+    /*in 1/100 ns because the fast functions take only a few ns.*/
+    uint64_t ns_per_op = (ops > 0) ? (((uint64_t) nanosecs) * 100ULL) / ops : 0;
+
+    printf("%s,%" PRIu64 ",%" PRIu64 ".%02" PRIu64 "\n", name, ops,
+           (uint64_t) (ns_per_op / 100U), (uint64_t) (ns_per_op % 100U));
+    fflush(stdout);
+}
+
+/*sets up the board via the library and then puts back the own hash tables
+  because the library only binds the context tables during its calls.
+  returns the side to move.*/
+static enum E_COLOUR Mb_Set_Position(CT800_CTX *ctx, const char *fen, TT_ST *tt, uintptr_t max_tt,
+                                     TT_PTT_BUCKET_ST *ptt, uintptr_t pmax_tt)
+{
+    const char *side = strchr(fen, ' ');
+
+    if (CT800_Set_Position(ctx, fen, NULL) != CT800_OK)
+    {
+        fprintf(stderr, "error: bad FEN %s\n", fen);
+        exit(EXIT_FAILURE);
+    }
+    T_T = Opp_T_T = tt;
+    MAX_TT = max_tt;
+    P_T_T = ptt;
+    PMAX_TT = pmax_tt;
+
+    computer_side = ((side != NULL) && (side[1] == 'b')) ? BLACK : WHITE;
+    return(computer_side);
+}
+
+static int Mb_Find_All_Moves(MOVE *movelist, enum E_COLOUR colour)
+{
+    if (colour == WHITE)
+        return(Mvgen_Find_All_White_Moves(movelist, NO_LEVEL, UNDERPROM));
+    return(Mvgen_Find_All_Black_Moves(movelist, NO_LEVEL, UNDERPROM));
+}
+
+int main(int argc, char **argv)
+{
+    static uint64_t tt_keys[MB_TT_KEYS];
+    static uint8_t kpk_pos[MB_KPK_POS][4];
+    MOVE movelist[MAXMV];
+    CT800_CTX *ctx;
+    TT_ST *tt, *dummy_tt;
+    TT_PTT_BUCKET_ST *ptt;
+    uintptr_t max_tt, pmax_tt;
+    int64_t start_time, total_time, scale = 1, hash_mb = MB_HASH_DEFAULT;
+    uint64_t ops, sum;
+    long rep;
+    int pos, i, move_cnt;
+
+    if (argc > 1)
+        scale = strtoll(argv[1], NULL, 10);
+    if (argc > 2)
+        hash_mb = strtoll(argv[2], NULL, 10);
+    if ((scale < 1) || (hash_mb < 1))
+    {
+        fprintf(stderr, "usage: %s [scale] [hash]\n", argv[0]);
+        return(EXIT_FAILURE);
+    }
+
+    CT800_Init();
+    ctx = CT800_New_Context(1);
+    max_tt = DEF_MAX_TT - 1;
+    while (Hash_Get_Table_Bytes(2 * (max_tt + 1) - 1) <= ((size_t) hash_mb) * 1024UL * 1024UL)
+        max_tt = 2 * (max_tt + 1) - 1;
+    pmax_tt = Hash_Get_Pawn_TT_Max(PAWN_HASH_DEFAULT);
+    if ((ctx == NULL) || (Hash_Alloc_Tables(max_tt, &tt, &dummy_tt)) || (Hash_Alloc_Pawn_Table(pmax_tt, &ptt)))
+    {
+        fprintf(stderr, "error: out of memory\n");
+        return(EXIT_FAILURE);
+    }
+
+    printf("name,ops,ns_per_op\n");
+
+    /*---------- move generator ----------*/
+    total_time = 0;
+    ops = sum = 0;
+    for (pos = 0; pos < MB_POSITIONS; pos++)
+    {
+        enum E_COLOUR colour = Mb_Set_Position(ctx, mb_positions[pos], tt, max_tt, ptt, pmax_tt);
+
+        start_time = Mb_Get_Nanosecs();
+        if (colour == WHITE)
+        {
+            for (rep = 0; rep < MB_MOVEGEN_REPS * scale; rep++)
+                sum += (uint64_t) Mvgen_Find_All_White_Moves(movelist, NO_LEVEL, UNDERPROM);
+        } else
+        {
+            for (rep = 0; rep < MB_MOVEGEN_REPS * scale; rep++)
+                sum += (uint64_t) Mvgen_Find_All_Black_Moves(movelist, NO_LEVEL, UNDERPROM);
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) (MB_MOVEGEN_REPS * scale);
+    }
+    mb_sink = sum;
+    Mb_Report("movegen", ops, total_time);
+
+    /*---------- make and retract ----------*/
+    total_time = 0;
+    ops = sum = 0;
+    for (pos = 0; pos < MB_POSITIONS; pos++)
+    {
+        enum E_COLOUR colour = Mb_Set_Position(ctx, mb_positions[pos], tt, max_tt, ptt, pmax_tt);
+
+        move_cnt = Mb_Find_All_Moves(movelist, colour);
+        start_time = Mb_Get_Nanosecs();
+        for (rep = 0; rep < MB_MAKE_REPS * scale; rep++)
+        {
+            for (i = 0; i < move_cnt; i++)
+            {
+                Search_Push_Status();
+                Search_Make_Move(movelist[i]);
+                sum += move_stack[mv_stack_p].mv_pos_hash;
+                Search_Retract_Last_Move();
+                Search_Pop_Status();
+            }
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) (MB_MAKE_REPS * scale * move_cnt);
+    }
+    mb_sink = sum;
+    Mb_Report("make_retract", ops, total_time);
+
+    /*---------- evaluation ----------*/
+    /*the eval cache would answer all but the first call, so every call
+      gets another position hash. the pawn hash table still hits, which
+      is also the usual case in the search.*/
+    total_time = 0;
+    ops = sum = 0;
+    for (pos = 0; pos < MB_POSITIONS; pos++)
+    {
+        enum E_COLOUR colour = Mb_Set_Position(ctx, mb_positions[pos], tt, max_tt, ptt, pmax_tt);
+        uint64_t pos_hash = move_stack[mv_stack_p].mv_pos_hash;
+        unsigned int is_endgame, w_passed_mask, b_passed_mask;
+        int enough_material;
+
+        (void) Eval_Setup_Initial_Material();
+        start_time = Mb_Get_Nanosecs();
+        for (rep = 0; rep < MB_EVAL_REPS * scale; rep++)
+        {
+            move_stack[mv_stack_p].mv_pos_hash = pos_hash + ((uint64_t) (rep + 1)) * 0x9E3779B97F4A7C15ULL;
+            sum += (uint64_t) Eval_Static_Evaluation(&enough_material, colour, &is_endgame,
+                                                     &w_passed_mask, &b_passed_mask);
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) (MB_EVAL_REPS * scale);
+        move_stack[mv_stack_p].mv_pos_hash = pos_hash;
+    }
+    mb_sink = sum;
+    Mb_Report("eval", ops, total_time);
+
+    total_time = 0;
+    ops = sum = 0;
+    for (pos = 0; pos < MB_POSITIONS; pos++)
+    {
+        enum E_COLOUR colour = Mb_Set_Position(ctx, mb_positions[pos], tt, max_tt, ptt, pmax_tt);
+        unsigned int is_endgame, w_passed_mask, b_passed_mask;
+        int enough_material;
+
+        (void) Eval_Setup_Initial_Material();
+        start_time = Mb_Get_Nanosecs();
+        for (rep = 0; rep < MB_EVAL_REPS * scale; rep++)
+        {
+            sum += (uint64_t) Eval_Static_Evaluation(&enough_material, colour, &is_endgame,
+                                                     &w_passed_mask, &b_passed_mask);
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) (MB_EVAL_REPS * scale);
+    }
+    mb_sink = sum;
+    Mb_Report("eval_cached", ops, total_time);
+
+    /*---------- transposition table ----------*/
+    /*random keys spread over the whole table, as in the search. with a
+      big table, this mostly measures the cache misses.*/
+    (void) Mb_Set_Position(ctx, mb_positions[0], tt, max_tt, ptt, pmax_tt);
+    Hash_Clear_Tables();
+    movelist[0].u = 0;
+    for (i = 0; i < MB_TT_KEYS; i++)
+        tt_keys[i] = Mb_Rand();
+
+    total_time = 0;
+    ops = 0;
+    for (rep = 0; rep < MB_TT_REPS * scale; rep++)
+    {
+        enum E_COLOUR colour = (rep & 1) ? BLACK : WHITE;
+        int depth = (int) (rep % MAX_DEPTH) + 1;
+
+        start_time = Mb_Get_Nanosecs();
+        for (i = 0; i < MB_TT_KEYS; i++)
+            Hash_Update_TT(T_T, colour, depth, i & 0xFF, EXACT, tt_keys[i], movelist[0]);
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) MB_TT_KEYS;
+    }
+    Mb_Report("tt_update", ops, total_time);
+
+    total_time = 0;
+    ops = sum = 0;
+    for (rep = 0; rep < MB_TT_REPS * scale; rep++)
+    {
+        enum E_COLOUR colour = (rep & 1) ? BLACK : WHITE;
+
+        start_time = Mb_Get_Nanosecs();
+        for (i = 0; i < MB_TT_KEYS; i++)
+        {
+            int value = 0;
+            MOVE hash_move;
+
+            sum += (uint64_t) Hash_Check_TT(T_T, colour, -INFINITY_, INFINITY_, 1, tt_keys[i], &value, &hash_move);
+            sum += (uint64_t) value;
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) MB_TT_KEYS;
+    }
+    mb_sink = sum;
+    Mb_Report("tt_probe_hit", ops, total_time);
+
+    for (i = 0; i < MB_TT_KEYS; i++)
+        tt_keys[i] = Mb_Rand();
+    total_time = 0;
+    ops = sum = 0;
+    for (rep = 0; rep < MB_TT_REPS * scale; rep++)
+    {
+        enum E_COLOUR colour = (rep & 1) ? BLACK : WHITE;
+
+        start_time = Mb_Get_Nanosecs();
+        for (i = 0; i < MB_TT_KEYS; i++)
+        {
+            int value = 0;
+            MOVE hash_move;
+
+            sum += (uint64_t) Hash_Check_TT(T_T, colour, -INFINITY_, INFINITY_, 1, tt_keys[i], &value, &hash_move);
+        }
+        total_time += Mb_Get_Nanosecs() - start_time;
+        ops += (uint64_t) MB_TT_KEYS;
+    }
+    mb_sink = sum;
+    Mb_Report("tt_probe_miss", ops, total_time);
+
+    /*---------- KPK bitbase ----------*/
+    /*squares in the 0-63 format of the bitbase. the pawn stays off the
+      first and last rank, the kings off the pawn and off each other.*/
+    for (i = 0; i < MB_KPK_POS; i++)
+    {
+        unsigned int w_king, w_pawn, b_king;
+
+        w_pawn = 8U + (unsigned int) (Mb_Rand() % 48U);
+        do {
+            w_king = (unsigned int) (Mb_Rand() % 64U);
+            b_king = (unsigned int) (Mb_Rand() % 64U);
+        } while ((w_king == w_pawn) || (b_king == w_pawn) || (w_king == b_king));
+        kpk_pos[i][0] = (uint8_t) (Mb_Rand() & 1U);
+        kpk_pos[i][1] = (uint8_t) w_king;
+        kpk_pos[i][2] = (uint8_t) w_pawn;
+        kpk_pos[i][3] = (uint8_t) b_king;
+    }
+
+    sum = 0;
+    start_time = Mb_Get_Nanosecs();
+    for (rep = 0; rep < MB_KPK_REPS * scale; rep++)
+    {
+        for (i = 0; i < MB_KPK_POS; i++)
+            sum += Kpk_Probe(kpk_pos[i][0], kpk_pos[i][1], kpk_pos[i][2], kpk_pos[i][3]);
+    }
+    total_time = Mb_Get_Nanosecs() - start_time;
+    mb_sink = sum;
+    Mb_Report("kpk_probe", (uint64_t) (MB_KPK_REPS * scale * MB_KPK_POS), total_time);
+
+    T_T = Opp_T_T = NULL;
+    P_T_T = NULL;
+    Hash_Free_Tables(tt, dummy_tt);
+    Hash_Free_Pawn_Table(ptt);
+    CT800_Free_Context(ctx);
+    return(EXIT_SUCCESS);
+}
@@ -27,19 +27,22 @@
 
 /*---------- external variables ----------*/
 /*-- READ-ONLY  --*/
-extern PIECE Wpieces[16];
-extern PIECE Bpieces[16];
-extern PIECE *board[120];
+extern THREAD_LOCAL PIECE Wpieces[16];
+extern THREAD_LOCAL PIECE Bpieces[16];
+extern THREAD_LOCAL PIECE *board[120];
 extern const int8_t RowNum[120];
 extern const int8_t boardXY[120];
 extern const int8_t board64[64];
-extern int en_passant_sq;
-extern unsigned int gflags;
-extern int8_t W_history[6][ENDSQ], B_history[6][ENDSQ];
-extern CMOVE W_Killers[2][MAX_DEPTH], B_Killers[2][MAX_DEPTH];
+extern PIECE empty_p;
+extern THREAD_LOCAL int en_passant_sq;
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL unsigned int gflags;
+extern THREAD_LOCAL int8_t W_history[6][ENDSQ], B_history[6][ENDSQ];
+extern THREAD_LOCAL CMOVE W_Killers[2][MAX_DEPTH], B_Killers[2][MAX_DEPTH];
 
 /*-- READ-WRITE --*/
-extern int wking, bking;
+extern THREAD_LOCAL int wking, bking;
 
 /*---------- move compression data and functions ----------*/
 
@@ -1964,9 +1967,107 @@ static void Mvgen_Add_Black_King_Evasions(PIECE *piece, MOVE *restrict movelist,
 }
 
 
+/*---------- check test for the last move ----------*/
+
+/*the square difference from a piece to the enemy king tells which piece
+  kinds could give check from there, and for the sliders, in which
+  direction. on the 10x12 board, the difference is between -77 and +77.*/
+#define CHK_OFFSET  77
+#define CHK_SIZE    (2*CHK_OFFSET + 1)
+#define CHK_WPAWN   0x01U
+#define CHK_BPAWN   0x02U
+#define CHK_KNIGHT  0x04U
+#define CHK_BISHOP  0x08U
+#define CHK_ROOK    0x10U
+#define CHK_KING    0x20U
+#define CHK_SLIDER  (CHK_BISHOP | CHK_ROOK)
+
+static uint8_t Mvgen_Chk_Kinds[CHK_SIZE];
+static int8_t  Mvgen_Chk_Step[CHK_SIZE];
+
+static const uint8_t Mvgen_Chk_Piece[PIECEMAX] =
+{
+    0, 0,
+    CHK_WPAWN, CHK_KNIGHT, CHK_BISHOP, CHK_ROOK, CHK_SLIDER, CHK_KING,
+    0, 0, 0, 0,
+    CHK_BPAWN, CHK_KNIGHT, CHK_BISHOP, CHK_ROOK, CHK_SLIDER, CHK_KING
+};
+
+static void Mvgen_Init_Check_Tables(void)
+{
+    static const int8_t slider_steps[8] = {1, -1, 10, -10, 9, -9, 11, -11};
+    static const int8_t knight_steps[8] = {8, -8, 12, -12, 19, -19, 21, -21};
+    int d, n;
+
+    for (d = 0; d < 8; d++)
+    {
+        unsigned int kind = (d < 4) ? CHK_ROOK : CHK_BISHOP;
+        int step = slider_steps[d];
+
+        for (n = 1; n < 8; n++)
+        {
+            Mvgen_Chk_Kinds[CHK_OFFSET + n*step] |= kind;
+            Mvgen_Chk_Step[CHK_OFFSET + n*step] = step;
+        }
+        Mvgen_Chk_Kinds[CHK_OFFSET + step] |= CHK_KING;
+        Mvgen_Chk_Kinds[CHK_OFFSET + knight_steps[d]] |= CHK_KNIGHT;
+    }
+    Mvgen_Chk_Kinds[CHK_OFFSET + 9]  |= CHK_WPAWN;
+    Mvgen_Chk_Kinds[CHK_OFFSET + 11] |= CHK_WPAWN;
+    Mvgen_Chk_Kinds[CHK_OFFSET - 9]  |= CHK_BPAWN;
+    Mvgen_Chk_Kinds[CHK_OFFSET - 11] |= CHK_BPAWN;
+}
+
+/*does the piece of this type on xy attack the king on xyk? if the
+  difference fits a slider only by wrapping around the board edge, the ray
+  runs into the fence.*/
+static int Mvgen_Direct_Check(int xy, int xyk, int type)
+{
+    int diff = xyk - xy + CHK_OFFSET;
+    unsigned int kinds = Mvgen_Chk_Kinds[diff] & Mvgen_Chk_Piece[type];
+
+    if (kinds == 0)
+        return(0);
+    if (kinds & CHK_SLIDER)
+    {
+        int step = Mvgen_Chk_Step[diff];
+
+        for (xy += step; xy != xyk; xy += step)
+        {
+            if (board[xy]->type != NO_PIECE)
+                return(0);
+        }
+    }
+    return(1);
+}
+
+/*has the emptied square xy opened a line from the king on xyk to a slider
+  of the side that has moved? there cannot have been a check before the
+  move, so the first piece behind xy is enough.*/
+static int Mvgen_Discovered_Check(int xy, int xyk, int mover_type)
+{
+    int step = Mvgen_Chk_Step[xyk - xy + CHK_OFFSET], test;
+
+    if (step == 0)
+        return(0);
+    for (xy = xyk - step; (test = board[xy]->type) == NO_PIECE; xy -= step)
+        ;
+    if ((test < WPAWN) || ((test > BLACK) != (mover_type > BLACK)))
+        return(0);
+    return((Mvgen_Chk_Piece[test] & Mvgen_Chk_Kinds[xyk - xy + CHK_OFFSET] & CHK_SLIDER) != 0);
+}
+
+
 /* ---------- global functions ----------*/
 
 
+/*builds the tables for the check test after a move. must be called once
+  at startup, before the first move generation.*/
+void Mvgen_Init(void)
+{
+    Mvgen_Init_Check_Tables();
+}
+
 void Mvgen_Add_White_King_Moves(PIECE *piece, MOVE *restrict movelist, int *restrict nextfree)
 {
     int xy0 = piece->xy, xy, test;
@@ -3936,3 +4037,279 @@ int Mvgen_Find_All_Black_Moves_Piece(MOVE *restrict movelist, int level, int und
     }
     return nextfree;
 }
+
+/* ---------- legality test without make/unmake ----------*/
+
+/*steps from the king: the first four are rook lines, the others bishop lines.*/
+static const int8_t Mvgen_Pin_Steps[8] = {1, -1, 10, -10, 9, -9, 11, -11};
+
+/*plays the move on the board only, without the piece lists, flags and
+  hashes, and tests the own king. used for king moves, en passant and all
+  moves while in check.*/
+static int Mvgen_White_Board_Legal(int from, int to)
+{
+    PIECE *mover = board[from], *target = board[to], *ep_victim = NULL;
+    int ep_sq = 0, legal;
+
+    if ((mover->type == WPAWN) && (target->type == NO_PIECE) && ((to - from == 9) || (to - from == 11)))
+    {
+        ep_sq = to - 10;
+        ep_victim = board[ep_sq];
+        board[ep_sq] = &empty_p;
+    }
+    board[to] = mover;
+    board[from] = &empty_p;
+    if (mover->type == WKING)
+        wking = to;
+
+    legal = !Mvgen_White_King_In_Check();
+
+    if (mover->type == WKING)
+        wking = from;
+    board[from] = mover;
+    board[to] = target;
+    if (ep_sq)
+        board[ep_sq] = ep_victim;
+    return(legal);
+}
+
+static int Mvgen_Black_Board_Legal(int from, int to)
+{
+    PIECE *mover = board[from], *target = board[to], *ep_victim = NULL;
+    int ep_sq = 0, legal;
+
+    if ((mover->type == BPAWN) && (target->type == NO_PIECE) && ((from - to == 9) || (from - to == 11)))
+    {
+        ep_sq = to + 10;
+        ep_victim = board[ep_sq];
+        board[ep_sq] = &empty_p;
+    }
+    board[to] = mover;
+    board[from] = &empty_p;
+    if (mover->type == BKING)
+        bking = to;
+
+    legal = !Mvgen_Black_King_In_Check();
+
+    if (mover->type == BKING)
+        bking = from;
+    board[from] = mover;
+    board[to] = target;
+    if (ep_sq)
+        board[ep_sq] = ep_victim;
+    return(legal);
+}
+
+/*a pinned piece may only move between the king and the pinner, including
+  the capture of the pinner.*/
+static int Mvgen_Pinned_Move_Legal(int xyk, int to, const PIN_INFO *restrict pins, int i)
+{
+    int step = pins->dir[i], xy;
+
+    for (xy = xyk + step; ; xy += step)
+    {
+        if (xy == to)
+            return(1);
+        if (xy == pins->pinner[i])
+            return(0);
+    }
+}
+
+/*collects the pinned white pieces and whether the white king is in check.
+  this is one pass over the king lines, i.e. about the cost of
+  Mvgen_White_King_In_Check().*/
+void Mvgen_White_Pin_Info(PIN_INFO *restrict pins)
+{
+    int xyk = wking, d;
+
+    pins->n_pins = 0;
+    pins->in_check = ((board[xyk+9]->type == BPAWN) || (board[xyk+11]->type == BPAWN) ||
+                      (board[xyk+8]->type == BKNIGHT) || (board[xyk-8]->type == BKNIGHT) ||
+                      (board[xyk+12]->type == BKNIGHT) || (board[xyk-12]->type == BKNIGHT) ||
+                      (board[xyk+19]->type == BKNIGHT) || (board[xyk-19]->type == BKNIGHT) ||
+                      (board[xyk+21]->type == BKNIGHT) || (board[xyk-21]->type == BKNIGHT));
+
+    for (d = 0; d < 8; d++)
+    {
+        int step = Mvgen_Pin_Steps[d], slider = (d < 4) ? BROOK : BBISHOP;
+        int xy = xyk + step, own_xy, test;
+
+        while ((test = board[xy]->type) == NO_PIECE)
+            xy += step;
+        if ((test == slider) || (test == BQUEEN))
+        {
+            pins->in_check = 1;
+            continue;
+        }
+        if ((test < WPAWN) || (test > WKING)) /*fence or other black piece*/
+            continue;
+        own_xy = xy;
+        do {
+            xy += step;
+        } while ((test = board[xy]->type) == NO_PIECE);
+        if ((test == slider) || (test == BQUEEN))
+        {
+            pins->pinned[pins->n_pins] = own_xy;
+            pins->pinner[pins->n_pins] = xy;
+            pins->dir[pins->n_pins] = step;
+            pins->n_pins++;
+        }
+    }
+}
+
+void Mvgen_Black_Pin_Info(PIN_INFO *restrict pins)
+{
+    int xyk = bking, d;
+
+    pins->n_pins = 0;
+    pins->in_check = ((board[xyk-9]->type == WPAWN) || (board[xyk-11]->type == WPAWN) ||
+                      (board[xyk+8]->type == WKNIGHT) || (board[xyk-8]->type == WKNIGHT) ||
+                      (board[xyk+12]->type == WKNIGHT) || (board[xyk-12]->type == WKNIGHT) ||
+                      (board[xyk+19]->type == WKNIGHT) || (board[xyk-19]->type == WKNIGHT) ||
+                      (board[xyk+21]->type == WKNIGHT) || (board[xyk-21]->type == WKNIGHT));
+
+    for (d = 0; d < 8; d++)
+    {
+        int step = Mvgen_Pin_Steps[d], slider = (d < 4) ? WROOK : WBISHOP;
+        int xy = xyk + step, own_xy, test;
+
+        while ((test = board[xy]->type) == NO_PIECE)
+            xy += step;
+        if ((test == slider) || (test == WQUEEN))
+        {
+            pins->in_check = 1;
+            continue;
+        }
+        if (test < BPAWN) /*fence or other white piece*/
+            continue;
+        own_xy = xy;
+        do {
+            xy += step;
+        } while ((test = board[xy]->type) == NO_PIECE);
+        if ((test == slider) || (test == WQUEEN))
+        {
+            pins->pinned[pins->n_pins] = own_xy;
+            pins->pinner[pins->n_pins] = xy;
+            pins->dir[pins->n_pins] = step;
+            pins->n_pins++;
+        }
+    }
+}
+
+/*full legality of a pseudo-legal white move, using the pin info of the
+  current position. no make/unmake except for the board-only test of king
+  moves, en passant and moves while in check.*/
+int Mvgen_White_Move_Is_Legal(MOVE move, const PIN_INFO *restrict pins)
+{
+    int from = move.m.from, to = move.m.to, type = board[from]->type, i;
+
+    if ((pins->in_check) || (type == WKING) ||
+        ((type == WPAWN) && (board[to]->type == NO_PIECE) && ((to - from == 9) || (to - from == 11))))
+    {
+        return(Mvgen_White_Board_Legal(from, to));
+    }
+    for (i = 0; i < pins->n_pins; i++)
+    {
+        if (pins->pinned[i] == from)
+            return(Mvgen_Pinned_Move_Legal(wking, to, pins, i));
+    }
+    return(1);
+}
+
+int Mvgen_Black_Move_Is_Legal(MOVE move, const PIN_INFO *restrict pins)
+{
+    int from = move.m.from, to = move.m.to, type = board[from]->type, i;
+
+    if ((pins->in_check) || (type == BKING) ||
+        ((type == BPAWN) && (board[to]->type == NO_PIECE) && ((from - to == 9) || (from - to == 11))))
+    {
+        return(Mvgen_Black_Board_Legal(from, to));
+    }
+    for (i = 0; i < pins->n_pins; i++)
+    {
+        if (pins->pinned[i] == from)
+            return(Mvgen_Pinned_Move_Legal(bking, to, pins, i));
+    }
+    return(1);
+}
+
+/*whether the last move on the move stack gives check. only the moved
+  piece, the castling rook and the emptied squares are looked at, which is
+  exact because the other side cannot have been in check before.*/
+int Mvgen_Last_Move_Gives_Check(void)
+{
+    const MVST *p = &move_stack[mv_stack_p];
+    int from = p->move.m.from, to = p->move.m.to;
+    int type = board[to]->type;
+    int xyk = (type > BLACK) ? wking : bking;
+
+    if (Mvgen_Direct_Check(to, xyk, type))
+        return(1);
+    if (p->special == CASTL)
+    {
+        int rook_xy;
+
+        if (to == G1)
+            rook_xy = F1;
+        else if (to == C1)
+            rook_xy = D1;
+        else if (to == G8)
+            rook_xy = F8;
+        else
+            rook_xy = D8;
+        if (Mvgen_Direct_Check(rook_xy, xyk, board[rook_xy]->type))
+            return(1);
+    }
+    if (Mvgen_Discovered_Check(from, xyk, type))
+        return(1);
+    /*en passant also empties the square of the captured pawn.*/
+    if ((p->capt != to) && (Mvgen_Discovered_Check(p->capt, xyk, type)))
+        return(1);
+    return(0);
+}
+
+/*generates only legal moves, with evasions if in check. the order is the
+  same as with the pseudo-legal generators minus the illegal moves.*/
+int Mvgen_Find_All_White_Legal_Moves(MOVE *restrict movelist, int level, int underprom)
+{
+    MOVE check_attacks[CHECKLISTLEN];
+    PIN_INFO pins;
+    int n_checks, n_check_pieces, move_cnt, i, legal_cnt;
+
+    Mvgen_White_Pin_Info(&pins);
+    if (!pins.in_check)
+        move_cnt = Mvgen_Find_All_White_Moves(movelist, level, underprom);
+    else
+    {
+        n_checks = Mvgen_White_King_In_Check_Info(check_attacks, &n_check_pieces);
+        move_cnt = Mvgen_Find_All_White_Evasions(movelist, check_attacks, n_checks, n_check_pieces, underprom);
+    }
+    for (i = 0, legal_cnt = 0; i < move_cnt; i++)
+    {
+        if (Mvgen_White_Move_Is_Legal(movelist[i], &pins))
+            movelist[legal_cnt++].u = movelist[i].u;
+    }
+    return(legal_cnt);
+}
+
+int Mvgen_Find_All_Black_Legal_Moves(MOVE *restrict movelist, int level, int underprom)
+{
+    MOVE check_attacks[CHECKLISTLEN];
+    PIN_INFO pins;
+    int n_checks, n_check_pieces, move_cnt, i, legal_cnt;
+
+    Mvgen_Black_Pin_Info(&pins);
+    if (!pins.in_check)
+        move_cnt = Mvgen_Find_All_Black_Moves(movelist, level, underprom);
+    else
+    {
+        n_checks = Mvgen_Black_King_In_Check_Info(check_attacks, &n_check_pieces);
+        move_cnt = Mvgen_Find_All_Black_Evasions(movelist, check_attacks, n_checks, n_check_pieces, underprom);
+    }
+    for (i = 0, legal_cnt = 0; i < move_cnt; i++)
+    {
+        if (Mvgen_Black_Move_Is_Legal(movelist[i], &pins))
+            movelist[legal_cnt++].u = movelist[i].u;
+    }
+    return(legal_cnt);
+}
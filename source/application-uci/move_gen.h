@@ -19,12 +19,14 @@
  *
  */
 
+void  Mvgen_Init(void);
 CMOVE Mvgen_Compress_Move(MOVE board_move);
 MOVE  Mvgen_Decompress_Move(CMOVE comp_move);
 int Mvgen_White_King_In_Check_Info(MOVE *restrict attack_movelist, int *restrict attackers);
 int Mvgen_Black_King_In_Check_Info(MOVE *restrict attack_movelist, int *restrict attackers);
 int Mvgen_White_King_In_Check(void);
 int Mvgen_Black_King_In_Check(void);
+int Mvgen_Last_Move_Gives_Check(void);
 int Mvgen_Find_All_White_Evasions(MOVE *restrict movelist, const MOVE *restrict attack_movelist,
                                   int n_attack_moves, int n_attacking_pieces, int underprom);
 int Mvgen_Find_All_Black_Evasions(MOVE *restrict movelist, const MOVE *restrict attack_movelist,
@@ -37,6 +39,14 @@ int Mvgen_Check_Move_Legality(MOVE move, enum E_COLOUR colour);
 void Mvgen_Add_White_King_Moves(PIECE *piece, MOVE *restrict movelist, int *restrict nextfree);
 void Mvgen_Add_Black_King_Moves(PIECE *piece, MOVE *restrict movelist, int *restrict nextfree);
 
+/*legal move generation and legality test without make/unmake*/
+void Mvgen_White_Pin_Info(PIN_INFO *restrict pins);
+void Mvgen_Black_Pin_Info(PIN_INFO *restrict pins);
+int Mvgen_White_Move_Is_Legal(MOVE move, const PIN_INFO *restrict pins);
+int Mvgen_Black_Move_Is_Legal(MOVE move, const PIN_INFO *restrict pins);
+int Mvgen_Find_All_White_Legal_Moves(MOVE *restrict movelist, int level, int underprom);
+int Mvgen_Find_All_Black_Legal_Moves(MOVE *restrict movelist, int level, int underprom);
+
 /*for the UCI move parser*/
 int Mvgen_Find_All_White_Moves_Piece(MOVE *restrict movelist, int level, int underprom, int from_sq);
 int Mvgen_Find_All_Black_Moves_Piece(MOVE *restrict movelist, int level, int underprom, int from_sq);
@@ -50,3 +60,6 @@ macros and not functions for sparing the call overhead.*/
 #define Mvgen_Find_All_Captures_And_Promotions(movelist, colour, underprom) ((colour == WHITE) ? (Mvgen_Find_All_White_Captures_And_Promotions(movelist, underprom)) : (Mvgen_Find_All_Black_Captures_And_Promotions(movelist, underprom)))
 #define Mvgen_Opp_Colour(colour) ((colour == WHITE) ? (BLACK) : (WHITE))
 #define Mvgen_Find_All_Moves_Piece(movelist, level, underprom, from_sq, colour) ((colour == WHITE) ? Mvgen_Find_All_White_Moves_Piece(movelist, level, underprom, from_sq) : Mvgen_Find_All_Black_Moves_Piece(movelist, level, underprom, from_sq))
+#define Mvgen_Pin_Info(pins, colour) ((colour == WHITE) ? Mvgen_White_Pin_Info(pins) : Mvgen_Black_Pin_Info(pins))
+#define Mvgen_Move_Is_Legal(move, pins, colour) ((colour == WHITE) ? Mvgen_White_Move_Is_Legal(move, pins) : Mvgen_Black_Move_Is_Legal(move, pins))
+#define Mvgen_Find_All_Legal_Moves(movelist, lvl, colour, underprom) ((colour == WHITE) ? (Mvgen_Find_All_White_Legal_Moves(movelist, lvl, underprom)) : (Mvgen_Find_All_Black_Legal_Moves(movelist, lvl, underprom)))
@@ -116,6 +116,12 @@
 #else
 /*for getting the Posix threads, clock_gettime and nanosleep functions with C99.*/
 #define _POSIX_C_SOURCE 200809L
+#ifdef __linux__
+/*for MAP_ANONYMOUS, MAP_HUGETLB and madvise().*/
+#define _DEFAULT_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <pthread.h>
 #endif
 
@@ -137,6 +143,9 @@
 #include "hashtables.h"
 #include "eval.h"
 #include "search.h"
+#ifdef CTLIB
+#include "libct800.h"
+#endif
 
 #if   (TARGET_BUILD == 32)
     #define TARGET_BUILD_STRING "32"
@@ -149,40 +158,42 @@
 
 /*--------- global variables ------------*/
 
-GAME_INFO game_info;
+THREAD_LOCAL GAME_INFO game_info;
 
 /* ------------- MAKE MOVE DEFINITIONS ----------------*/
 
 /*bits 0-8: for gflags
 bits 9-15: for en passant square
 +1 because MAX_STACK is odd, and we can keep the alignment here*/
-uint16_t cstack[MAX_STACK+1];
-int cst_p;
+THREAD_LOCAL uint16_t cstack[MAX_STACK+1];
+THREAD_LOCAL int cst_p;
 
-MVST move_stack[MAX_STACK+1];
+THREAD_LOCAL MVST move_stack[MAX_STACK+1];
 
 /* ---------- TRANSPOSITION TABLE DEFINITIONS ------------- */
-uintptr_t MAX_TT;
+THREAD_LOCAL uintptr_t MAX_TT;
 
-TT_ST *T_T = NULL;
-TT_ST *Opp_T_T = NULL;
+THREAD_LOCAL TT_ST *T_T = NULL;
+THREAD_LOCAL TT_ST *Opp_T_T = NULL;
 
-/*pawn hash table*/
-TT_PTT_ST P_T_T[PMAX_TT+1];
+/*pawn hash table, one per search thread. PMAX_TT is in buckets.*/
+THREAD_LOCAL uintptr_t PMAX_TT;
+THREAD_LOCAL TT_PTT_BUCKET_ST *P_T_T = NULL;
+/*the pawn hash tables of the helper threads, indexed by the thread id. they
+  are allocated with the options "Threads" and "Pawn Hash" and kept across
+  searches, like the one of the main thread.*/
+TT_PTT_BUCKET_ST *helper_p_t_t[THREADS_MAX];
 
-/*separate table to avoid padding of the P_T_T table.*/
-TT_PTT_ROOK_ST P_T_T_Rooks[PMAX_TT+1];
-
-unsigned int hash_clear_counter;
+THREAD_LOCAL unsigned int hash_clear_counter;
 
 /* -------------------- GLOBALS ------------------------- */
 
-PIECE Wpieces[16];
-PIECE Bpieces[16];
+THREAD_LOCAL PIECE Wpieces[16];
+THREAD_LOCAL PIECE Bpieces[16];
 PIECE empty_p = {NULL, NULL,  0, 0, 0};
 PIECE fence_p = {NULL, NULL, -1,-1,-1};
 
-PIECE *board[120] = {
+THREAD_LOCAL PIECE *board[120] = {
     &fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,
     &fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,&fence_p,
     &fence_p,&empty_p,&empty_p,&empty_p,&empty_p,&empty_p,&empty_p,&empty_p,&empty_p,&fence_p,
@@ -256,11 +267,11 @@ const int8_t ColNum[120] = {
 /*for move masking except MVV/LVA value*/
 static const MOVE mv_move_mask = {{0xFFU, 0xFFU, 0xFFU, 0}};
 
-int wking, bking;
-int en_passant_sq;
-unsigned int gflags; /*bit masks, see ctdefs.h*/
+THREAD_LOCAL int wking, bking;
+THREAD_LOCAL int en_passant_sq;
+THREAD_LOCAL unsigned int gflags; /*bit masks, see ctdefs.h*/
 
-int mv_stack_p;
+THREAD_LOCAL int mv_stack_p;
 
 /********** set UCI options **********/
 /*activate debug output, for both threads*/
@@ -274,37 +285,79 @@ enum E_CURRMOVE show_currmove;
 /*contempt settings*/
 int contempt_val;
 int contempt_end;
+#ifndef CTLIB
 static int elo_max;
+#endif
+/*number of search threads*/
+int search_threads;
+/*search statistics after every search*/
+int search_stats_output;
+/*number of reported PV lines. per thread because library contexts can
+  search in parallel with different settings.*/
+THREAD_LOCAL int search_multipv;
 /********** end UCI options **********/
 
-uint64_t g_nodes, g_max_nodes;
-uint64_t tb_hits;
-int Starting_Mv;
-enum E_COLOUR computer_side;
-int32_t start_moves;
-int fifty_moves;
-static int start_fifty_moves;
-int game_started_from_0;
+THREAD_LOCAL uint64_t g_nodes;
+THREAD_LOCAL uint64_t g_max_nodes;
+THREAD_LOCAL uint64_t tb_hits;
+THREAD_LOCAL int Starting_Mv;
+THREAD_LOCAL enum E_COLOUR computer_side;
+THREAD_LOCAL int32_t start_moves;
+THREAD_LOCAL int fifty_moves;
+static THREAD_LOCAL int start_fifty_moves;
+THREAD_LOCAL int game_started_from_0;
 
-LINE GlobalPV;
-static MOVE player_move;
+THREAD_LOCAL LINE GlobalPV;
+static THREAD_LOCAL MOVE player_move;
 
-int dynamic_resign_threshold; /*not used in UCI version*/
+THREAD_LOCAL int dynamic_resign_threshold; /*not used in UCI version*/
 
-static unsigned int abort_calc;
+#ifndef CTLIB
+static unsigned int abort_calc, ponder_hit;
 static unsigned int cmd_read_idx, cmd_write_idx;
 static char cmd_buf[CMD_BUF_SIZE + 32L];
 
-/*flag for disabling output during the startup speed calibration*/
-static unsigned int no_output;
+/*flag for disabling output during the startup speed calibration and the
+  bench. per thread so that the input thread can still answer "isready".*/
+static THREAD_LOCAL unsigned int no_output;
 
-/*trackers for the perft test with intermediate abort check.*/
+/*the configured main hash size in MB, restored after the bench.*/
+static size_t hash_size_mb;
+
+/*trackers for the perft test with intermediate abort check. the counters
+  are per thread with the parallel perft.*/
 static int64_t perft_start_time;
-static uint64_t perft_nodes;
-static uint64_t perft_check_nodes;
-static uint64_t perft_nps_10ms;
-static int abort_perft;
+static THREAD_LOCAL uint64_t perft_nodes;
+static THREAD_LOCAL uint64_t perft_check_nodes;
+static THREAD_LOCAL uint64_t perft_nps_10ms;
+static THREAD_LOCAL int abort_perft;
 static int perft_depth;
+
+/*root moves of the perft, handed out to the threads one by one, and the
+  node count per root move.*/
+static MOVE perft_root_moves[MAXMV];
+static uint64_t perft_move_nodes[MAXMV];
+static int perft_root_cnt;
+static int perft_next_move;
+static enum E_COLOUR perft_colour;
+/*the nodes counted per thread, also in unfinished root moves, and whether
+  any thread has been aborted. read after the threads have finished.*/
+static uint64_t perft_thread_nodes[THREADS_MAX];
+static int perft_aborted;
+
+/*the optional perft hash table. the check word is the position hash XORed
+  with the data, which are the node count and the depth in the lowest byte.*/
+#define PERFT_DEPTH_KEY     0x9E3779B97F4A7C15ULL
+
+typedef struct perft_tt_st
+{
+    uint64_t check;
+    uint64_t data;
+} PERFT_TT_ST;
+
+static PERFT_TT_ST *perft_tt;
+static uintptr_t perft_tt_mask;
+#endif
 
 /*under Posix, CLOCK_MONOTONIC is optional.
   cond_clock is for pthread conditions, main_clock for the application
@@ -313,20 +366,21 @@ static int perft_depth;
   instead.*/
 #ifdef CLOCK_MONOTONIC
     static const int ct_main_clock_mode = CLOCK_MONOTONIC;
-    #ifndef CTWIN
+    #if (!defined(CTWIN)) && (!defined(CTLIB))
         /*no pthread conditions under Windows. note that
           ct_cond_clock_mode may fall back to real time.*/
         static int ct_cond_clock_mode = CLOCK_MONOTONIC;
     #endif
 #else
     static const int ct_main_clock_mode = CLOCK_REALTIME;
-    #ifndef CTWIN
+    #if (!defined(CTWIN)) && (!defined(CTLIB))
         /*no pthread conditions under Windows.*/
         static const int ct_cond_clock_mode = CLOCK_REALTIME;
     #endif
 #endif
 
 /*all the locking is done only in this file, using wrapper functions.*/
+#ifndef CTLIB
 #ifdef CTWIN
     static CRITICAL_SECTION io_lock;
     static CRITICAL_SECTION print_lock;
@@ -363,11 +417,22 @@ static int perft_depth;
     #define Play_Acquire_Lock(x) (void) pthread_mutex_lock(x)
     #define Play_Release_Lock(x) (void) pthread_mutex_unlock(x)
 #endif
+#endif
+
+/*helper threads for the parallel search*/
+#ifdef CTWIN
+    static HANDLE helper_threads[THREADS_MAX];
+#else
+    static pthread_t helper_threads[THREADS_MAX];
+#endif
+static int helper_thread_ids[THREADS_MAX];
+static int helper_thread_cnt;
+/*what the helper threads run: the parallel search or the perft.*/
+static void (*helper_thread_func)(int thread_id);
 
 /* -------------- UTILITY FUNCTIONS ---------------------------------- */
 
-#ifdef CTWIN
-#else
+#if (!defined(CTWIN)) && (!defined(CTLIB))
 /*adds two times in timespec format and takes care of potential overflow.*/
 static void Play_Timespec_Add(struct timespec* dst, const struct timespec* src1, const struct timespec* src2)
 {
@@ -406,6 +471,7 @@ static void Play_Sleep(int32_t millisecs)
 #endif
 }
 
+#ifndef CTLIB
 /*pauses the UCI processing (worker) thread when waiting for UCI input
   from the input thread. In engine "idle" state, the input thread is
   blocking on stdin, and the UCI thread is blocking on the event. This
@@ -458,6 +524,26 @@ unsigned int Play_Get_Abort(void)
     return(current_state);
 }
 
+/*sets the "ponderhit" flag. the input thread resets it with every "go"
+  command so that it cannot get out of order with the searches.*/
+static void Play_Set_Ponder_Hit(unsigned int new_state)
+{
+    Play_Acquire_Lock(&abort_check_lock);
+    ponder_hit = new_state;
+    Play_Release_Lock(&abort_check_lock);
+}
+
+/*retrieves the "ponderhit" flag, which is polled by the search while
+  pondering.*/
+unsigned int Play_Get_Ponder_Hit(void)
+{
+    unsigned int current_state;
+    Play_Acquire_Lock(&abort_check_lock);
+    current_state = ponder_hit;
+    Play_Release_Lock(&abort_check_lock);
+    return(current_state);
+}
+
 /*the following functions handle the event driven infrastructure of the
   abort flag.*/
 /*used in throttled mode or when waiting with infinite move time.*/
@@ -493,12 +579,10 @@ void Play_Wait_For_Abort_Event(int32_t millisecs)
 #endif
 }
 
-/*sets the abort flag, which is polled in normal search, and the event,
-  which is used for waiting in throttled mode and when waiting with infinite
-  move time.*/
-static void Play_Set_Abort_Event(void)
+/*wakes up the search thread if it is waiting in throttled mode or with
+  infinite move time.*/
+static void Play_Signal_Abort_Event(void)
 {
-    Play_Set_Abort(1U);
 #ifdef CTWIN
     SetEvent(abort_event);
 #else
@@ -509,6 +593,23 @@ static void Play_Set_Abort_Event(void)
 #endif
 }
 
+/*sets the abort flag, which is polled in normal search, and the event,
+  which is used for waiting in throttled mode and when waiting with infinite
+  move time.*/
+static void Play_Set_Abort_Event(void)
+{
+    Play_Set_Abort(1U);
+    Play_Signal_Abort_Event();
+}
+
+/*"ponderhit" uses the same event because a ponder search may be waiting
+  like with infinite move time.*/
+static void Play_Set_Ponder_Hit_Event(void)
+{
+    Play_Set_Ponder_Hit(1U);
+    Play_Signal_Abort_Event();
+}
+
 /*after issueing the abort flag to the search thread, the input thread
   waits for the UCI thread to process the stop/quit command.*/
 static void Play_Wait_For_Abort_Event_Confirmation(int32_t millisecs)
@@ -611,7 +712,289 @@ static void Play_Set_Cmd_Work(void)
     (void) pthread_mutex_unlock(&cmd_work_lock);
 #endif
 }
+#endif
+
+/*the helper threads of the parallel search only run during the search and
+  are joined afterwards, so that the position setup between the searches
+  never competes with running helpers.*/
+static
+#ifdef CTWIN
+unsigned __stdcall
+#else
+void *
+#endif
+Play_Helper_Thrd(void *data)
+{
+    helper_thread_func(*((const int *) data));
+#ifdef CTWIN
+    return(0);
+#else
+    return(NULL);
+#endif
+}
+
+/*starts up to helper_cnt helper threads that run thread_func. returns the
+  number of threads that could actually be started, which may be less if the
+  system refuses.*/
+static int Play_Start_Threads(void (*thread_func)(int thread_id), int helper_cnt)
+{
+    int i;
+
+    helper_thread_func = thread_func;
+    if (helper_cnt > THREADS_MAX - 1)
+        helper_cnt = THREADS_MAX - 1;
+
+    for (i = 0; i < helper_cnt; i++)
+    {
+        helper_thread_ids[i] = i + 1; /*thread 0 is the main search thread*/
+#ifdef CTWIN
+        helper_threads[i] = (HANDLE) _beginthreadex(NULL, 0, Play_Helper_Thrd, &helper_thread_ids[i], 0, NULL);
+        if (helper_threads[i] == 0)
+            break;
+#else
+        if (pthread_create(&helper_threads[i], NULL, Play_Helper_Thrd, &helper_thread_ids[i]) != 0)
+            break;
+#endif
+    }
+    helper_thread_cnt = i;
+    return(i);
+}
+
+/*starts up to helper_cnt helper threads for the parallel search.*/
+int Play_Start_Helper_Threads(int helper_cnt)
+{
+    return(Play_Start_Threads(Search_Helper_Thread, helper_cnt));
+}
+
+/*waits until all helper threads have finished. the caller has to signal
+  them to stop before.*/
+void Play_Join_Helper_Threads(void)
+{
+    int i;
+
+    for (i = 0; i < helper_thread_cnt; i++)
+    {
+#ifdef CTWIN
+        WaitForSingleObject(helper_threads[i], INFINITE);
+        CloseHandle(helper_threads[i]);
+#else
+        (void) pthread_join(helper_threads[i], NULL);
+#endif
+    }
+    helper_thread_cnt = 0;
+}
+
+/*the main hash tables can be several GB big. under Linux, they are taken
+  from explicit huge pages if the system has reserved enough of them, or
+  otherwise from normal pages advised for transparent huge pages. this saves
+  most of the TLB misses. elsewhere, or if mmap() fails, calloc() is used.
+  the returned memory is zeroed and starts on a cache line. the header with
+  the real allocation is stored in the cache line before it.*/
+#define HASH_MEM_ALIGN      64U
+#define HUGE_PAGE_SIZE      (2UL*1024UL*1024UL)
+
+typedef struct hash_mem_hdr_st
+{
+    void *raw;
+    size_t raw_size;
+    int is_mapped;
+} HASH_MEM_HDR;
+
+/*for the debug output: which kind of pages the last allocation got.*/
+static THREAD_LOCAL const char *hash_mem_pages;
+
+static void *Play_Set_Hash_Mem_Hdr(void *raw, size_t raw_size, int is_mapped, uintptr_t mem)
+{
+    HASH_MEM_HDR *hdr = (HASH_MEM_HDR *) (mem - HASH_MEM_ALIGN);
+    hdr->raw = raw;
+    hdr->raw_size = raw_size;
+    hdr->is_mapped = is_mapped;
+    return((void *) mem);
+}
+
+void *Play_Alloc_Hash_Mem(size_t bytes)
+{
+    void *raw;
+    size_t raw_size;
+    uintptr_t mem;
+
+#if defined(__linux__) && !defined(CTWIN)
+    if (bytes >= HUGE_PAGE_SIZE)
+    {
+#ifdef MAP_HUGETLB
+        raw_size = (bytes + HASH_MEM_ALIGN + HUGE_PAGE_SIZE - 1U) & ~(HUGE_PAGE_SIZE - 1U);
+        raw = mmap(NULL, raw_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (raw != MAP_FAILED)
+        {
+            hash_mem_pages = "explicit huge";
+            return(Play_Set_Hash_Mem_Hdr(raw, raw_size, 1, (uintptr_t) raw + HASH_MEM_ALIGN));
+        }
+#endif
+        /*one more huge page so that the table can start on a huge page boundary.*/
+        raw_size = bytes + HASH_MEM_ALIGN + HUGE_PAGE_SIZE;
+        raw = mmap(NULL, raw_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != MAP_FAILED)
+        {
+            mem = ((uintptr_t) raw + HASH_MEM_ALIGN + HUGE_PAGE_SIZE - 1U) & ~((uintptr_t) (HUGE_PAGE_SIZE - 1U));
+            hash_mem_pages = "normal";
+#ifdef MADV_HUGEPAGE
+            if (madvise((void *) mem, bytes, MADV_HUGEPAGE) == 0)
+                hash_mem_pages = "transparent huge";
+#endif
+            return(Play_Set_Hash_Mem_Hdr(raw, raw_size, 1, mem));
+        }
+    }
+#endif
+    hash_mem_pages = "normal";
+    raw_size = bytes + 2U * HASH_MEM_ALIGN;
+    raw = calloc(1, raw_size);
+    if (raw == NULL)
+        return(NULL);
+    mem = ((uintptr_t) raw + 2U * HASH_MEM_ALIGN - 1U) & ~((uintptr_t) (HASH_MEM_ALIGN - 1U));
+    return(Play_Set_Hash_Mem_Hdr(raw, raw_size, 0, mem));
+}
+
+void Play_Free_Hash_Mem(void *mem)
+{
+    HASH_MEM_HDR *hdr;
+
+    if (mem == NULL)
+        return;
+    hdr = (HASH_MEM_HDR *) ((uintptr_t) mem - HASH_MEM_ALIGN);
+#if defined(__linux__) && !defined(CTWIN)
+    if (hdr->is_mapped)
+    {
+        (void) munmap(hdr->raw, hdr->raw_size);
+        return;
+    }
+#endif
+    free(hdr->raw);
+}
+
+/*maps a saved hash table from the file. the mapping is private so that the
+  search does not write back to the file, and the pages are only read when
+  they are used. the file page before the table takes the memory header.
+  returns NULL if mapping is not possible; the caller reads the file then.*/
+void *Play_Map_Hash_File(const char *file_name, uint64_t data_offset, size_t bytes)
+{
+#if defined(__linux__) && !defined(CTWIN)
+    struct stat file_stat;
+    void *raw;
+    size_t raw_size;
+    int fd;
+
+    if (data_offset < HASH_FILE_PAGE)
+        return(NULL);
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return(NULL);
+    /*accessing a mapping beyond the end of the file would crash.*/
+    if ((fstat(fd, &file_stat) != 0) || ((uint64_t) file_stat.st_size < data_offset + bytes))
+    {
+        (void) close(fd);
+        return(NULL);
+    }
+    raw_size = bytes + HASH_FILE_PAGE;
+    raw = mmap(NULL, raw_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t) (data_offset - HASH_FILE_PAGE));
+    (void) close(fd);
+    if (raw == MAP_FAILED)
+        return(NULL);
+#ifdef MADV_WILLNEED
+    /*start reading in the background.*/
+    (void) madvise(raw, raw_size, MADV_WILLNEED);
+#endif
+    return(Play_Set_Hash_Mem_Hdr(raw, raw_size, 1, (uintptr_t) raw + HASH_FILE_PAGE));
+#else
+    (void) file_name;
+    (void) data_offset;
+    (void) bytes;
+    return(NULL);
+#endif
+}
+
+/*clearing is split among the configured search threads, but each thread
+  gets at least HASH_CLEAR_CHUNK bytes because starting threads also costs.*/
+#define HASH_CLEAR_CHUNK    (64UL*1024UL*1024UL)
+
+typedef struct hash_clear_st
+{
+    uint8_t *start;
+    size_t len;
+} HASH_CLEAR_ST;
+
+static
+#ifdef CTWIN
+unsigned __stdcall
+#else
+void *
+#endif
+Play_Clear_Thrd(void *data)
+{
+    const HASH_CLEAR_ST *job = (const HASH_CLEAR_ST *) data;
+    memset(job->start, 0, job->len);
+#ifdef CTWIN
+    return(0);
+#else
+    return(NULL);
+#endif
+}
+
+void Play_Clear_Hash_Mem(void *mem, size_t bytes)
+{
+    HASH_CLEAR_ST jobs[THREADS_MAX];
+#ifdef CTWIN
+    HANDLE clear_threads[THREADS_MAX];
+#else
+    pthread_t clear_threads[THREADS_MAX];
+#endif
+    size_t chunk;
+    int i, job_cnt, started;
+
+    job_cnt = search_threads;
+    if ((size_t) job_cnt > bytes / HASH_CLEAR_CHUNK)
+        job_cnt = (int) (bytes / HASH_CLEAR_CHUNK);
+    if (job_cnt <= 1)
+    {
+        memset(mem, 0, bytes);
+        return;
+    }
+
+    chunk = (bytes / (size_t) job_cnt) & ~((size_t) (HASH_MEM_ALIGN - 1U));
+    for (i = 0; i < job_cnt; i++)
+    {
+        jobs[i].start = (uint8_t *) mem + (size_t) i * chunk;
+        jobs[i].len = (i < job_cnt - 1) ? chunk : bytes - (size_t) i * chunk;
+    }
+
+    /*job 0 is done by the calling thread, also any job whose thread
+      cannot be started.*/
+    for (i = 1, started = 1; i < job_cnt; i++, started++)
+    {
+#ifdef CTWIN
+        clear_threads[i] = (HANDLE) _beginthreadex(NULL, 0, Play_Clear_Thrd, &jobs[i], 0, NULL);
+        if (clear_threads[i] == 0)
+            break;
+#else
+        if (pthread_create(&clear_threads[i], NULL, Play_Clear_Thrd, &jobs[i]) != 0)
+            break;
+#endif
+    }
+    for (i = started; i < job_cnt; i++)
+        (void) Play_Clear_Thrd(&jobs[i]);
+    (void) Play_Clear_Thrd(&jobs[0]);
+
+    for (i = 1; i < started; i++)
+    {
+#ifdef CTWIN
+        WaitForSingleObject(clear_threads[i], INFINITE);
+        CloseHandle(clear_threads[i]);
+#else
+        (void) pthread_join(clear_threads[i], NULL);
+#endif
+    }
+}
 
+#ifndef CTLIB
 /*actually, the C stdio functions like fgets and fputs could have been used,
   but there's already a whole lot of buffering going on in the engine.
   plus that it's easier to test when the buffering scheme is the same on
@@ -803,85 +1186,164 @@ int Play_Read_Input(char *buf, int buf_len)
     } while (ch != '\n');
     return(read_idx);
 }
+#endif
 
 /*default values:
 12 Bytes per TT entry, and there are two TTs. (MAX_TT)
-8 Bytes per PTT entry, and there is one PTT. (PMAX_TT)
-2 Bytes per rook TT entry, and there is one rook TT. (PMAX_TT)
+with TT_BUCKETS, 64 Bytes per TT bucket, and there is one TT.
 
-The pawn hash table size is fixed with 16k entries and takes
-up 10 bytes per entry, i.e. 160 kB. Still has about 95 % hit rate,
-so increasing that isn't useful.
+The pawn hash table has its own size setting and is not part of this.
 
-The default hash table size is 848 kB (counting both hash tables)*/
-static int Play_Set_Hashtables(size_t hash_size)
+The default hash table size is 768 kB (counting both hash tables)*/
+static uintptr_t Play_Get_TT_Max(size_t hash_size)
 {
-    size_t multiplier, pawn_hash_size, table_size_default, tt_size;
-    static size_t last_hash_size = 0;
+    size_t multiplier, table_size_default;
 
     if (hash_size < HASH_MIN)
         hash_size = HASH_MIN; /*1 MB minimum*/
     if (hash_size > HASH_MAX)
-        hash_size = HASH_MAX; /*1 GB maximum*/
+        hash_size = HASH_MAX;
 
     hash_size *= 1024; /*now in kilobytes*/
 
-    pawn_hash_size = ((sizeof(TT_PTT_ROOK_ST) + sizeof(TT_PTT_ST)) * (PMAX_TT+1)) / 1024;
-    table_size_default = (sizeof(TT_ST) * 2 * DEF_MAX_TT) / 1024;
+    table_size_default = (sizeof(TT_ST) * TT_TABLES * DEF_MAX_TT) / 1024;
 
-    for (multiplier = 1; 2 * multiplier * table_size_default + pawn_hash_size <= hash_size; multiplier *= 2)
+    for (multiplier = 1; 2 * multiplier * table_size_default <= hash_size; multiplier *= 2)
     {
         ;
     }
 
-    MAX_TT  = DEF_MAX_TT * multiplier;
-    MAX_TT--;
+    return((uintptr_t) (DEF_MAX_TT * multiplier - 1));
+}
+
+/*clears the pawn hash tables of the main and the helper threads.*/
+static void Play_Clear_Pawn_Tables(void)
+{
+    int i;
+
+    Hash_Clear_Pawn_Table();
+    for (i = 1; i < THREADS_MAX; i++)
+    {
+        if (helper_p_t_t[i] != NULL)
+            Play_Clear_Hash_Mem(helper_p_t_t[i], (PMAX_TT + 1) * sizeof(TT_PTT_BUCKET_ST));
+    }
+}
+
+#ifndef CTLIB
+static int Play_Set_Hashtables(size_t hash_size)
+{
+    char printbuf[64];
+    static size_t last_hash_size = 0;
+
+    MAX_TT = Play_Get_TT_Max(hash_size);
 
     /*clear pawn hash tables: probably also intended when setting the hash size.*/
-    memset(P_T_T,       0, (PMAX_TT+1)*sizeof(TT_PTT_ST));
-    memset(P_T_T_Rooks, 0, (PMAX_TT+1)*sizeof(TT_PTT_ROOK_ST));
+    Play_Clear_Pawn_Tables();
 
     /*freeing and allocating the same hash size doesn't make sense.*/
     if ((last_hash_size == MAX_TT) && (T_T != NULL) && (Opp_T_T != NULL))
     {
         Hash_Clear_Tables();
+        hash_size_mb = hash_size;
         if (uci_debug) Play_Print("info string debug: redundant hash size setting, hash cleared.\n");
         return(0);
     }
 
     /*free existing hash tables.*/
-    if (T_T     != NULL) free(T_T);
-    if (Opp_T_T != NULL) free(Opp_T_T);
+    Hash_Free_Tables(T_T, Opp_T_T);
 
-    T_T     = (TT_ST *) calloc(MAX_TT + CLUSTER_SIZE, sizeof(TT_ST));
-    Opp_T_T = (TT_ST *) calloc(MAX_TT + CLUSTER_SIZE, sizeof(TT_ST));
-
-    if ((T_T == NULL) || (Opp_T_T == NULL))
+    if (Hash_Alloc_Tables(MAX_TT, &T_T, &Opp_T_T))
     {
-        if (T_T     != NULL) free(T_T);
-        if (Opp_T_T != NULL) free(Opp_T_T);
-
-        T_T = Opp_T_T = NULL;
         last_hash_size = 0;
         return(1);
     }
 
     /*force the OS to actually blend in the pages.*/
-    tt_size = MAX_TT + CLUSTER_SIZE;
-    tt_size *= sizeof(TT_ST);
-
-    memset(T_T,     42, tt_size);
-    memset(Opp_T_T, 42, tt_size);
-    __sync_synchronize();
+    Hash_Clear_Tables();
 
-    memset(T_T,     0, tt_size);
-    memset(Opp_T_T, 0, tt_size);
-    __sync_synchronize();
+    if (uci_debug)
+    {
+        sprintf(printbuf, "info string debug: hash tables on %s pages.\n", hash_mem_pages);
+        Play_Print(printbuf);
+    }
 
     last_hash_size = (size_t) MAX_TT;
+    hash_size_mb = hash_size;
     return(0);
 }
 
+/*the pawn hash tables of the helper threads 1 to helper_cnt, with the size
+  of the main thread's table. tables beyond helper_cnt are freed. returns
+  the number of helper tables that are available.*/
+static int Play_Set_Helper_Pawn_Tables(int helper_cnt)
+{
+    static uintptr_t helper_pmax_tt = 0;
+    int i;
+
+    if (helper_cnt > THREADS_MAX - 1)
+        helper_cnt = THREADS_MAX - 1;
+
+    /*after a size change, all helper tables are reallocated.*/
+    if (helper_pmax_tt != PMAX_TT)
+    {
+        for (i = 1; i < THREADS_MAX; i++)
+        {
+            Hash_Free_Pawn_Table(helper_p_t_t[i]);
+            helper_p_t_t[i] = NULL;
+        }
+        helper_pmax_tt = PMAX_TT;
+    }
+
+    for (i = helper_cnt + 1; i < THREADS_MAX; i++)
+    {
+        Hash_Free_Pawn_Table(helper_p_t_t[i]);
+        helper_p_t_t[i] = NULL;
+    }
+
+    for (i = 1; i <= helper_cnt; i++)
+    {
+        if (helper_p_t_t[i] != NULL)
+            continue;
+        if (Hash_Alloc_Pawn_Table(PMAX_TT, &helper_p_t_t[i]))
+        {
+            helper_p_t_t[i] = NULL;
+            break;
+        }
+        /*force the OS to actually blend in the pages, not during the search.*/
+        Play_Clear_Hash_Mem(helper_p_t_t[i], (PMAX_TT + 1) * sizeof(TT_PTT_BUCKET_ST));
+    }
+    return(i - 1);
+}
+
+/*the pawn hash tables of the main search thread and of the helper threads
+  for the configured number of threads. returns 1 if a table cannot be
+  allocated; the main table and the helper tables up to the failure are
+  still valid then.*/
+static int Play_Set_Pawn_Hashtable(size_t pawn_hash_size)
+{
+    uintptr_t pmax_tt = Hash_Get_Pawn_TT_Max(pawn_hash_size);
+    int helper_cnt = search_threads - 1;
+
+    if (helper_cnt < 0)
+        helper_cnt = 0;
+
+    if ((P_T_T != NULL) && (PMAX_TT == pmax_tt))
+    {
+        Play_Clear_Pawn_Tables();
+    } else
+    {
+        Hash_Free_Pawn_Table(P_T_T);
+        P_T_T = NULL;
+        if (Hash_Alloc_Pawn_Table(pmax_tt, &P_T_T))
+            return(1);
+        PMAX_TT = pmax_tt;
+        /*force the OS to actually blend in the pages.*/
+        Hash_Clear_Pawn_Table();
+    }
+    return((Play_Set_Helper_Pawn_Tables(helper_cnt) < helper_cnt) ? 1 : 0);
+}
+#endif
+
 static void Play_Init_Pieces(void)
 {
     int i;
@@ -986,8 +1448,7 @@ static void Play_Empty_Board(void)
 static void Play_Reset_Position_Status(void)
 {
     Hash_Clear_Tables();
-    memset(P_T_T,       0, (PMAX_TT+1)*sizeof(TT_PTT_ST));
-    memset(P_T_T_Rooks, 0, (PMAX_TT+1)*sizeof(TT_PTT_ROOK_ST));
+    Play_Clear_Pawn_Tables();
     memset(&GlobalPV, 0, sizeof(GlobalPV));
     hash_clear_counter = 0;
     game_info.valid = EVAL_INVALID;
@@ -999,7 +1460,7 @@ static void Play_Reset_Position_Status(void)
 
 char *Play_Translate_Moves(MOVE m)
 {
-    static char mov[6];
+    static THREAD_LOCAL char mov[6];
 
     if (m.u != MV_NO_MOVE_MASK)
     {
@@ -1135,27 +1596,6 @@ static void Play_Update_Special_Conditions(MOVE amove)
         fifty_moves++;
 }
 
-static void Play_Update_Fifty_Moves(void)
-{
-    int i = mv_stack_p;
-
-    fifty_moves = 0;
-
-    while (i > 0) /*the stack entry 0 itself does NOT contain a valid move.*/
-    {
-        if (!(move_stack[i].captured->type /* capture */ || move_stack[i].move.m.flag>1 /* pawn move */))
-            fifty_moves++;
-        else /*we just hit the most recent pawn or capture move, so stop the search.*/
-            return;
-        i--;
-    }
-
-    /*we have been searching back right to the starting position, which can
-    be an entered one, and no resetting move has been found. So add upp the
-    initial 50 move counter, which can also be an entered one.*/
-    fifty_moves += start_fifty_moves;
-}
-
 /*checks whether a move is in a move list.*/
 int Play_Move_Is_Valid(MOVE key_move, const MOVE *restrict movelist, int move_cnt)
 {
@@ -1798,19 +2238,24 @@ static enum E_POS_VALID Play_Read_FEN_Position(char *fen_line)
     return(POS_OK);
 }
 
-/*perft with evasions and UCI "stop" / "quit" check.
+#ifndef CTLIB
+/*perft with the legal move generator and UCI "stop" / "quit" check.
   UCI "stop" or "quit" can abort the perft.
   must be called with depth >= 1 because the depth check is in the move
-  loop: this saves useless function calls at the leaves.*/
-static void Play_Perft(int depth, enum E_COLOUR colour)
+  loop: this saves useless function calls at the leaves. the last ply is
+  bulk counted because the legal move count is the number of leaf nodes.
+  with the perft hash table, subtrees from depth 2 on are looked up by
+  position hash and depth. returns the number of leaf nodes.*/
+static uint64_t Play_Perft(int depth, enum E_COLOUR colour)
 {
     MOVE movelist[MAXMV];
-    static MOVE check_attacks_buf[CHECKLISTLEN]; /*static saves stack*/
+    PERFT_TT_ST *entry = NULL;
+    uint64_t pos_hash = 0, nodes;
     enum E_COLOUR next_colour;
-    int move_cnt, i, n_checks, n_check_pieces;
+    int move_cnt, i;
 
     if (abort_perft)
-        return;
+        return(0);
 
     /*is the abort flag check due?
       should be checked every 10 ms using node rate auto calibration.*/
@@ -1821,7 +2266,7 @@ static void Play_Perft(int depth, enum E_COLOUR colour)
         {
             /*UCI "stop" or "quit" has been issued.*/
             abort_perft = 1;
-            return;
+            return(0);
         }
 
         perft_total_time = Play_Get_Millisecs() - perft_start_time;
@@ -1847,55 +2292,310 @@ static void Play_Perft(int depth, enum E_COLOUR colour)
         }
     }
 
-    /*if in check, use evasions.*/
-    if (colour == WHITE)
+    /*the position hash covers the side to move, castling rights and en
+      passant. the depth is in the lowest byte of the data.*/
+    if ((perft_tt != NULL) && (depth >= 2))
     {
-        n_checks = Mvgen_White_King_In_Check_Info(check_attacks_buf, &n_check_pieces);
+        uint64_t data;
 
-        if (n_checks == 0)
-            move_cnt = Mvgen_Find_All_White_Moves(movelist, NO_LEVEL, UNDERPROM);
-        else
-            move_cnt = Mvgen_Find_All_White_Evasions(movelist, check_attacks_buf, n_checks, n_check_pieces, UNDERPROM);
+        pos_hash = move_stack[mv_stack_p].mv_pos_hash;
+        entry = &(perft_tt[(pos_hash ^ ((uint64_t) depth * PERFT_DEPTH_KEY)) & perft_tt_mask]);
+        data = entry->data;
+        if (((entry->check ^ data) == pos_hash) && ((data & 0xFFU) == (unsigned) depth))
+        {
+            nodes = data >> 8;
+            perft_nodes += nodes;
+            return(nodes);
+        }
+    }
 
-        next_colour = BLACK;
-    } else
+    move_cnt = Mvgen_Find_All_Legal_Moves(movelist, NO_LEVEL, colour, UNDERPROM);
+
+    if (depth == 1) /*recursion ends*/
     {
-        n_checks = Mvgen_Black_King_In_Check_Info(check_attacks_buf, &n_check_pieces);
+        perft_nodes += move_cnt;
+        return((uint64_t) move_cnt);
+    }
 
-        if (n_checks == 0)
-            move_cnt = Mvgen_Find_All_Black_Moves(movelist, NO_LEVEL, UNDERPROM);
-        else
-            move_cnt = Mvgen_Find_All_Black_Evasions(movelist, check_attacks_buf, n_checks, n_check_pieces, UNDERPROM);
+    next_colour = Mvgen_Opp_Colour(colour);
+    for (i = 0, nodes = 0; i < move_cnt; i++)
+    {
+        Search_Push_Status();
+        Search_Make_Move(movelist[i]);
+        nodes += Play_Perft(depth - 1, next_colour);
+        Search_Retract_Last_Move();
+        Search_Pop_Status();
+    }
 
-        next_colour = WHITE;
+    /*always replace. the threads write without locking, but the check word
+      is the key XORed with the data so that a torn entry does not match.*/
+    if ((entry != NULL) && (!abort_perft))
+    {
+        uint64_t data = (nodes << 8) | (uint64_t) depth;
+        entry->data = data;
+        entry->check = pos_hash ^ data;
     }
+    return(nodes);
+}
 
-    if (depth == 1) /*recursion ends*/
+/*the perft threads take the root moves one by one until all are done.*/
+static void Play_Perft_Root_Moves(int thread_id)
+{
+    enum E_COLOUR next_colour = Mvgen_Opp_Colour(perft_colour);
+    int i;
+
+    perft_nodes = 0;
+    perft_check_nodes = PERFT_CHECK_NODES;
+    perft_nps_10ms = 0;
+    abort_perft = 0;
+
+    while ((i = ATOMIC_FETCH_INC(&perft_next_move)) < perft_root_cnt)
     {
-        int illegal_move_cnt = 0;
-        for (i = 0; i < move_cnt; i++)
-        {
-            Search_Push_Status();
-            Search_Make_Move(movelist[i]);
-            if (Mvgen_King_In_Check(colour))
-                illegal_move_cnt++;
-            Search_Retract_Last_Move();
-            Search_Pop_Status();
-        }
-        perft_nodes += move_cnt - illegal_move_cnt;
-    } else
+        uint64_t nodes;
+
+        Search_Push_Status();
+        Search_Make_Move(perft_root_moves[i]);
+        if (perft_depth > 1)
+            nodes = Play_Perft(perft_depth - 1, next_colour);
+        else
+            nodes = 1;
+        Search_Retract_Last_Move();
+        Search_Pop_Status();
+        if (abort_perft)
+        {
+            perft_aborted = 1;
+            break;
+        }
+        perft_move_nodes[i] = nodes;
+    }
+    perft_thread_nodes[thread_id] = perft_nodes;
+}
+
+/*entry point of the additional perft threads.*/
+static void Play_Perft_Thread(int thread_id)
+{
+    Search_Load_Root_Position();
+    Play_Perft_Root_Moves(thread_id);
+}
+
+/*runs the perft with the configured number of threads, each with its own
+  board. with perft_hash > 0, a perft hash table of that many MB is shared
+  by the threads for the duration of the run. with divide, the node count
+  of every root move is printed. returns the total node count. if the
+  perft is aborted, *aborted is set, and the returned count also includes
+  the nodes of the unfinished root moves.*/
+static uint64_t Play_Perft_Root(int depth, enum E_COLOUR colour, int divide, int64_t perft_hash, int *aborted)
+{
+    char printbuf[64];
+    uint64_t total_nodes;
+    int i, thread_cnt;
+
+    *aborted = 0;
+    if (depth <= 0)
+        return(1ULL);
+
+    perft_depth = depth;
+    perft_colour = colour;
+    perft_root_cnt = Mvgen_Find_All_Legal_Moves(perft_root_moves, NO_LEVEL, colour, UNDERPROM);
+    perft_next_move = 0;
+    memset(perft_move_nodes, 0, sizeof(perft_move_nodes));
+    memset(perft_thread_nodes, 0, sizeof(perft_thread_nodes));
+    perft_aborted = 0;
+
+    perft_tt = NULL;
+    if ((perft_hash > 0) && (depth >= 3))
+    {
+        uintptr_t entries;
+
+        if (perft_hash > HASH_MAX) perft_hash = HASH_MAX;
+        for (entries = 1; entries * 2U * sizeof(PERFT_TT_ST) <= (uint64_t) perft_hash * 1024ULL * 1024ULL; entries *= 2U)
+            ;
+        perft_tt = (PERFT_TT_ST *) Play_Alloc_Hash_Mem(entries * sizeof(PERFT_TT_ST));
+        perft_tt_mask = entries - 1U;
+        if (perft_tt == NULL)
+            Play_Print("info string error (can't alloc perft hash table: running without)\n");
+    }
+
+    thread_cnt = 0;
+    if ((search_threads > 1) && (perft_root_cnt > 1) && (depth >= 3))
+    {
+        int helper_cnt = search_threads - 1;
+        if (helper_cnt > perft_root_cnt - 1)
+            helper_cnt = perft_root_cnt - 1;
+        Search_Save_Root_Position();
+        thread_cnt = Play_Start_Threads(Play_Perft_Thread, helper_cnt);
+    }
+
+    Play_Perft_Root_Moves(0);
+
+    if (thread_cnt > 0)
+        Play_Join_Helper_Threads();
+
+    if (perft_tt != NULL)
     {
-        depth--;
-        for (i = 0; i < move_cnt; i++)
+        Play_Free_Hash_Mem(perft_tt);
+        perft_tt = NULL;
+    }
+
+    for (i = 0, total_nodes = 0; i < perft_root_cnt; i++)
+    {
+        total_nodes += perft_move_nodes[i];
+        if (divide)
         {
-            Search_Push_Status();
-            Search_Make_Move(movelist[i]);
-            if (!Mvgen_King_In_Check(colour))
-                Play_Perft(depth, next_colour);
-            Search_Retract_Last_Move();
-            Search_Pop_Status();
+            sprintf(printbuf, "info string perft move %s nodes %"PRIu64"\n",
+                              Play_Translate_Moves(perft_root_moves[i]), perft_move_nodes[i]);
+            Play_Print(printbuf);
         }
     }
+
+    if (perft_aborted)
+    {
+        *aborted = 1;
+        for (i = 0, total_nodes = 0; i <= thread_cnt; i++)
+            total_nodes += perft_thread_nodes[i];
+    }
+    return(total_nodes);
+}
+
+/*fixed positions for the "bench" command: middle games, endgames including
+  KP:K and KBN:K, and mate positions.*/
+static const char *const bench_positions[] = {
+    "startpos",
+    "fen rnbqkb1r/pp1p1ppp/2p2n2/4p3/2B1P3/2N5/PPPP1PPP/R1BQK1NR w KQkq - 0 1",
+    "fen r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 1",
+    "fen r1b2rk1/2q1bppp/p2p1n2/np2p3/3PP3/5N1P/PPBN1PP1/R1BQR1K1 w - - 0 1",
+    "fen 2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB3PPP/R2QR1K1 w - - 0 1",
+    "fen r2q1rk1/ppp2ppp/2n1bn2/2b1p3/3pP3/3P1NPP/PPP1NPB1/R1BQ1RK1 b - - 0 1",
+    "fen r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "fen 6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "fen 8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1",
+    "fen 8/8/8/3k4/8/8/3PK3/8 w - - 0 1",
+    "fen 8/8/8/4k3/8/8/8/KBN5 w - - 0 1",
+    "fen r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+    "fen r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1",
+    "fen 2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1"
+};
+
+#define BENCH_POSITIONS ((int) (sizeof(bench_positions) / sizeof(bench_positions[0])))
+
+/*searches the bench positions to a fixed depth, each from cleared hash
+  tables. that is single threaded and without book, throttling or noise so
+  that the node counts only depend on the hash size and the depth. the
+  signature is a CRC over the node counts and best moves of all positions;
+  it must not change unless the search tree changes.
+  afterwards, the hash size is restored, and the position is the initial
+  one as after "ucinewgame". returns 1 if the hash tables could not be
+  restored, else 0.*/
+static int Play_Bench(int64_t bench_hash, int depth)
+{
+    char fen_buf[128], printbuf[256];
+    uint64_t bench_data[2 * BENCH_POSITIONS];
+    uint64_t total_nodes = 0, nps;
+    int64_t total_time = 0;
+    size_t used_hash_size = hash_size_mb;
+    unsigned int saved_book = disable_book;
+    int32_t saved_noise = eval_noise;
+    int saved_threads = search_threads, saved_multipv = search_multipv;
+    int saved_contempt_val = contempt_val, saved_contempt_end = contempt_end;
+    int i, positions;
+
+    if (bench_hash <= 0) bench_hash = BENCH_HASH_DEFAULT;
+    if (depth <= 0) depth = BENCH_DEPTH_DEFAULT;
+    /*clip to valid range*/
+    if (bench_hash < HASH_MIN) bench_hash = HASH_MIN;
+    if (bench_hash > HASH_MAX) bench_hash = HASH_MAX;
+    if (depth > MAX_DEPTH-1) depth = MAX_DEPTH-1;
+
+    if (Play_Set_Hashtables((size_t) bench_hash) != 0)
+    {
+        sprintf(printbuf, "info string error (can't alloc %"PRId64" MB hash tables for bench)\n", bench_hash);
+        Play_Print(printbuf);
+        if (Play_Set_Hashtables(used_hash_size) != 0)
+            return(1);
+        return(0);
+    }
+
+    disable_book = 1;
+    eval_noise = 0;
+    search_threads = 1;
+    search_multipv = 1;
+    contempt_val = CONTEMPT_VAL;
+    contempt_end = CONTEMPT_END;
+    g_max_nodes = 0;
+    memset(bench_data, 0, sizeof(bench_data));
+
+    for (i = 0, positions = 0; i < BENCH_POSITIONS; i++)
+    {
+        MOVE amove, pmove;
+        uint64_t spent_nodes = 0;
+        int64_t spent_time = 0;
+        enum E_COLOUR side;
+
+        strcpy(fen_buf, bench_positions[i]);
+        (void) Play_Read_FEN_Position(fen_buf);
+        Hash_Init_Stack();
+        if (gflags & BLACK_MOVED) side = WHITE; else side = BLACK;
+        Play_Reset_Position_Status();
+
+        dynamic_resign_threshold = NO_RESIGN;
+        game_info.eval = 0;
+        computer_side = side;
+        pmove.u = MV_NO_MOVE_MASK;
+        amove.u = MV_NO_MOVE_MASK;
+
+        /*no search output, but "readyok" from the input thread must still go out.*/
+        no_output = 1;
+        (void) Search_Get_Best_Move(&amove, pmove, INFINITE_TIME - 42LL, 0, 0, depth, 100,
+                                    MAX_THROTTLE_KNPS * 1000ULL, side, NULL, 0, 0, 0, 0,
+                                    &spent_nodes, &spent_time);
+        no_output = 0;
+        computer_side = NONE;
+
+        if (Play_Get_Abort()) /*UCI "stop" or "quit"*/
+            break;
+
+        bench_data[2*i]     = spent_nodes;
+        bench_data[2*i + 1] = Mvgen_Compress_Move(amove);
+        total_nodes += spent_nodes;
+        total_time  += spent_time;
+        positions++;
+
+        sprintf(printbuf, "info string bench position %d nodes %"PRIu64" time %"PRId64" bestmove %s\n",
+                          i + 1, spent_nodes, spent_time, Play_Translate_Moves(amove));
+        Play_Print(printbuf);
+    }
+
+    if (total_time > 0)
+        nps = (total_nodes * 1000ULL) / total_time;
+    else
+        nps = 0;
+
+    if (positions == BENCH_POSITIONS)
+    {
+        sprintf(printbuf, "info string bench hash %"PRId64" depth %d nodes %"PRIu64" time %"PRId64" nps %"PRIu64" signature %08"PRIX32"\n",
+                          bench_hash, depth, total_nodes, total_time, nps,
+                          Util_Crc32(bench_data, sizeof(bench_data)));
+    } else
+    {
+        sprintf(printbuf, "info string bench aborted after %d positions, nodes %"PRIu64" time %"PRId64" nps %"PRIu64"\n",
+                          positions, total_nodes, total_time, nps);
+    }
+    Play_Print(printbuf);
+
+    disable_book = saved_book;
+    eval_noise = saved_noise;
+    search_threads = saved_threads;
+    search_multipv = saved_multipv;
+    contempt_val = saved_contempt_val;
+    contempt_end = saved_contempt_end;
+
+    Play_Set_Starting_Position();
+    if (Play_Set_Hashtables(used_hash_size) != 0)
+        return(1);
+    Play_Reset_Position_Status();
+    return(0);
 }
 
 /*get the data from the ring buffer. guarded with a mutex because this isn't
@@ -2073,7 +2773,7 @@ static int64_t Play_Time_Increment(int64_t remaining_time, int64_t increment)
 }
 
 static void Play_UCI_Process_Go(const char *line, int *exact_time, int *max_depth,
-                                uint64_t *max_nodes, int *ponder_mode, MOVE *ponder_move,
+                                uint64_t *max_nodes, int *ponder_mode,
                                 int64_t *wmove_time, int64_t *bmove_time, int *mate_mode,
                                 int *mate_depth_mv, MOVE *given_moves, int *given_moves_len)
 {
@@ -2091,7 +2791,6 @@ static void Play_UCI_Process_Go(const char *line, int *exact_time, int *max_dept
     *wmove_time = INFINITE_TIME - 42LL;
     *bmove_time = INFINITE_TIME - 42LL;
     *ponder_mode = 0;
-    ponder_move->u = MV_NO_MOVE_MASK;
     *given_moves_len = 0;
     *mate_mode = 0;
     *mate_depth_mv = 0;
@@ -2101,6 +2800,11 @@ static void Play_UCI_Process_Go(const char *line, int *exact_time, int *max_dept
         uci_go_token = Play_UCI_Go_Get_Next_Token(line, &line_index, token, &value);
         if (uci_go_token == TOKEN_TEXT)
         {
+            if (!strcmp(token, "ponder")) /*at the end of the line*/
+            {
+                *ponder_mode = 1;
+                continue;
+            }
             if (!strcmp(token, "infinite"))
             {
                 *exact_time = 1;
@@ -2190,16 +2894,18 @@ static void Play_UCI_Process_Go(const char *line, int *exact_time, int *max_dept
             }
             if (!strcmp(token, "ponder"))
             {
-                /*next item should be a move*/
-                if (Play_Parse_Move(line + line_index, ponder_move))
+                /*the ponder move is already part of the position. a move
+                  after "ponder" is not standard UCI, just jump over it.*/
+                MOVE ponder_move;
+                if (Play_Parse_Move(line + line_index, &ponder_move))
                 {
                     line_index += 4;
                     if ((line[line_index] != ' ') && (line[line_index] != 0))
                         line_index++; /*jump over promotion parameter*/
                     if (line[line_index] == ' ')
                         line_index++; /*to next item*/
-                    *ponder_mode = 1;
                 }
+                *ponder_mode = 1;
                 continue;
             }
         }
@@ -2298,7 +3004,7 @@ static void Play_Gather_Cont_Pos(MOVE ct_move, int side, uint64_t *cont_pos_hash
     Search_Make_Move(ct_move); /*the CT answer move*/
 
     side = Mvgen_Opp_Colour(side);
-    move_cnt = Mvgen_Find_All_Moves(movelist, NO_LEVEL, side, UNDERPROM);
+    move_cnt = Mvgen_Find_All_Legal_Moves(movelist, NO_LEVEL, side, UNDERPROM);
 
     /*get the expected opponent's answer, if available. minimum PV length
       must be 3, or else we don't have an answering move anyway.*/
@@ -2315,15 +3021,12 @@ static void Play_Gather_Cont_Pos(MOVE ct_move, int side, uint64_t *cont_pos_hash
     {
         Search_Push_Status();
         Search_Make_Move(movelist[i]);
-        if (!Mvgen_King_In_Check(side))
+        if (((movelist[i].u ^ pv_move.u) & mv_move_mask.u) == 0)
         {
-            if (((movelist[i].u ^ pv_move.u) & mv_move_mask.u) == 0)
-            {
-                *cont_pos_pv = actual_moves;
-            }
-            cont_pos_hashes[actual_moves] = move_stack[mv_stack_p].mv_pos_hash;
-            actual_moves++;
+            *cont_pos_pv = actual_moves;
         }
+        cont_pos_hashes[actual_moves] = move_stack[mv_stack_p].mv_pos_hash;
+        actual_moves++;
         Search_Retract_Last_Move();
         Search_Pop_Status();
     }
@@ -2333,6 +3036,7 @@ static void Play_Gather_Cont_Pos(MOVE ct_move, int side, uint64_t *cont_pos_hash
     Search_Retract_Last_Move(); /*the CT answer move*/
     Search_Pop_Status();
 }
+#endif
 
 /*get the next move from the "position" list and return the move string length*/
 static int Play_Get_Next_Pos_Move(const char *command_string, char *move_string)
@@ -2349,6 +3053,8 @@ static int Play_Get_Next_Pos_Move(const char *command_string, char *move_string)
     return(i);
 }
 
+#ifndef CTLIB
+
 static void Play_Conv_Elo_Nps(int elo_throttle, int elo_setting, int cpu_speed,
                               uint64_t max_nps_rate, int32_t noise_setting, int64_t move_time,
                               int *restrict effective_cpu_speed,
@@ -2474,11 +3180,12 @@ static void Play_UCI(void)
 {
     static char ALIGN_4 line[CMD_UCI_LEN + 16]; /*static saves stack*/
     static char ALIGN_4 valid_pos_str[CMD_UCI_LEN + 16];
+    static char hash_file_name[HASH_FILE_NAME_LEN];
     static unsigned int valid_pos_len=0;
     char command[32], printbuf[512];
     static uint64_t cont_pos_hashes[MAXMV];
     uint64_t old_pos_hash=0;
-    int cont_pos_num=0, cont_pos_pv=-1, keep_hash;
+    int cont_pos_num=0, cont_pos_pv=-1, keep_hash, hash_file_map, ponder_aged=0, ponder_missed;
     int side, pos_illegal=0, max_depth, ponder_mode=0, exact_time=0;
     int given_moves_len=0, mate_mode, mate_depth_mv, move_overhead, uci_data_ready;
     int cpu_speed, elo_setting, elo_throttle;
@@ -2501,6 +3208,11 @@ static void Play_UCI(void)
     contempt_val = CONTEMPT_VAL; /*avoid early draw unless the engine is worse than -30*/
     contempt_end = CONTEMPT_END; /*in plies from the start position*/
     uci_debug = 0;               /*no debug output*/
+    search_threads = THREADS_DEFAULT; /*single threaded search*/
+    search_multipv = MULTIPV_DEFAULT; /*only the best line*/
+    search_stats_output = 0;     /*statistics only with the "stats" command*/
+    hash_file_name[0] = '\0';   /*no file for saving/loading the hash tables*/
+    hash_file_map = 0;           /*read the hash file instead of mapping it*/
 
     side = WHITE;
     max_depth = MAX_DEPTH-1;
@@ -2546,7 +3258,7 @@ static void Play_UCI(void)
             Play_Print(printbuf);
         }
 
-        if ((!strcmp(command, "go")) || ((!strcmp(command, "ponderhit")) && (ponder_mode)))
+        if (!strcmp(command, "go"))
         {
             enum E_COMP_RESULT search_res;
 
@@ -2561,47 +3273,16 @@ static void Play_UCI(void)
                 continue;
             }
 
-            /*if "ponderhit" arrives, just calculate on the given move list.
-              ponder isn't supported, so this is hacking around GUIs that
-              might expect support.*/
-            if (!strcmp(command, "go"))
-            {
-                MOVE ponder_move;
-
-                if (ponder_mode) /*should not even happen?!*/
-                {
-                    Search_Retract_Last_Move();
-                    Search_Pop_Status();
-                    Play_Update_Fifty_Moves();
-                    side = Mvgen_Opp_Colour(side);
-                    ponder_mode = 0;
-                }
-
-                Play_UCI_Process_Go(line, &exact_time, &max_depth, &g_max_nodes,
-                                   &ponder_mode, &ponder_move, &wmove_time,
-                                   &bmove_time, &mate_mode, &mate_depth_mv,
-                                   given_moves, &given_moves_len);
+            /*with "go ponder", the position already contains the expected
+              opponent move. the search runs on the opponent's time until
+              "ponderhit" turns it into the regular search, which is handled
+              in the input thread and in the search, or until "stop".*/
+            Play_UCI_Process_Go(line, &exact_time, &max_depth, &g_max_nodes,
+                               &ponder_mode, &wmove_time,
+                               &bmove_time, &mate_mode, &mate_depth_mv,
+                               given_moves, &given_moves_len);
 
-                if (side == WHITE) move_time = wmove_time; else move_time = bmove_time;
-
-                if (ponder_mode)
-                {
-                    if (!Play_Move_Is_Legal(ponder_move, side))
-                    {
-                        /*hope for a valid position/moves command. there should not be
-                          a ponderhit for an illegal move anyway.*/
-                        pos_illegal = 1;
-                        continue;
-                    }
-                    Play_Update_Special_Conditions(ponder_move);
-                    Search_Push_Status();
-                    Search_Make_Move(ponder_move);
-                    side = Mvgen_Opp_Colour(side);
-                    continue;
-                }
-            }
-
-            if (!strcmp(command, "ponderhit")) ponder_mode = 0;
+            if (side == WHITE) move_time = wmove_time; else move_time = bmove_time;
 
             /*is the position the continued game, or is it the same as
             last time, or something different?*/
@@ -2643,11 +3324,16 @@ static void Play_UCI(void)
                         } else
                             player_move.u = MV_NO_MOVE_MASK;
 
-                        /*increase the hash age counter because we're one move further.*/
-                        if (hash_clear_counter < MAX_AGE_CNT)
-                            hash_clear_counter++;
-                        else
-                            hash_clear_counter = 0;
+                        /*increase the hash age counter because we're one move further,
+                          unless that has already been done for the missed ponder
+                          search of the same move.*/
+                        if (!ponder_aged)
+                        {
+                            if (hash_clear_counter < MAX_AGE_CNT)
+                                hash_clear_counter++;
+                            else
+                                hash_clear_counter = 0;
+                        }
                         if (uci_debug)
                             Play_Print("info string debug: keeping hash tables, continued position.\n");
                     } else /*game doesn't continue*/
@@ -2676,6 +3362,7 @@ static void Play_UCI(void)
                 if (uci_debug)
                     Play_Print("info string debug: keeping hash tables deactivated.\n");
             }
+            ponder_aged = 0;
 
             dynamic_resign_threshold = NO_RESIGN;
             game_info.valid = EVAL_INVALID;
@@ -2694,7 +3381,7 @@ static void Play_UCI(void)
                                                   exact_time, max_depth, effective_cpu_speed,
                                                   effective_max_nps_rate, side, given_moves,
                                                   given_moves_len, mate_mode, mate_depth_mv,
-                                                  &spent_nodes, &spent_time);
+                                                  ponder_mode, &spent_nodes, &spent_time);
             }
 
             if (game_info.valid == EVAL_MOVE)
@@ -2747,24 +3434,49 @@ static void Play_UCI(void)
             /*avoid a nearly useless sprintf here - optimise for bullet games.*/
             {
                 char *mv_str = Play_Translate_Moves(amove);
+                int len = 13;
                 strcpy(printbuf, "bestmove ");
                 printbuf[9]  = mv_str[0];
                 printbuf[10] = mv_str[1];
                 printbuf[11] = mv_str[2];
                 printbuf[12] = mv_str[3];
-                if (mv_str[4] == '\0') /*no promotion move*/
-                {
-                    printbuf[13] = '\n';
-                    printbuf[14] = '\0';
-                } else
+                if (mv_str[4] != '\0') /*promotion move*/
+                    printbuf[len++] = mv_str[4];
+
+                /*the expected answer from the PV for pondering.*/
+                if ((GlobalPV.line_len >= 2) &&
+                    (GlobalPV.line_cmoves[0] == Mvgen_Compress_Move(amove)))
                 {
-                    printbuf[13] = mv_str[4];
-                    printbuf[14] = '\n';
-                    printbuf[15] = '\0';
+                    mv_str = Play_Translate_Moves(Mvgen_Decompress_Move(GlobalPV.line_cmoves[1]));
+                    strcpy(printbuf + len, " ponder ");
+                    len += 8;
+                    printbuf[len++] = mv_str[0];
+                    printbuf[len++] = mv_str[1];
+                    printbuf[len++] = mv_str[2];
+                    printbuf[len++] = mv_str[3];
+                    if (mv_str[4] != '\0') /*promotion move*/
+                        printbuf[len++] = mv_str[4];
                 }
+                printbuf[len++] = '\n';
+                printbuf[len] = '\0';
             }
+
+            /*sample the ponderhit flag before "bestmove" goes out because the
+              input thread resets it as soon as the GUI sends the next "go".*/
+            ponder_missed = ((ponder_mode) && (!Play_Get_Ponder_Hit()));
             Play_Print(printbuf);
 
+            /*after a ponder miss, the GUI will send the actual position, which
+              continues the game from the last regular search. only the PV does
+              not apply anymore, and the hash age counter has already been
+              increased for this move.*/
+            if (ponder_missed)
+            {
+                cont_pos_pv = -1;
+                ponder_aged = 1;
+                continue;
+            }
+
             /*store the hashes of the continued game - on the opponent's time.*/
             Play_Gather_Cont_Pos(amove, side, cont_pos_hashes, &cont_pos_num, &cont_pos_pv);
 
@@ -2782,7 +3494,6 @@ static void Play_UCI(void)
             if (*fen_line == ' ') fen_line++; /*following whitespace*/
 
             pos_illegal = 0; /*assume that something good will follow*/
-            ponder_mode = 0;
 
             for (mv_line_ptr = fen_line; *mv_line_ptr != 'm' && *mv_line_ptr != '\0'; mv_line_ptr++) ;
 
@@ -2964,7 +3675,6 @@ static void Play_UCI(void)
         if (!strcmp(command, "ucinewgame"))
         {
             pos_illegal = 0;
-            ponder_mode = 0;
             old_pos_hash = 0;
             cont_pos_num = 0;
             cont_pos_pv = -1;
@@ -3013,6 +3723,43 @@ static void Play_UCI(void)
                 Play_Set_Cmd_Work();
                 continue;
             }
+            if (!strncmp(line+9, " name pawn hash value ", 22))
+            {
+                int64_t pawn_hash_size=0;
+                size_t used_hash_size;
+
+                sscanf(line, "setoption name pawn hash value %"SCNd64, &pawn_hash_size);
+                /*clip to valid range*/
+                if (pawn_hash_size < PAWN_HASH_MIN) pawn_hash_size = PAWN_HASH_MIN;
+                if (pawn_hash_size > PAWN_HASH_MAX) pawn_hash_size = PAWN_HASH_MAX;
+
+                /*same retry scheme as for the main hash tables.*/
+                for (used_hash_size = pawn_hash_size; used_hash_size >= PAWN_HASH_MIN; used_hash_size /= 2)
+                {
+                    if (Play_Set_Pawn_Hashtable(used_hash_size) == 0)
+                        break;
+                    if (used_hash_size == PAWN_HASH_MIN) /*failed despite minimum value*/
+                    {
+                        if (P_T_T == NULL)
+                        {
+                            Play_Print("info string error (can't alloc pawn hash table: exiting)\n");
+                            return;
+                        }
+                        /*the main thread has its table, but not all helpers.*/
+                        search_threads = Play_Set_Helper_Pawn_Tables(search_threads - 1) + 1;
+                        sprintf(printbuf, "info string error (can't alloc pawn hash tables: reducing threads to %d)\n", search_threads);
+                        Play_Print(printbuf);
+                        break;
+                    }
+                }
+                if (used_hash_size < (size_t) pawn_hash_size)
+                {
+                    sprintf(printbuf, "info string error (can't alloc pawn hash table: reducing to %"PRId64" MB)\n", (int64_t) used_hash_size);
+                    Play_Print(printbuf);
+                }
+                Play_Set_Cmd_Work();
+                continue;
+            }
             if (!strncmp(line+9, " name keep hash tables value ", 29))
             {
                 if (!strncmp(line+38, "true", 4))
@@ -3027,6 +3774,96 @@ static void Play_UCI(void)
                 Play_Print("info hashfull 0\n");
                 continue;
             }
+            if (!strncmp(line+9, " name hash file mapping value ", 30))
+            {
+                if (!strncmp(line+39, "true", 4))
+                    hash_file_map = 1;
+                else if (!strncmp(line+39, "false", 5))
+                    hash_file_map = 0;
+                continue;
+            }
+            if (!strncmp(line+9, " name hash file value", 21))
+            {
+                /*the file name is the rest of the line with its case kept.*/
+                const char *file_name = line + 30;
+                size_t name_len;
+
+                if (*file_name == ' ')
+                    file_name++;
+                name_len = strlen(file_name);
+                while ((name_len > 0) && (file_name[name_len - 1] == ' '))
+                    name_len--;
+                if ((name_len == 7) && (!strncmp(file_name, "<empty>", 7)))
+                    name_len = 0;
+                if (name_len >= HASH_FILE_NAME_LEN)
+                {
+                    Play_Print("info string error (hash file name too long)\n");
+                    continue;
+                }
+                memcpy(hash_file_name, file_name, name_len);
+                hash_file_name[name_len] = '\0';
+                continue;
+            }
+            if ((!strncmp(line+9, " name save hash", 15)) ||
+                (!strncmp(line+9, " name load hash", 15)))
+            {
+                enum E_HASH_FILE hash_file_res;
+                int do_load = (line[15] == 'l');
+
+                if (hash_file_name[0] == '\0')
+                {
+                    Play_Print("info string error (no hash file configured)\n");
+                    Play_Set_Cmd_Work();
+                    continue;
+                }
+                if (do_load)
+                    hash_file_res = Hash_Load_Tables(hash_file_name, hash_file_map);
+                else
+                    hash_file_res = Hash_Save_Tables(hash_file_name);
+
+                switch (hash_file_res)
+                {
+                case HASH_FILE_OK:
+                    strcpy(printbuf, (do_load) ? "info string hash tables loaded.\n" : "info string hash tables saved.\n");
+                    break;
+                case HASH_FILE_MAPPED:
+                    strcpy(printbuf, "info string hash tables mapped.\n");
+                    break;
+                case HASH_FILE_OPEN:
+                    strcpy(printbuf, "info string error (can't open hash file)\n");
+                    break;
+                case HASH_FILE_IO:
+                    strcpy(printbuf, "info string error (hash file read/write failed)\n");
+                    break;
+                case HASH_FILE_KEYS:
+                    strcpy(printbuf, "info string error (hash file from other hash keys)\n");
+                    break;
+                case HASH_FILE_SIZE:
+                    strcpy(printbuf, "info string error (hash file from other hash size)\n");
+                    break;
+                case HASH_FILE_CRC:
+                    strcpy(printbuf, "info string error (hash file checksum mismatch)\n");
+                    break;
+                case HASH_FILE_FORMAT:
+                default:
+                    strcpy(printbuf, "info string error (no valid hash file)\n");
+                    break;
+                }
+                Play_Print(printbuf);
+
+                if ((do_load) && ((hash_file_res == HASH_FILE_OK) || (hash_file_res == HASH_FILE_MAPPED)))
+                {
+                    /*like after "ucinewgame" so that the next position does
+                      not reset the loaded tables, but without clearing them.*/
+                    old_pos_hash = 0;
+                    cont_pos_num = 0;
+                    cont_pos_pv = -1;
+                    memset(&GlobalPV, 0, sizeof(GlobalPV));
+                    player_move.u = MV_NO_MOVE_MASK;
+                }
+                Play_Set_Cmd_Work();
+                continue;
+            }
             if (!strncmp(line+9, " name contempt value [cps] value ", 33))
             {
                 int32_t value=0;
@@ -3091,6 +3928,14 @@ static void Play_UCI(void)
                     show_currmove = CURR_UPDATE;
                 continue;
             }
+            if (!strncmp(line+9, " name search statistics value ", 30))
+            {
+                if (!strncmp(line+39, "true", 4))
+                    search_stats_output = 1;
+                else if (!strncmp(line+39, "false", 5))
+                    search_stats_output = 0;
+                continue;
+            }
             if (!strncmp(line+9, " name uci_limitstrength value ", 30))
             {
                 if (!strncmp(line+39, "true", 4))
@@ -3139,6 +3984,35 @@ static void Play_UCI(void)
                 move_overhead = value;
                 continue;
             }
+            if (!strncmp(line+9, " name threads value ", 20))
+            {
+                int32_t value=0, helper_cnt;
+                sscanf(line, "setoption name threads value %"SCNd32, &value);
+                /*clip to valid range*/
+                if (value < THREADS_MIN) value = THREADS_MIN;
+                if (value > THREADS_MAX) value = THREADS_MAX;
+                /*every helper thread needs its own pawn hash table.*/
+                helper_cnt = Play_Set_Helper_Pawn_Tables(value - 1);
+                if (helper_cnt < value - 1)
+                {
+                    value = helper_cnt + 1;
+                    sprintf(printbuf, "info string error (can't alloc pawn hash tables: reducing threads to %"PRId32")\n", value);
+                    Play_Print(printbuf);
+                }
+                search_threads = value;
+                Play_Set_Cmd_Work();
+                continue;
+            }
+            if (!strncmp(line+9, " name multipv value ", 20))
+            {
+                int32_t value=0;
+                sscanf(line, "setoption name multipv value %"SCNd32, &value);
+                /*clip to valid range*/
+                if (value < MULTIPV_MIN) value = MULTIPV_MIN;
+                if (value > MULTIPV_MAX) value = MULTIPV_MAX;
+                search_multipv = value;
+                continue;
+            }
             if (!strncmp(line+9, " name eval noise [%] value ", 27))
             {
                 int32_t value=0;
@@ -3157,52 +4031,89 @@ static void Play_UCI(void)
         {
             if (line[5] == ' ') /*parameter follows*/
             {
-                int64_t total_time;
-                uint64_t nps;
-                int depth=0;
+                int64_t total_time, perft_hash=0;
+                uint64_t nps, total_nodes;
+                int depth=0, divide, aborted;
+                const char *hash_param;
 
+                /*"perft <depth> [divide] [hash <MB>]"*/
                 sscanf(line, "perft %d", &depth);
+                divide = (strstr(line, " divide") != NULL);
+                hash_param = strstr(line, " hash ");
+                if (hash_param != NULL)
+                    sscanf(hash_param, " hash %"SCNd64, &perft_hash);
                 /*clip to valid range*/
                 if (depth < 0) depth = 0;
                 if (depth > 20) depth = 20;
-                perft_depth = depth;
-                perft_nodes = 0;
-                perft_check_nodes = PERFT_CHECK_NODES;
-                perft_nps_10ms = 0;
-                abort_perft = 0;
 
                 perft_start_time = Play_Get_Millisecs();
-                if (depth > 0)
-                    Play_Perft(depth, side);
-                else
-                    perft_nodes = 1;
+                total_nodes = Play_Perft_Root(depth, side, divide, perft_hash, &aborted);
                 total_time = Play_Get_Millisecs() - perft_start_time;
                 if (total_time > 0)
-                    nps = (perft_nodes * 1000ULL) / total_time;
+                    nps = (total_nodes * 1000ULL) / total_time;
                 else
                     nps = 0;
 
-                sprintf(printbuf, "info string perft depth %d nodes %"PRIu64" time %"PRId64" nps %"PRIu64"\n",
-                                  depth, perft_nodes, total_time, nps);
+                sprintf(printbuf, "info string perft %sdepth %d nodes %"PRIu64" time %"PRId64" nps %"PRIu64"\n",
+                                  (aborted) ? "aborted " : "", depth, total_nodes, total_time, nps);
                 Play_Print(printbuf);
             }
             continue;
         }
+
+        if (!strcmp(command, "bench"))
+        {
+            int64_t bench_hash=0;
+            int depth=0;
+
+            /*both parameters are optional.*/
+            sscanf(line, "bench %"SCNd64" %d", &bench_hash, &depth);
+            if (Play_Bench(bench_hash, depth) != 0)
+            {
+                Play_Print("info string error (can't alloc hash tables: exiting)\n");
+                return;
+            }
+
+            /*the bench leaves the initial position, like "ucinewgame".*/
+            pos_illegal = 0;
+            old_pos_hash = 0;
+            cont_pos_num = 0;
+            cont_pos_pv = -1;
+            valid_pos_len = 0;
+            side = WHITE;
+            continue;
+        }
+
+        if (!strcmp(command, "stats"))
+        {
+            /*of the last search, also after a ponder or infinite search
+              that the GUI has stopped.*/
+            Search_Print_Stats();
+            continue;
+        }
     }
 }
 
 /*answer to the "uci" command*/
 static void Play_Print_UCI_Info(void)
 {
-    char printbuf[1536];
+    char printbuf[2048];
 
     /*putting everything into one buffer results in only one write() system call.*/
 
     sprintf(printbuf, "id name " VERSION_INFO_DIALOGUE_LINE_1 " " TARGET_BUILD_STRING " bit\n" \
                "id author Rasmus Althoff\n" \
-               "option name Hash type spin default 8 min 1 max 1024\n" \
+               "option name Hash type spin default %d min %d max %d\n" \
+               "option name Pawn Hash type spin default %d min %d max %d\n" \
+               "option name Threads type spin default %d min %d max %d\n" \
+               "option name Ponder type check default false\n" \
+               "option name MultiPV type spin default %d min %d max %d\n" \
                "option name Keep Hash Tables type check default true\n" \
                "option name Clear Hash type button\n" \
+               "option name Hash File type string default <empty>\n" \
+               "option name Hash File Mapping type check default false\n" \
+               "option name Save Hash type button\n" \
+               "option name Load Hash type button\n" \
                "option name Book Moves type button\n" \
                "option name OwnBook type check default true\n" \
                "option name Contempt Value [cps] type spin default %"PRId32" min -300 max 300\n" \
@@ -3214,8 +4125,13 @@ static void Play_Print_UCI_Info(void)
                "option name CPU Speed [%%] type spin default 100 min 1 max 100\n" \
                "option name CPU Speed [kNPS] type spin default %"PRId32" min %"PRId32" max %"PRId32"\n" \
                "option name Show Current Move type combo default Every Second var Every Second var Continuously\n" \
+               "option name Search Statistics type check default false\n" \
                "option name UCI_EngineAbout type string default The CT800 is free software under GPLv3+. Website: www.ct800.net\n" \
-               "uciok\n", (int32_t) -CONTEMPT_VAL, (int32_t) CONTEMPT_END/2, (int32_t) MAX_PLIES/2,
+               "uciok\n", HASH_DEFAULT, HASH_MIN, HASH_MAX,
+                          PAWN_HASH_DEFAULT, PAWN_HASH_MIN, PAWN_HASH_MAX,
+                          THREADS_DEFAULT, THREADS_MIN, THREADS_MAX,
+                          MULTIPV_DEFAULT, MULTIPV_MIN, MULTIPV_MAX,
+                          (int32_t) -CONTEMPT_VAL, (int32_t) CONTEMPT_END/2, (int32_t) MAX_PLIES/2,
                           (int64_t) DEFAULT_MOVE_OVERHEAD,
                           elo_max, 1000, elo_max,
                           (int32_t) MAX_THROTTLE_KNPS, (int32_t) MIN_THROTTLE_KNPS, (int32_t) MAX_THROTTLE_KNPS);
@@ -3225,11 +4141,38 @@ static void Play_Print_UCI_Info(void)
     Play_Print(printbuf);
 }
 
+/*compare up to N characters, case insensitive, and expect a command end*/
+static int Play_Strnicmp_End(const char *tst_string, const char *ref_string, size_t nbytes)
+{
+    size_t i;
+    char ch1;
+    ch1 = tst_string[nbytes];
+    if ((ch1 != ' ') && (ch1 != '\0')) /*\t, \r and \n have been remapped*/
+        return(1);
+    for (i = 0; i < nbytes; i++)
+    {
+        char ch2;
+
+        ch1 = tst_string[i];
+        if ((ch1 <= 'Z') && (ch1 >= 'A'))
+            ch1 += 'a' - 'A';
+
+        ch2 = ref_string[i];
+        if ((ch2 <= 'Z') && (ch2 >= 'A'))
+            ch2 += 'a' - 'A';
+
+        if (ch1 != ch2)
+            return(2);
+    }
+    return(0);
+}
+
 /*fill the ring buffer for the other thread. CMD_POSITION is set when
 transferring the position command. up to "FEN" itself, everything is case
 insensitive and gets converted to lower case, but the FEN string itself IS
 case sensitive. Only the W/B for the side to move in the FEN is case
-insensitive, but that's handled in the FEN parser.
+insensitive, but that's handled in the FEN parser. likewise, CMD_STRING_OPTION
+keeps the case of a setoption value, e.g. for file names.
 
 actually, that was intended as lockless queue, but it ended up with messy
 memory barriers because it must be ensured that the other thread never gets
@@ -3376,12 +4319,26 @@ static void Play_Write_Cmd(const char *line, unsigned int cmd_len,
         }
     } else /*not a "position" command, drop the FEN scan.*/
     {
+        unsigned int decase_len = cmd_len;
+
+        if (cmd_flag == CMD_STRING_OPTION)
+        {
+            for (i = 0; i + 7U <= cmd_len; i++)
+            {
+                if (!Play_Strnicmp_End(line + i, " value", 6))
+                {
+                    decase_len = i + 7U;
+                    break;
+                }
+            }
+        }
+
         for (i = 0; i < cmd_len; i++)
         {
             /*copy over the input line*/
             char ch = line[i];
 
-            if ((ch <= 'Z') && (ch >= 'A'))
+            if ((ch <= 'Z') && (ch >= 'A') && (i < decase_len))
                 ch += 'a' - 'A';
 
             cmd_buf[cmd_write_idx] = ch;
@@ -3405,38 +4362,169 @@ static void Play_Write_Cmd(const char *line, unsigned int cmd_len,
     Play_Wakeup_UCI();
 }
 
-/*compare up to N characters, case insensitive, and expect a command end*/
-static int Play_Strnicmp_End(const char *tst_string, const char *ref_string, size_t nbytes)
+/*static tables, hash keys and the initial position*/
+static void Play_Init_Engine(void)
 {
-    size_t i;
-    char ch1;
-    ch1 = tst_string[nbytes];
-    if ((ch1 != ' ') && (ch1 != '\0')) /*\t, \r and \n have been remapped*/
+    Eval_Init_Pawns();
+    Eval_Init_Material();
+    Mvgen_Init();
+    Hash_Init();
+    Play_Set_Starting_Position();
+    Play_Reset_Position_Status();
+}
+
+/*the calibrated NPS is cached in a small text file in the home directory
+  so that the next engine start can skip the calibration search. the file
+  holds one line with the key, the NPS and a CRC over both. the key is the
+  engine build and the CPU model, so another binary or another machine
+  with the same home directory calibrates again.*/
+#ifdef CTWIN
+#define CALIB_HOME_VAR      "APPDATA"
+#define CALIB_FILE_NAME     "\\ct800_calib.txt"
+#else
+#define CALIB_HOME_VAR      "HOME"
+#define CALIB_FILE_NAME     "/.ct800_calib"
+#endif
+#define CALIB_KEY_LEN       192
+#define CALIB_LINE_LEN      (CALIB_KEY_LEN + 64)
+#define CALIB_NPS_MIN       1000ULL
+#define CALIB_NPS_MAX       10000000000ULL
+
+/*gets the file name and the key for the calibration cache.
+  returns 0 if OK, 1 if there is no home directory or no CPU model.*/
+static int Play_Get_Calib_Key(char *file_name, size_t name_len, char *key)
+{
+    const char *home = getenv(CALIB_HOME_VAR);
+    char cpu_model[CALIB_KEY_LEN];
+    size_t len;
+
+    if ((home == NULL) || (*home == '\0') ||
+        (strlen(home) + sizeof(CALIB_FILE_NAME) > name_len))
         return(1);
-    for (i = 0; i < nbytes; i++)
+    strcpy(file_name, home);
+    strcat(file_name, CALIB_FILE_NAME);
+
+    *cpu_model = '\0';
+#ifdef CTWIN
     {
-        char ch2;
+        const char *cpu_id = getenv("PROCESSOR_IDENTIFIER");
+        if (cpu_id != NULL)
+        {
+            strncpy(cpu_model, cpu_id, CALIB_KEY_LEN - 1);
+            cpu_model[CALIB_KEY_LEN - 1] = '\0';
+        }
+    }
+#else
+    {
+        FILE *cpu_file = fopen("/proc/cpuinfo", "r");
+        if (cpu_file != NULL)
+        {
+            char line[CALIB_KEY_LEN];
+            while (fgets(line, sizeof(line), cpu_file) != NULL)
+            {
+                if (strncmp(line, "model name", 10) == 0)
+                {
+                    char *model = strchr(line, ':');
+                    if (model != NULL)
+                    {
+                        model++;
+                        if (*model == ' ') model++;
+                        strcpy(cpu_model, model);
+                    }
+                    break;
+                }
+            }
+            (void) fclose(cpu_file);
+        }
+    }
+#endif
+    /*cut off the line end, and no tabs because that is the separator.*/
+    for (len = 0; cpu_model[len] != '\0'; len++)
+    {
+        if ((cpu_model[len] == '\n') || (cpu_model[len] == '\r'))
+        {
+            cpu_model[len] = '\0';
+            break;
+        }
+        if (cpu_model[len] == '\t')
+            cpu_model[len] = ' ';
+    }
+    if (len == 0)
+        return(1);
 
-        ch1 = tst_string[i];
-        if ((ch1 <= 'Z') && (ch1 >= 'A'))
-            ch1 += 'a' - 'A';
+    /*the build time covers engine changes within the same version.*/
+    len = strlen(VERSION_INFO_DIALOGUE_LINE_1 " " TARGET_BUILD_STRING " " __DATE__ " " __TIME__ " ");
+    if (len + strlen(cpu_model) >= CALIB_KEY_LEN)
+        cpu_model[CALIB_KEY_LEN - 1 - len] = '\0';
+    strcpy(key, VERSION_INFO_DIALOGUE_LINE_1 " " TARGET_BUILD_STRING " " __DATE__ " " __TIME__ " ");
+    strcat(key, cpu_model);
+    return(0);
+}
 
-        ch2 = ref_string[i];
-        if ((ch2 <= 'Z') && (ch2 >= 'A'))
-            ch2 += 'a' - 'A';
+/*reads the cached NPS. returns 0 if OK, 1 if the file is missing, damaged
+  or for another build or CPU.*/
+static int Play_Read_Calib(const char *file_name, const char *key, uint64_t *calib_nps)
+{
+    char line[CALIB_LINE_LEN], *nps_str;
+    uint64_t nps = 0;
+    uint32_t crc = 0, line_crc;
+    size_t key_len = strlen(key);
+    FILE *calib_file;
+
+    calib_file = fopen(file_name, "r");
+    if (calib_file == NULL)
+        return(1);
+    nps_str = fgets(line, sizeof(line), calib_file);
+    (void) fclose(calib_file);
+    if (nps_str == NULL)
+        return(1);
 
-        if (ch1 != ch2)
-            return(2);
-    }
+    if ((strncmp(line, key, key_len) != 0) || (line[key_len] != '\t'))
+        return(1);
+    nps_str = line + key_len + 1;
+    if (sscanf(nps_str, "%"SCNu64"\t%"SCNx32, &nps, &crc) != 2)
+        return(1);
+
+    /*the CRC covers the key and the NPS with the tab between them, which
+      catches a file written by several engines starting at the same time.*/
+    nps_str = strchr(nps_str, '\t');
+    if (nps_str == NULL)
+        return(1);
+    line_crc = Util_Crc32(line, (size_t) (nps_str - line));
+    if ((line_crc != crc) || (nps < CALIB_NPS_MIN) || (nps > CALIB_NPS_MAX))
+        return(1);
+
+    *calib_nps = nps;
     return(0);
 }
 
-/*coarse calibration of the machine performance for the Elo range*/
+/*writes the calibrated NPS. failure does not matter because the next start
+  will just calibrate again.*/
+static void Play_Write_Calib(const char *file_name, const char *key, uint64_t calib_nps)
+{
+    char line[CALIB_LINE_LEN];
+    FILE *calib_file;
+    int len;
+
+    len = sprintf(line, "%s\t%"PRIu64, key, calib_nps);
+    sprintf(line + len, "\t%08"PRIx32"\n", Util_Crc32(line, (size_t) len));
+
+    calib_file = fopen(file_name, "w");
+    if (calib_file == NULL)
+        return;
+    (void) fputs(line, calib_file);
+    (void) fclose(calib_file);
+}
+
+/*coarse calibration of the machine performance for the Elo range.
+  the search is skipped if the cache file has the NPS for this build and CPU.*/
 static void Play_Calibrate_Machine(void)
 {
     MOVE amove, pmove;
     uint64_t calib_nps, spent_nodes=0, calc_nodes;
     int64_t end_wait_time, spent_time=0;
+    char calib_file_name[HASH_FILE_NAME_LEN], calib_key[CALIB_KEY_LEN];
+    int use_cache;
 
     pmove.u = MV_NO_MOVE_MASK;
     disable_book = 1;            /*internal opening book is inactive*/
@@ -3446,22 +4534,29 @@ static void Play_Calibrate_Machine(void)
     contempt_end = CONTEMPT_END; /*in plies from the start position*/
     uci_debug = 0;               /*no debug output*/
 
-    Eval_Init_Pawns();
-    Hash_Init();
-    Play_Set_Starting_Position();
-    Play_Reset_Position_Status();
+    Play_Init_Engine();
 
-    /*wait for CPU to ramp up the clock if necessary.*/
-    end_wait_time = Play_Get_Millisecs() + 50LL;
-    do { } while (Play_Get_Millisecs() < end_wait_time);
+    use_cache = (Play_Get_Calib_Key(calib_file_name, sizeof(calib_file_name), calib_key) == 0);
 
-    Search_Get_Best_Move(&amove, pmove, 250LL, 0LL, 1, MAX_DEPTH-1, 100, MAX_THROTTLE_KNPS * 1000ULL,
-                         WHITE, NULL, 0, 0, 0, &spent_nodes, &spent_time);
+    if ((!use_cache) || (Play_Read_Calib(calib_file_name, calib_key, &calib_nps) != 0))
+    {
+        /*wait for CPU to ramp up the clock if necessary.*/
+        end_wait_time = Play_Get_Millisecs() + 50LL;
+        do { } while (Play_Get_Millisecs() < end_wait_time);
 
-    if (spent_time > 0)
-        calib_nps = (spent_nodes * 1000ULL) / spent_time; /*time is in milliseconds*/
-    else
-        calib_nps = 1000ULL * 1000ULL;
+        Search_Get_Best_Move(&amove, pmove, 250LL, 0LL, 1, MAX_DEPTH-1, 100, MAX_THROTTLE_KNPS * 1000ULL,
+                             WHITE, NULL, 0, 0, 0, 0, &spent_nodes, &spent_time);
+
+        if (spent_time > 0)
+            calib_nps = (spent_nodes * 1000ULL) / spent_time; /*time is in milliseconds*/
+        else
+            calib_nps = 1000ULL * 1000ULL;
+
+        if (use_cache)
+            Play_Write_Calib(calib_file_name, calib_key, calib_nps);
+
+        Play_Init_Engine();
+    }
 
     /*derive available Elo range from the calibrated NPS.
       assume about 2200 elo at 30 kNPS.*/
@@ -3500,11 +4595,6 @@ static void Play_Calibrate_Machine(void)
 
     /*subtract 50 Elo for having room for the Elo increase with long time controls.*/
     elo_max -= 50;
-
-    Eval_Init_Pawns();
-    Hash_Init();
-    Play_Set_Starting_Position();
-    Play_Reset_Position_Status();
 }
 
 static
@@ -3575,6 +4665,19 @@ Play_Get_UCI_Input_Thrd(VAR_UNUSED void *data)
             continue;
         }
 
+        /*"ponderhit" goes directly to the running ponder search, which
+          then continues as regular search.*/
+        if (!Play_Strnicmp_End(line, "ponderhit", 9))
+        {
+            Play_Set_Ponder_Hit_Event();
+            continue;
+        }
+
+        /*every search starts without ponderhit. resetting it here keeps the
+          order with a following "ponderhit".*/
+        if (!Play_Strnicmp_End(line, "go", 2))
+            Play_Set_Ponder_Hit(0);
+
         /*handle "uci" here because it is static output anyway, plus that
           the correct answer sequence with uci / isready can only be kept
           in line if "uci" is handled in this thread. it could be confusing
@@ -3602,9 +4705,16 @@ Play_Get_UCI_Input_Thrd(VAR_UNUSED void *data)
         if (!Play_Strnicmp_End(line, "position", 8))
             cmd_flag = CMD_POSITION;
 
+        if (!Play_Strnicmp_End(line, "setoption name hash file value", 30))
+            cmd_flag = CMD_STRING_OPTION;
+
         /*the following commands require actual work.*/
         if ((!Play_Strnicmp_End(line, "ucinewgame", 10)) ||
-            (!Play_Strnicmp_End(line, "setoption name hash value ", 26)))
+            (!Play_Strnicmp_End(line, "setoption name hash value", 25)) ||
+            (!Play_Strnicmp_End(line, "setoption name pawn hash value", 30)) ||
+            (!Play_Strnicmp_End(line, "setoption name threads value", 28)) ||
+            (!Play_Strnicmp_End(line, "setoption name save hash", 24)) ||
+            (!Play_Strnicmp_End(line, "setoption name load hash", 24)))
         {
             /*reset confirmation event.*/
             Play_Wait_For_Cmd_Work(0);
@@ -3629,9 +4739,11 @@ Play_Get_UCI_Input_Thrd(VAR_UNUSED void *data)
 #endif
 }
 
-int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
+int main(int argc, char **argv)
 {
-    enum E_PROT_TYPE protocol = PROT_NONE;
+    enum E_PROT_TYPE protocol = PROT_UNDEF;
+    int64_t bench_hash=0;
+    int bench_depth=0;
 #ifdef CTWIN
 #else
     int io_flags;
@@ -3682,6 +4794,14 @@ int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
             return(1);
         }
     }
+    if (Play_Set_Pawn_Hashtable(PAWN_HASH_DEFAULT) != 0)
+    {
+        if (Play_Set_Pawn_Hashtable(PAWN_HASH_MIN) != 0)
+        {
+            Play_Print_Output("info string error (can't alloc pawn hash table: exiting)\n");
+            return(1);
+        }
+    }
 
     {
         unsigned int seed;
@@ -3692,7 +4812,17 @@ int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
         srand(seed);
     }
 
-    while (protocol == PROT_NONE)
+    /*"bench [hash] [depth]" on the command line runs the bench and exits.*/
+    if ((argc >= 2) && (!strcmp(argv[1], "bench")))
+    {
+        protocol = PROT_BENCH;
+        if (argc >= 3)
+            sscanf(argv[2], "%"SCNd64, &bench_hash);
+        if (argc >= 4)
+            sscanf(argv[3], "%d", &bench_depth);
+    }
+
+    while (protocol == PROT_UNDEF)
     {
         char line[32];
         *line = '\0'; /*init to empty string*/
@@ -3714,7 +4844,7 @@ int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
         }
     }
 
-    if (protocol == PROT_UCI) /*start UCI mode*/
+    if ((protocol == PROT_UCI) || (protocol == PROT_BENCH)) /*start UCI mode*/
     {
         /*initialise the mutexes and events. yes, this is using goto, but
           it's the right thing for error handling, especially stacked one.*/
@@ -3794,6 +4924,14 @@ int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
         #endif
 #endif
 
+        if (protocol == PROT_BENCH)
+        {
+            /*no UCI input thread and no calibration needed.*/
+            Play_Init_Engine();
+            (void) Play_Bench(bench_hash, bench_depth);
+            goto bench_done;
+        }
+
         no_output = 1;
         Play_Calibrate_Machine();
         no_output = 0;
@@ -3812,6 +4950,7 @@ int main(VAR_UNUSED int argc, VAR_UNUSED char **argv)
         /*common code path: launch the UCI/worker thread*/
         Play_UCI();
 
+bench_done:
         /*now for resource clean up. actually, that is not necessary because
           the operating system releases all resources when the process finishes.
           However, I think it is still cleaner to tidy up oneself.*/
@@ -3842,8 +4981,346 @@ mutex_clean_all:
     }
 
     /*deallocate the hash tables.*/
-    if (T_T     != NULL) free(T_T);
-    if (Opp_T_T != NULL) free(Opp_T_T);
+    Hash_Free_Tables(T_T, Opp_T_T);
+    (void) Play_Set_Helper_Pawn_Tables(0);
+    Hash_Free_Pawn_Table(P_T_T);
 
     return(0);
 }
+#endif
+
+#ifdef CTLIB
+/* ---------------- LIBRARY INTERFACE ----------------------- */
+
+/*a context only stores the position as FEN and move list. the board itself
+  lives in the thread local storage and is set up from the context whenever
+  the context gets bound to the calling thread.*/
+struct ct800_ctx
+{
+    TT_ST *tt;
+    TT_ST *opp_tt;
+    uintptr_t max_tt;
+    TT_PTT_BUCKET_ST *ptt;
+    uintptr_t pmax_tt;
+    unsigned int hash_clear_counter;
+    LINE pv;
+    GAME_INFO game_info;
+    char fen[128]; /*empty for the starting position*/
+    MOVE moves[MAX_PLIES];
+    int moves_len;
+    volatile int stop;
+    CT800_INFO_FUNC info_func;
+    void *info_data;
+};
+
+/*the context that is currently bound to this thread.*/
+static THREAD_LOCAL CT800_CTX *lib_ctx;
+
+/*replaces the UCI versions in the library build.*/
+unsigned int Play_Get_Abort(void)
+{
+    return((lib_ctx != NULL) ? (unsigned int) lib_ctx->stop : 0);
+}
+
+/*the library does not ponder.*/
+unsigned int Play_Get_Ponder_Hit(void)
+{
+    return(0);
+}
+
+void Play_Wait_For_Abort_Event(int32_t millisecs)
+{
+    int64_t end_time = Play_Get_Millisecs() + millisecs;
+
+    while ((!Play_Get_Abort()) && (Play_Get_Millisecs() < end_time))
+        Play_Sleep(1);
+}
+
+void Play_Print(const char *str)
+{
+    if ((lib_ctx != NULL) && (lib_ctx->info_func != NULL))
+        lib_ctx->info_func(lib_ctx->info_data, str);
+}
+
+/*sets up the board from the context's FEN and move list. if moves is given,
+  it replaces the context's move list after parsing and legality checking.
+  that must be done on the board because the move parser needs the pieces.*/
+static enum E_CT800_STATUS Play_Lib_Setup_Position(CT800_CTX *ctx, const char *moves)
+{
+    char fen_line[sizeof(ctx->fen) + 4];
+    enum E_COLOUR side;
+    int i;
+
+    if (ctx->fen[0] == '\0')
+        strcpy(fen_line, "startpos");
+    else
+    {
+        strcpy(fen_line, "fen ");
+        strcpy(fen_line + 4, ctx->fen);
+    }
+
+    if (Play_Read_FEN_Position(fen_line) != POS_OK)
+        return(CT800_ERR_BAD_FEN);
+
+    Hash_Init_Stack();
+    computer_side = NONE;
+    side = (gflags & BLACK_MOVED) ? WHITE : BLACK;
+
+    if (moves == NULL) /*replay the already checked move list*/
+    {
+        for (i = 0; i < ctx->moves_len; i++)
+        {
+            Play_Update_Special_Conditions(ctx->moves[i]);
+            Search_Push_Status();
+            Search_Make_Move(ctx->moves[i]);
+        }
+        return(CT800_OK);
+    }
+
+    ctx->moves_len = 0;
+    while (*moves == ' ') moves++;
+    while (*moves != '\0')
+    {
+        MOVE cur_move;
+        char move_string[6];
+        int move_len = Play_Get_Next_Pos_Move(moves, move_string);
+
+        /*Play_Parse_Move() expects lower case.*/
+        for (i = 0; i < move_len; i++)
+            if ((move_string[i] >= 'A') && (move_string[i] <= 'Z'))
+                move_string[i] += 'a' - 'A';
+
+        if ((mv_stack_p >= MAX_PLIES - 1) || (!Play_Parse_Move(move_string, &cur_move)) ||
+            (!Play_Move_Is_Legal(cur_move, side)))
+        {
+            return(CT800_ERR_BAD_MOVE);
+        }
+
+        Play_Update_Special_Conditions(cur_move);
+        Search_Push_Status();
+        Search_Make_Move(cur_move);
+        side = Mvgen_Opp_Colour(side);
+        ctx->moves[ctx->moves_len++] = cur_move;
+
+        moves += move_len;
+        while (*moves == ' ') moves++;
+    }
+    return(CT800_OK);
+}
+
+/*binds the context to the calling thread.*/
+static void Play_Lib_Bind(CT800_CTX *ctx)
+{
+    lib_ctx = ctx;
+    T_T = ctx->tt;
+    Opp_T_T = ctx->opp_tt;
+    MAX_TT = ctx->max_tt;
+    P_T_T = ctx->ptt;
+    PMAX_TT = ctx->pmax_tt;
+    hash_clear_counter = ctx->hash_clear_counter;
+    memcpy(&GlobalPV, &ctx->pv, sizeof(LINE));
+    memcpy(&game_info, &ctx->game_info, sizeof(GAME_INFO));
+}
+
+/*saves the state that has to survive until the next search.*/
+static void Play_Lib_Unbind(CT800_CTX *ctx)
+{
+    ctx->hash_clear_counter = hash_clear_counter;
+    memcpy(&ctx->pv, &GlobalPV, sizeof(LINE));
+    memcpy(&ctx->game_info, &game_info, sizeof(GAME_INFO));
+    T_T = Opp_T_T = NULL;
+    P_T_T = NULL;
+    lib_ctx = NULL;
+}
+
+/*must be called once before creating any context.*/
+void CT800_Init(void)
+{
+    static int lib_initialised = 0;
+
+    if (lib_initialised)
+        return;
+
+    disable_book = 0;
+    show_currmove = CURR_UPDATE;
+    eval_noise = 0;
+    contempt_val = CONTEMPT_VAL;
+    contempt_end = CONTEMPT_END;
+    uci_debug = 0;
+    search_threads = THREADS_DEFAULT; /*contexts run in parallel instead*/
+
+    Eval_Init_Pawns();
+    Eval_Init_Material();
+    Mvgen_Init();
+    Hash_Init();
+    srand((unsigned int) ((Play_Get_Millisecs() / 10LL) % RAND_MAX));
+    lib_initialised = 1;
+}
+
+/*returns NULL if the hash tables cannot be allocated.*/
+CT800_CTX *CT800_New_Context(size_t hash_mb)
+{
+    CT800_CTX *ctx = (CT800_CTX *) calloc(1, sizeof(CT800_CTX));
+
+    if (ctx == NULL)
+        return(NULL);
+
+    ctx->max_tt = Play_Get_TT_Max(hash_mb);
+    if (Hash_Alloc_Tables(ctx->max_tt, &ctx->tt, &ctx->opp_tt))
+    {
+        CT800_Free_Context(ctx);
+        return(NULL);
+    }
+    ctx->pmax_tt = Hash_Get_Pawn_TT_Max(PAWN_HASH_DEFAULT);
+    if (Hash_Alloc_Pawn_Table(ctx->pmax_tt, &ctx->ptt))
+    {
+        CT800_Free_Context(ctx);
+        return(NULL);
+    }
+
+    ctx->game_info.valid = EVAL_INVALID;
+    ctx->game_info.last_valid_eval = NO_RESIGN;
+    return(ctx);
+}
+
+void CT800_Free_Context(CT800_CTX *ctx)
+{
+    if (ctx == NULL)
+        return;
+    Hash_Free_Tables(ctx->tt, ctx->opp_tt);
+    Hash_Free_Pawn_Table(ctx->ptt);
+    free(ctx);
+}
+
+/*clears the hash tables and the PV, and goes to the starting position.*/
+void CT800_New_Game(CT800_CTX *ctx)
+{
+    Play_Lib_Bind(ctx);
+    Play_Reset_Position_Status();
+    Play_Lib_Unbind(ctx);
+    ctx->fen[0] = '\0';
+    ctx->moves_len = 0;
+}
+
+void CT800_Set_Info_Callback(CT800_CTX *ctx, CT800_INFO_FUNC info_func, void *info_data)
+{
+    ctx->info_func = info_func;
+    ctx->info_data = info_data;
+}
+
+/*fen can be NULL or empty for the starting position. moves is an optional
+  list of space separated moves in UCI notation. if the position or a move
+  is rejected, the context keeps its previous position.*/
+enum E_CT800_STATUS CT800_Set_Position(CT800_CTX *ctx, const char *fen, const char *moves)
+{
+    static THREAD_LOCAL MOVE old_moves[MAX_PLIES];
+    char old_fen[sizeof(ctx->fen)];
+    int old_moves_len = ctx->moves_len;
+    enum E_CT800_STATUS ret;
+
+    memcpy(old_fen, ctx->fen, sizeof(old_fen));
+    memcpy(old_moves, ctx->moves, sizeof(MOVE) * old_moves_len);
+
+    if ((fen == NULL) || (*fen == '\0'))
+        ctx->fen[0] = '\0';
+    else if (strlen(fen) < sizeof(ctx->fen))
+        strcpy(ctx->fen, fen);
+    else
+        return(CT800_ERR_BAD_FEN);
+
+    Play_Lib_Bind(ctx);
+    ret = Play_Lib_Setup_Position(ctx, (moves != NULL) ? moves : "");
+    Play_Lib_Unbind(ctx);
+
+    if (ret != CT800_OK)
+    {
+        memcpy(ctx->fen, old_fen, sizeof(old_fen));
+        memcpy(ctx->moves, old_moves, sizeof(MOVE) * old_moves_len);
+        ctx->moves_len = old_moves_len;
+    }
+    return(ret);
+}
+
+/*searches the current position of the context. CT800_ERR_NO_MOVE means
+  that the side to move is mate or stalemate.*/
+enum E_CT800_STATUS CT800_Search(CT800_CTX *ctx, const CT800_LIMITS *limits, CT800_RESULT *result)
+{
+    enum E_COMP_RESULT search_res;
+    enum E_COLOUR side;
+    MOVE amove, no_move;
+    int64_t move_time;
+    int i, exact_time, max_depth;
+
+    memset(result, 0, sizeof(CT800_RESULT));
+    strcpy(result->best_move, "0000");
+    ctx->stop = 0;
+
+    Play_Lib_Bind(ctx);
+    (void) Play_Lib_Setup_Position(ctx, NULL);
+    side = (gflags & BLACK_MOVED) ? WHITE : BLACK;
+
+    if (limits->move_time > 0)
+    {
+        move_time = limits->move_time;
+        exact_time = 1;
+    } else
+    {
+        move_time = INFINITE_TIME - 42LL;
+        exact_time = 0;
+    }
+    if ((limits->depth > 0) && (limits->depth < MAX_DEPTH-1))
+        max_depth = limits->depth;
+    else
+        max_depth = MAX_DEPTH-1;
+    g_max_nodes = limits->nodes;
+    if (limits->multipv > MULTIPV_MAX)
+        search_multipv = MULTIPV_MAX;
+    else if (limits->multipv > MULTIPV_MIN)
+        search_multipv = limits->multipv;
+    else
+        search_multipv = MULTIPV_MIN;
+
+    /*every search counts as continued game for the hash aging.*/
+    if (hash_clear_counter < MAX_AGE_CNT)
+        hash_clear_counter++;
+    else
+        hash_clear_counter = 0;
+
+    dynamic_resign_threshold = NO_RESIGN;
+    game_info.valid = EVAL_INVALID;
+    game_info.eval = 0;
+    computer_side = side;
+    no_move.u = MV_NO_MOVE_MASK;
+
+    search_res = Search_Get_Best_Move(&amove, no_move, move_time, 0, exact_time, max_depth,
+                                      100, MAX_THROTTLE_KNPS * 1000ULL, side, NULL, 0, 0, 0, 0,
+                                      &result->nodes, &result->time);
+
+    if (game_info.valid == EVAL_MOVE)
+        game_info.last_valid_eval = game_info.eval;
+    computer_side = NONE;
+
+    if (search_res == COMP_MOVE_FOUND)
+    {
+        strcpy(result->best_move, Play_Translate_Moves(amove));
+        if (game_info.eval > MATE_CUTOFF)
+            result->mate = (INFINITY_ - game_info.eval + 1) / 2;
+        else if (game_info.eval < -MATE_CUTOFF)
+            result->mate = -((INFINITY_ + game_info.eval + 1) / 2);
+        result->score = game_info.eval;
+        result->depth = game_info.depth;
+        for (i = 0; (i < GlobalPV.line_len) && (i < CT800_PV_LEN); i++)
+            strcpy(result->pv[i], Play_Translate_Moves(Mvgen_Decompress_Move(GlobalPV.line_cmoves[i])));
+        result->pv_len = i;
+    }
+
+    Play_Lib_Unbind(ctx);
+    return((search_res == COMP_MOVE_FOUND) ? CT800_OK : CT800_ERR_NO_MOVE);
+}
+
+/*may be called from any thread while the context is searching.*/
+void CT800_Stop(CT800_CTX *ctx)
+{
+    ctx->stop = 1;
+}
+#endif
@@ -39,11 +39,14 @@ extern int64_t Play_Get_Own_Millisecs(void);
 extern void Play_Print(const char *str);
 extern int Play_Get_Abort(void);
 extern void Play_Wait_For_Abort_Event(int32_t millisecs);
+extern unsigned int Play_Get_Ponder_Hit(void);
+extern int Play_Start_Helper_Threads(int helper_cnt);
+extern void Play_Join_Helper_Threads(void);
 
 /*---------- external variables ----------*/
 /*-- READ-ONLY  --*/
-extern int game_started_from_0;
-extern int32_t start_moves;
+extern THREAD_LOCAL int game_started_from_0;
+extern THREAD_LOCAL int32_t start_moves;
 
 /*UCI options*/
 extern unsigned int disable_book;
@@ -52,47 +55,54 @@ extern int contempt_val;
 extern int contempt_end;
 extern volatile unsigned int uci_debug;
 extern int32_t eval_noise;
+extern int search_threads;
+extern THREAD_LOCAL int search_multipv;
+extern int search_stats_output;
 
 extern PIECE empty_p;
-extern int fifty_moves;
+extern THREAD_LOCAL int fifty_moves;
 /*these get set up in Eval_Setup_Initial_Material(), see eval.c for explanation*/
-extern int start_pawns;
-extern int dynamic_resign_threshold;
-extern enum E_COLOUR computer_side;
-extern uint64_t g_max_nodes;
-extern PIECE Wpieces[16];
-extern PIECE Bpieces[16];
+extern THREAD_LOCAL int start_pawns;
+extern THREAD_LOCAL int dynamic_resign_threshold;
+extern THREAD_LOCAL enum E_COLOUR computer_side;
+extern THREAD_LOCAL uint64_t g_max_nodes;
+extern THREAD_LOCAL PIECE Wpieces[16];
+extern THREAD_LOCAL PIECE Bpieces[16];
 
 /*-- READ-WRITE --*/
-extern PIECE *board[120];
-extern int mv_stack_p;
-extern MVST move_stack[MAX_STACK+1];
-extern int cst_p;
-extern uint16_t cstack[MAX_STACK+1];
-extern int Starting_Mv;
-extern int wking, bking;
-extern int en_passant_sq;
-extern unsigned int gflags;
-extern GAME_INFO game_info;
-extern LINE GlobalPV;
-extern uint64_t g_nodes;
-extern uint64_t tb_hits;
-
-extern TT_ST     *T_T;
-extern TT_ST *Opp_T_T;
-extern unsigned int hash_clear_counter;
+extern THREAD_LOCAL PIECE *board[120];
+extern THREAD_LOCAL int mv_stack_p;
+extern THREAD_LOCAL MVST move_stack[MAX_STACK+1];
+extern THREAD_LOCAL int cst_p;
+extern THREAD_LOCAL uint16_t cstack[MAX_STACK+1];
+extern THREAD_LOCAL int Starting_Mv;
+extern THREAD_LOCAL int wking, bking;
+extern THREAD_LOCAL int en_passant_sq;
+extern THREAD_LOCAL unsigned int gflags;
+extern THREAD_LOCAL GAME_INFO game_info;
+extern THREAD_LOCAL LINE GlobalPV;
+extern THREAD_LOCAL uint64_t g_nodes;
+extern THREAD_LOCAL uint64_t tb_hits;
+
+extern THREAD_LOCAL TT_ST     *T_T;
+extern THREAD_LOCAL TT_ST *Opp_T_T;
+extern THREAD_LOCAL uintptr_t MAX_TT;
+extern THREAD_LOCAL TT_PTT_BUCKET_ST *P_T_T;
+extern TT_PTT_BUCKET_ST *helper_p_t_t[THREADS_MAX];
+extern THREAD_LOCAL uintptr_t PMAX_TT;
+extern THREAD_LOCAL unsigned int hash_clear_counter;
 
 
 /*---------- module global variables ----------*/
 
-static enum E_TIMEOUT time_is_up;
+static THREAD_LOCAL enum E_TIMEOUT time_is_up;
 
 /*for every root move, the expected reply from the opponent is cached in this
   array during the iterative deepening to help with the move sorting. for the
   UCI version, this is not that important because the hashtables are big enough,
   but for the embedded version with small hash tables, this is quite helpful.
   however, it is not damaging for the UCI version, either.*/
-static CMOVE opp_move_cache[MAXMV];
+static THREAD_LOCAL CMOVE opp_move_cache[MAXMV];
 
 /*use the Ciura sequence for the shell sort. more than 57 is not needed because
 the rare maximum of pseudo-legal moves in real game positions is about 80 to 90.*/
@@ -105,7 +115,9 @@ static const int PieceValFromType[PIECEMAX]= {0, 0, PAWN_V, KNIGHT_V, BISHOP_V,
 /*this is needed for deepening the PV against delay exchanges, which can cause
 a horizon effect. only equal exchanges can do so because unequal ones either
 would be a clear win or loss anyway.
-note that for this purpose, minor pieces are assumed to be equal.*/
+note that for this purpose, minor pieces are assumed to be equal.
+the static exchange evaluation uses the same values so that trading a bishop
+for a knight does not count as losing capture.*/
 static const int ExchangeValue[PIECEMAX]=    {0, 0, PAWN_V, KNIGHT_V, KNIGHT_V, ROOK_V, QUEEN_V, INFINITY_, 0, 0,
                                               0, 0, PAWN_V, KNIGHT_V, KNIGHT_V, ROOK_V, QUEEN_V, INFINITY_
                                              };
@@ -139,35 +151,157 @@ static const int FutilityMargins[FUTIL_DEPTH] = {0, 240, 450, 600};
 
 /* ------------- GLOBAL KILERS/HISTORY TABLES ----------------*/
 
-int8_t W_history[6][ENDSQ], B_history[6][ENDSQ];
-CMOVE W_Killers[2][MAX_DEPTH], B_Killers[2][MAX_DEPTH];
+THREAD_LOCAL int8_t W_history[6][ENDSQ], B_history[6][ENDSQ];
+THREAD_LOCAL CMOVE W_Killers[2][MAX_DEPTH], B_Killers[2][MAX_DEPTH];
 
 /* ------------- CHECK LIST BUFFER ----------------*/
 
 /*the check list is only used as intermediate buffer back to back with
   finding evasions as move generation if being in check. works because
-  of single thread and reduces stack usage.*/
-static MOVE search_check_attacks_buf[CHECKLISTLEN];
+  every search thread has its own buffer, and it reduces stack usage.*/
+static THREAD_LOCAL MOVE search_check_attacks_buf[CHECKLISTLEN];
 
 /* ------------- TIME/UCI CONTROL ----------------*/
 
-static char printbuf[512]; /*with the depth limitation, this is more than sufficient.*/
+static THREAD_LOCAL char printbuf[512]; /*with the depth limitation, this is more than sufficient.*/
 
-static int64_t start_time, start_time_nps, stop_time, output_time, throttle_time, sleep_time;
-static uint64_t nps_1ms, last_nodes, last_throttle_nodes, nps_startup_phase, nodes_current_second;
+static THREAD_LOCAL int64_t start_time, start_time_nps, stop_time, output_time, throttle_time, sleep_time;
+static THREAD_LOCAL uint64_t nps_1ms, last_nodes, last_throttle_nodes, nps_startup_phase, nodes_current_second;
 
-static uint64_t effective_max_nps_rate; /*kicks in after pre-search*/
-static int effective_cpu_speed;
+static THREAD_LOCAL uint64_t effective_max_nps_rate; /*kicks in after pre-search*/
+static THREAD_LOCAL int effective_cpu_speed;
 
-static MOVE uci_curr_move;
-static unsigned int uci_curr_move_number;
+static THREAD_LOCAL MOVE uci_curr_move;
+static THREAD_LOCAL unsigned int uci_curr_move_number;
 
-#ifdef DBGCUTOFF
-static uint64_t cutoffs_on_1st_move, total_cutoffs;
+/*if too much time has been used, don't start another iteration. this is
+  module wide because a ponderhit changes it during the search.*/
+static THREAD_LOCAL int64_t reduced_move_time;
+
+/*pondering: the search runs like in analysis mode until the GUI sends
+  "ponderhit". then the time limits are set up from the values given with
+  "go ponder", counting from the ponderhit on.*/
+static THREAD_LOCAL int is_pondering, ponder_exact_time, ponder_in_check;
+static THREAD_LOCAL int ponder_move_overhead, ponder_min_time;
+static THREAD_LOCAL int64_t ponder_move_time;
+
+#ifdef DBGTTSTALL
+extern THREAD_LOCAL uint64_t tt_probes, tt_stalls;
 #endif
 
+/* ------------- SEARCH STATISTICS ----------------*/
+
+/*counted during every search. eval.c adds the pawn hash and eval cache
+  probes, hashtables.c the TT hits.*/
+THREAD_LOCAL SEARCH_STATS search_stats;
+extern THREAD_LOCAL uint64_t tt_hits;
+
+/*the statistics of the helper threads, copied at their end.*/
+static SEARCH_STATS helper_stats[THREADS_MAX];
+
+/* ------------- MULTIPV ----------------*/
+
+/*with MultiPV, the further lines are searched after the main line in every
+  iteration, each on the root moves without those of the better lines. the
+  lines share the hash tables and the root move ordering, which makes them
+  cheaper than separate searches. line 0 is GlobalPV, so index 0 is only
+  used during Search_MultiPV_Iteration().*/
+static THREAD_LOCAL int multipv_cnt;
+static THREAD_LOCAL LINE multipv_lines[MULTIPV_MAX];
+static THREAD_LOCAL int multipv_scores[MULTIPV_MAX], multipv_depths[MULTIPV_MAX];
+
+/*where the root move list passed to Search_Negascout() starts within the
+  full root move list. keeps the level 2 move cache aligned.*/
+static THREAD_LOCAL int root_list_offset;
+
+/* ------------- PARALLEL SEARCH ----------------*/
+
+/*lazy SMP: the helper threads search the same root position as the main
+  thread, just without output and time control. they only interact via the
+  shared main hash tables, which lets the main thread find more cutoffs and
+  better move ordering. the helpers never touch the hash tables in a
+  synchronised way; a torn entry can at most cause a wrong score, but no
+  crash because stored moves are checked for pseudo legality anyway.*/
+
+/*0 is the main search thread, the helper threads count from 1 on.*/
+static THREAD_LOCAL int search_thread_id;
+
+/*set by the main thread when the helpers shall stop.*/
+static volatile int helper_stop;
+static THREAD_LOCAL int helper_cnt;
+
+/*node counters of the helper threads. 8 entries per thread so that each
+  counter has its own cache line.*/
+static volatile uint64_t helper_nodes[THREADS_MAX][8];
+
+/*root position for the helper threads, copied by the main thread before
+  starting them. the piece pointers still point to the main thread's piece
+  lists and are relocated by each helper. the perft threads use only the
+  position part.*/
+static struct {
+    PIECE *board[120];
+    PIECE wpieces[16];
+    PIECE bpieces[16];
+    const PIECE *main_wpieces;
+    const PIECE *main_bpieces;
+    MVST move_stack[MAX_STACK+1];
+    uint16_t cstack[MAX_STACK+1];
+    MOVE movelist[MAXMV];
+    LINE pv;
+    GAME_INFO game_info;
+    TT_ST *tt, *opp_tt;
+    uintptr_t max_tt, pmax_tt;
+    unsigned int hash_clear_counter;
+    int mv_stack_p, cst_p, wking, bking, en_passant_sq;
+    unsigned int gflags;
+    int fifty_moves, game_started_from_0, dynamic_resign_threshold;
+    int32_t start_moves;
+    enum E_COLOUR computer_side;
+    int move_cnt, in_check, max_depth;
+    enum E_COLOUR colour;
+} helper_root;
+
 /*---------- local functions ----------*/
 
+/*sum of the nodes from all search threads, for the output.*/
+static uint64_t Search_Get_Total_Nodes(void)
+{
+    uint64_t total_nodes = g_nodes;
+    int i;
+
+    for (i = 1; i <= helper_cnt; i++)
+        total_nodes += helper_nodes[i][0];
+    return(total_nodes);
+}
+
+/*the TT probes with the statistics per table and node type. the hash
+  module counts the hits without knowing the node type, so these check for
+  a change. a probe can find several entries of the same position in the
+  overlapping clusters, but counts as one hit.*/
+static int Search_Check_TT(const TT_ST *tt, enum E_COLOUR colour, int alpha, int beta, int depth,
+                           int *valueP, MOVE *hmvp, enum E_STAT_NODE node_type)
+{
+    uint64_t prev_hits = tt_hits;
+    int ret = Hash_Check_TT(tt, colour, alpha, beta, depth, move_stack[mv_stack_p].mv_pos_hash, valueP, hmvp);
+    enum E_STAT_TT table = (tt == T_T) ? STAT_TT_OWN : STAT_TT_OPP;
+
+    search_stats.tt_probes[table][node_type]++;
+    search_stats.tt_hits[table][node_type] += (tt_hits != prev_hits);
+    search_stats.tt_cutoffs[table][node_type] += (uint64_t) ret;
+    return(ret);
+}
+
+/*PV nodes only take the hash move, so there are no cutoffs.*/
+static void Search_Check_TT_PV(const TT_ST *tt, enum E_COLOUR colour, int depth, int *valueP, MOVE *hmvp)
+{
+    uint64_t prev_hits = tt_hits;
+    enum E_STAT_TT table = (tt == T_T) ? STAT_TT_OWN : STAT_TT_OPP;
+
+    (void) Hash_Check_TT_PV(tt, colour, depth, move_stack[mv_stack_p].mv_pos_hash, valueP, hmvp);
+    search_stats.tt_probes[table][STAT_PV]++;
+    search_stats.tt_hits[table][STAT_PV] += (tt_hits != prev_hits);
+}
+
 static int64_t Time_Passed(void)
 {
     return(Play_Get_Millisecs() - start_time);
@@ -211,14 +345,15 @@ static void Time_Output(int64_t current_time, int64_t subtract_time)
     if (current_time >= output_time)
     {
         int64_t time_passed, time_passed_calib;
-        uint64_t nps_stat;
+        uint64_t nps_stat, total_nodes;
         uint16_t hash_used;
         int len;
 
         time_passed = current_time - start_time;
+        total_nodes = Search_Get_Total_Nodes();
 
         if (time_passed > 0)
-            nps_stat = (g_nodes * 1000LL) / time_passed;
+            nps_stat = (total_nodes * 1000LL) / time_passed;
         else
             nps_stat = 0;
 
@@ -237,7 +372,7 @@ static void Time_Output(int64_t current_time, int64_t subtract_time)
         len += Util_Tostring_I64(printbuf + len, time_passed);
         strcpy(printbuf + len, " nodes ");
         len += 7;
-        len += Util_Tostring_U64(printbuf + len, g_nodes);
+        len += Util_Tostring_U64(printbuf + len, total_nodes);
         strcpy(printbuf + len, " nps ");
         len += 5;
         len += Util_Tostring_U64(printbuf + len, nps_stat);
@@ -276,6 +411,49 @@ static void Time_Output(int64_t current_time, int64_t subtract_time)
     }
 }
 
+/*converts the ponder search into a regular search after "ponderhit". the
+  time until now was the opponent's, so the move time counts from the
+  ponderhit on, with the same limits as at the start of a regular search.
+  the iterative deepening just goes on so that the depth already reached
+  and the hash table contents are kept.*/
+static void Time_Ponder_Hit(int64_t current_time)
+{
+    int64_t move_time = ponder_move_time;
+
+    is_pondering = 0;
+
+    if (uci_debug) Play_Print("info string debug: ponderhit.\n");
+
+    /*"go ponder infinite" just goes on as analysis.*/
+    if ((ponder_exact_time) && (move_time == INFINITE_TIME))
+        return;
+
+    if (ponder_exact_time == 0)
+    {
+        int min_time = ponder_min_time;
+
+        if (ponder_in_check) /*there are not many moves anyway*/
+        {
+            move_time /= 2;
+            min_time = (min_time + 1)/2;
+        }
+        stop_time = current_time + move_time - ponder_move_overhead;
+        if (stop_time < current_time + min_time)
+            stop_time = current_time + min_time;
+        /*reduced_move_time refers to start_time, not to the ponderhit.*/
+        reduced_move_time = current_time - start_time +
+                            ((stop_time - current_time) * 55LL + 50LL) / 100LL;
+    } else
+    {
+        stop_time = current_time + move_time - ponder_move_overhead;
+        reduced_move_time = current_time - start_time + move_time;
+    }
+
+    /*reduce effective throttle speed if the move time will be over
+      in the next second.*/
+    Time_Calc_Throttle(current_time);
+}
+
 /*checks whether the allocated move time or node count has been reached.
   if not, the software CPU throttling is done here by inserting waiting
   slices.*/
@@ -284,6 +462,14 @@ static enum E_TIMEOUT Time_Check_Throttle(void)
     int64_t current_time;
     enum E_THROTTLE throttle_mode;
 
+    /*the helper threads only publish their node count and check for the
+      stop signal from the main thread.*/
+    if (search_thread_id != 0)
+    {
+        helper_nodes[search_thread_id][0] = g_nodes;
+        return((helper_stop) ? TM_ABORT : TM_NO_TIMEOUT);
+    }
+
     /*check whether we need to check the time. that would involve a system
       call and is quite expensive, so it's only done about every millisecond.
       since the node rate is known / calibrated, this boils down to checking
@@ -297,6 +483,10 @@ static enum E_TIMEOUT Time_Check_Throttle(void)
 
     current_time = Play_Get_Millisecs();
 
+    /*GUI has sent "ponderhit"?*/
+    if ((is_pondering) && (Play_Get_Ponder_Hit()))
+        Time_Ponder_Hit(current_time);
+
     /*move time over?*/
     if (current_time >= stop_time)
         return(TM_TIMEOUT);
@@ -438,7 +628,7 @@ static enum E_TIMEOUT Time_Check_Throttle(void)
 /*used for timing until move time is over or the user stops the engine.
   necessary for fixed UCI move time or infinite when there is nothing
   to calculate because e.g. maximum depth has been reached or a mate is
-  already found.*/
+  already found. also used while pondering, until "ponderhit".*/
 static void Time_Wait_For_Abort(void)
 {
     uint16_t hash_used = Hash_Get_Usage();
@@ -449,6 +639,15 @@ static void Time_Wait_For_Abort(void)
 
         current_time = Play_Get_Millisecs();
 
+        /*after a ponderhit, there is nothing left to calculate, so the
+          move can be played right away - except in analysis mode.*/
+        if ((is_pondering) && (Play_Get_Ponder_Hit()))
+        {
+            Time_Ponder_Hit(current_time);
+            if ((ponder_exact_time == 0) || (ponder_move_time != INFINITE_TIME))
+                return;
+        }
+
         /*move time over?*/
         if (current_time >= stop_time)
             return;
@@ -467,7 +666,7 @@ static void Time_Wait_For_Abort(void)
             len += Util_Tostring_I64(printbuf + len, time_passed);
             strcpy(printbuf + len, " nodes ");
             len += 7;
-            len += Util_Tostring_U64(printbuf + len, g_nodes);
+            len += Util_Tostring_U64(printbuf + len, Search_Get_Total_Nodes());
             strcpy(printbuf + len, " nps 0 hashfull ");
             len += 16;
             len += Util_Tostring_U16(printbuf + len, hash_used);
@@ -709,18 +908,197 @@ static int32_t Search_Flatten_Difference(int32_t eval)
     return(eval);
 }
 
+/*returns the square of the least valuable piece of the given colour that
+  attacks the square, or 0 if there is none. pins are not considered.
+  the piece types of a colour are in the order of their exchange values,
+  so the least valuable slider is the one with the lowest type.*/
+static int Search_SEE_Least_Attacker(int sq, enum E_COLOUR colour)
+{
+    static const int diag_steps[4] = {9, 11, -9, -11};
+    static const int orth_steps[4] = {1, 10, -1, -10};
+    static const int knight_steps[8] = {8, 12, 19, 21, -8, -12, -19, -21};
+    int i, xy, type, best_xy = 0, best_type = PIECEMAX;
+    const int offset = (colour == WHITE) ? 0 : (BPAWN - WPAWN);
+    const int pawn_step = (colour == WHITE) ? -10 : 10;
+
+    /*pawns*/
+    if (board[sq + pawn_step - 1]->type == WPAWN + offset)
+        return(sq + pawn_step - 1);
+    if (board[sq + pawn_step + 1]->type == WPAWN + offset)
+        return(sq + pawn_step + 1);
+
+    /*knights*/
+    for (i = 0; i < 8; i++)
+    {
+        xy = sq + knight_steps[i];
+        if (board[xy]->type == WKNIGHT + offset)
+            return(xy);
+    }
+
+    /*sliders: the first piece on each ray*/
+    for (i = 0; i < 4; i++)
+    {
+        xy = sq + diag_steps[i];
+        while ((type = board[xy]->type) == NO_PIECE)
+            xy += diag_steps[i];
+        if (((type == WBISHOP + offset) || (type == WQUEEN + offset)) && (type < best_type))
+        {
+            best_type = type;
+            best_xy = xy;
+        }
+        xy = sq + orth_steps[i];
+        while ((type = board[xy]->type) == NO_PIECE)
+            xy += orth_steps[i];
+        if (((type == WROOK + offset) || (type == WQUEEN + offset)) && (type < best_type))
+        {
+            best_type = type;
+            best_xy = xy;
+        }
+    }
+    if (best_xy != 0)
+        return(best_xy);
+
+    /*king, unless it has already been taken off the board in the exchange*/
+    xy = (colour == WHITE) ? wking : bking;
+    i = xy - sq;
+    if (((i == 1) || (i == -1) || (i == 9) || (i == -9) || (i == 10) || (i == -10) || (i == 11) || (i == -11)) &&
+        (board[xy]->type == WKING + offset))
+    {
+        return(xy);
+    }
+
+    return(0);
+}
+
+/*static exchange evaluation: the material balance of the exchange on the
+  target square of the move, with both sides capturing with their least
+  valuable piece first and free to stop the exchange. the captured pieces
+  are taken off the board during the exchange so that x-ray attackers come
+  into play, and they are put back afterwards. minor pieces count as equal.*/
+static int Search_SEE(MOVE move)
+{
+    PIECE *removed_p[34];
+    int removed_xy[34];
+    int gain[34];
+    int n_removed = 0, d = 0, sq, xy, on_square;
+    enum E_COLOUR colour;
+
+    sq = move.m.to;
+    xy = move.m.from;
+    on_square = ExchangeValue[board[xy]->type];
+    colour = (board[xy]->type < BLACK) ? WHITE : BLACK;
+
+    if (board[sq]->type != NO_PIECE)
+        gain[0] = ExchangeValue[board[sq]->type];
+    else if ((move.m.flag == WPAWN) || (move.m.flag == BPAWN))
+    {
+        /*en passant: take the captured pawn off the board, too.*/
+        int ep_xy = (colour == WHITE) ? (sq - 10) : (sq + 10);
+        gain[0] = PAWN_V;
+        removed_p[n_removed] = board[ep_xy];
+        removed_xy[n_removed++] = ep_xy;
+        board[ep_xy] = &empty_p;
+    } else
+        gain[0] = 0;
+
+    /*promotion*/
+    if ((move.m.flag != 1U) && (move.m.flag != board[xy]->type))
+    {
+        on_square = ExchangeValue[move.m.flag];
+        gain[0] += on_square - PAWN_V;
+    }
+
+    removed_p[n_removed] = board[xy];
+    removed_xy[n_removed++] = xy;
+    board[xy] = &empty_p;
+
+    for (;;)
+    {
+        colour = Mvgen_Opp_Colour(colour);
+        xy = Search_SEE_Least_Attacker(sq, colour);
+        if (xy == 0)
+            break;
+        d++;
+        /*if the capture sequence were to stop here*/
+        gain[d] = on_square - gain[d-1];
+        on_square = ExchangeValue[board[xy]->type];
+        removed_p[n_removed] = board[xy];
+        removed_xy[n_removed++] = xy;
+        board[xy] = &empty_p;
+    }
+
+    /*each side only captures if that does not make its result worse.*/
+    while (d > 0)
+    {
+        d--;
+        if (-gain[d+1] < gain[d])
+            gain[d] = -gain[d+1];
+    }
+
+    while (n_removed > 0)
+    {
+        n_removed--;
+        board[removed_xy[n_removed]] = removed_p[n_removed];
+    }
+    return(gain[0]);
+}
+
+/*a capture can only lose material if the capturing piece is worth more
+  than the captured one. promotions don't count as losing.*/
+static int Search_Is_Losing_Capture(MOVE move)
+{
+    int attacker, victim;
+
+    victim = board[move.m.to]->type;
+    if (victim == NO_PIECE) /*non-capture, en passant or promotion*/
+        return(0);
+    attacker = board[move.m.from]->type;
+    if ((move.m.flag != 1U) && (move.m.flag != attacker)) /*promotion*/
+        return(0);
+    if (ExchangeValue[attacker] <= ExchangeValue[victim])
+        return(0);
+    return(Search_SEE(move) < 0);
+}
+
 static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_checks, int qs_depth)
 {
     MOVE movelist[MAXCAPTMV];
+    MOVE hash_best;
+    TT_ST *tt;
     enum E_COLOUR next_colour;
-    int e, score, i, move_cnt, actual_moves, t, recapt;
-    int is_material_enough, n_checks, n_check_pieces;
-    unsigned has_move;
+    int e, score, i, move_cnt, actual_moves, t, recapt, best_i;
+    int is_material_enough, n_checks, n_check_pieces, lazy_beta;
+    const int orig_alpha = alpha;
+    unsigned has_move, has_pins;
+    PIN_INFO pins;
 
     g_nodes++;
+    search_stats.nodes[STAT_QS]++;
+
+    /*in the recapture-only phase, the result depends on the previous move,
+      so only the first QS plies use the hash tables. the root side to move
+      has T_T, as in Search_Negascout().*/
+    hash_best.u = MV_NO_MOVE_MASK;
+    if (qs_depth < QS_RECAPT_DEPTH)
+    {
+        tt = (colour == computer_side) ? T_T : Opp_T_T;
+        if (Search_Check_TT(tt, colour, alpha, beta, QS_TT_DEPTH, &t, &hash_best, STAT_QS))
+            return t;
+    } else
+        tt = NULL;
+
+    /*the stand pat cutoff only needs to know whether the eval is above
+      beta, widened by the ply adjustment below. no upper bound for fail
+      low because that would weaken the delta pruning. the fifty moves
+      flattening needs the full eval. without LAZY_EVAL_WINDOW at build
+      time, the windowed eval is the full eval anyway.*/
+    if (LIKELY(fifty_moves < NO_ACTION_PLIES))
+        lazy_beta = beta + (mv_stack_p - Starting_Mv);
+    else
+        lazy_beta = INFINITY_;
+
     if (colour==BLACK) {
-        /*using has_move as dummy*/
-        e = -Eval_Static_Evaluation(&is_material_enough, BLACK, &has_move, &has_move, &has_move);
+        e = -Eval_Window_Evaluation(&is_material_enough, BLACK, -lazy_beta, INFINITY_);
         if (UNLIKELY(!is_material_enough))
             return 0;
         if (UNLIKELY(fifty_moves >= NO_ACTION_PLIES))
@@ -743,8 +1121,11 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
 
         /*in pre-search or after 4 plies QS, don't do check extensions.
           depth 0 cannot have checks because Negascout does not enter QS
-          when in check, and the pre-search does not request QS check extension.*/
-        if ((qs_depth < QS_CHECK_DEPTH) && (qs_depth > 0) && (do_checks != QS_NO_CHECKS))
+          when in check, and the pre-search does not request QS check extension.
+          with qs_depth > 0, the last move was made in the QS, so it tells
+          whether there is a check at all.*/
+        if ((qs_depth < QS_CHECK_DEPTH) && (qs_depth > 0) && (do_checks != QS_NO_CHECKS) &&
+            (Mvgen_Last_Move_Gives_Check()))
             n_checks = Mvgen_Black_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces);
         else
             n_checks = 0;
@@ -800,8 +1181,7 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
         }
         next_colour = WHITE;
     } else {
-        /*using has_move as dummy*/
-        e = Eval_Static_Evaluation(&is_material_enough, WHITE, &has_move, &has_move, &has_move);
+        e = Eval_Window_Evaluation(&is_material_enough, WHITE, -INFINITY_, lazy_beta);
         if (UNLIKELY(!is_material_enough))
             return 0;
         if (UNLIKELY(fifty_moves >= NO_ACTION_PLIES))
@@ -824,8 +1204,11 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
 
         /*in pre-search or after 4 plies QS, don't do check extensions.
           depth 0 cannot have checks because Negascout does not enter QS
-          when in check, and the pre-search does not request QS check extension.*/
-        if ((qs_depth < QS_CHECK_DEPTH) && (qs_depth > 0) && (do_checks != QS_NO_CHECKS))
+          when in check, and the pre-search does not request QS check extension.
+          with qs_depth > 0, the last move was made in the QS, so it tells
+          whether there is a check at all.*/
+        if ((qs_depth < QS_CHECK_DEPTH) && (qs_depth > 0) && (do_checks != QS_NO_CHECKS) &&
+            (Mvgen_Last_Move_Gives_Check()))
             n_checks = Mvgen_White_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces);
         else
             n_checks = 0;
@@ -882,8 +1265,21 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
         next_colour = BLACK;
     }
 
+    if (hash_best.u != MV_NO_MOVE_MASK)
+    {
+        for (i = 0; i < move_cnt; i++)
+        {
+            if (((movelist[i].u ^ hash_best.u) & mv_move_mask.u) == 0)
+            {
+                movelist[i].m.mvv_lva = MVV_LVA_HASH;
+                break;
+            }
+        }
+    }
+
     Search_Swap_Best_To_Top(movelist, move_cnt);
-    actual_moves = has_move = 0;
+    actual_moves = has_move = has_pins = 0;
+    best_i = -1;
     recapt = (qs_depth < QS_RECAPT_DEPTH) ? 0 : move_stack[mv_stack_p].move.m.to;
     qs_depth++;
 
@@ -904,25 +1300,38 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
             continue;
         }
 
-        Search_Push_Status();
-        Search_Make_Move(movelist[i]);
+        /*captures that lose material don't help to get a quiet position.
+          not when in check because then, the evasions have to be looked at.*/
+        if ((n_checks == 0) && (Search_Is_Losing_Capture(movelist[i])))
+            continue;
 
-        if (Mvgen_King_In_Check(colour))
+        /*the pins are only needed if a move gets this far.*/
+        if (!has_pins)
         {
-            Search_Retract_Last_Move();
-            Search_Pop_Status();
-            continue;
+            Mvgen_Pin_Info(&pins, colour);
+            has_pins = 1U;
         }
+        if (!Mvgen_Move_Is_Legal(movelist[i], &pins, colour))
+            continue;
 
+        Search_Push_Status();
+        Search_Make_Move(movelist[i]);
         actual_moves++;
         score = -Search_Quiescence(-beta, -alpha, next_colour, do_checks, qs_depth);
         Search_Retract_Last_Move();
         Search_Pop_Status();
 
         if (score >= beta)
+        {
+            if (tt != NULL)
+                Hash_Update_TT(tt, colour, QS_TT_DEPTH, beta, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, movelist[i]);
             return beta;
+        }
         if (score > alpha)
+        {
             alpha = score;
+            best_i = i;
+        }
     }
     /*mate found? only if no possible evasion moves have been pruned.*/
     if ((actual_moves == 0) && (n_checks != 0) && (has_move == 0) &&
@@ -931,6 +1340,17 @@ static int Search_Quiescence(int alpha, int beta, enum E_COLOUR colour, int do_c
         return(-INFINITY_ + (mv_stack_p - Starting_Mv));
     }
 
+    if (tt != NULL)
+    {
+        MOVE smove;
+        if (best_i >= 0)
+            smove = movelist[best_i];
+        else
+            smove.u = MV_NO_MOVE_MASK;
+        /*raising alpha by the static eval also gives an exact value.*/
+        Hash_Update_TT(tt, colour, QS_TT_DEPTH, alpha, (alpha > orig_alpha) ? EXACT : CHECK_ALPHA,
+                       move_stack[mv_stack_p].mv_pos_hash, smove);
+    }
     return alpha;
 }
 
@@ -1012,7 +1432,7 @@ static int Search_Negamate(int depth, int alpha, int beta, enum E_COLOUR colour,
                 return(0);
             }
             actual_move_cnt++;
-            if (Mvgen_King_In_Check(next_colour))
+            if (Mvgen_Last_Move_Gives_Check())
             /*prioritise check giving moves*/
             {
                 checking++;
@@ -1071,6 +1491,7 @@ static int Search_Negamate(int depth, int alpha, int beta, enum E_COLOUR colour,
 
         Search_Push_Status();
         Search_Make_Move(movelist[i]);
+        Hash_Prefetch_TT((next_colour == WHITE) ? T_T : Opp_T_T, next_colour, move_stack[mv_stack_p].mv_pos_hash);
 
         if (root_node)
         {
@@ -1125,9 +1546,9 @@ static int Search_Negamate(int depth, int alpha, int beta, enum E_COLOUR colour,
 
                 /*the supplied move is only used for extended hash entry validation*/
                 if (colour == WHITE)
-                    Hash_Update_TT(    T_T, depth, score, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+                    Hash_Update_TT(    T_T, colour, depth, score, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
                 else
-                    Hash_Update_TT(Opp_T_T, depth, score, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+                    Hash_Update_TT(Opp_T_T, colour, depth, score, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
 
                 /*Update depth killers for non captures.
                   Quiet king moves generally don't work in sibling positions.*/
@@ -1166,16 +1587,16 @@ static int Search_Negamate(int depth, int alpha, int beta, enum E_COLOUR colour,
     {
         /*the supplied move is only used for extended hash entry validation*/
         if (colour == WHITE)
-            Hash_Update_TT(    T_T, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+            Hash_Update_TT(    T_T, colour, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
         else
-            Hash_Update_TT(Opp_T_T, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+            Hash_Update_TT(Opp_T_T, colour, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
     } else
     {
         /*the supplied move is only used for extended hash entry validation*/
         if (colour == WHITE)
-            Hash_Update_TT(    T_T, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+            Hash_Update_TT(    T_T, colour, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
         else
-            Hash_Update_TT(Opp_T_T, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
+            Hash_Update_TT(Opp_T_T, colour, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, movelist[0]);
     }
 
     return(a);
@@ -1337,6 +1758,165 @@ static void Search_Adjust_Priorities(MOVE * restrict movelist, int len,
     }
 }
 
+/*stages of the move picker in Search_Negascout(). each stage is generated
+  only if the previous ones did not produce a cutoff.*/
+enum E_MV_STAGE {STAGE_HASH, STAGE_CAPTURES, STAGE_KILLERS, STAGE_QUIETS, STAGE_LOSING, STAGE_DONE};
+
+/*captures and promotions are generated in the capture stage.*/
+static int Search_Is_Capture_Or_Promotion(MOVE move)
+{
+    if (board[move.m.to]->type != NO_PIECE)
+        return(1);
+    if (move.m.flag == 1U)
+        return(0);
+    if (move.m.flag != board[move.m.from]->type) /*promotion*/
+        return(1);
+    return(((move.m.to - move.m.from) % 10) != 0); /*en passant*/
+}
+
+/*losing captures go after the quiet moves, and their MVV/LVA value marks
+  them as non-tactical for the futility pruning and LMR.*/
+static void Search_Mark_Losing_Captures(MOVE *restrict movelist, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((movelist[i].m.mvv_lva > MVV_LVA_KILLER_0) && (Search_Is_Losing_Capture(movelist[i])))
+            movelist[i].m.mvv_lva = MVV_LVA_LOSING;
+    }
+}
+
+/*appends new_moves[0 .. n_new-1] to the list without those moves that are
+  already in movelist[0 .. len-1]. returns the new list length.*/
+static int Search_Append_New_Moves(MOVE *restrict movelist, int len,
+                                   const MOVE *restrict new_moves, int n_new)
+{
+    int i, j, new_len = len;
+
+    for (i = 0; i < n_new; i++)
+    {
+        for (j = 0; j < len; j++)
+        {
+            if (((new_moves[i].u ^ movelist[j].u) & mv_move_mask.u) == 0)
+                break;
+        }
+        if (j == len) /*not yet listed*/
+            movelist[new_len++].u = new_moves[i].u;
+    }
+    return(new_len);
+}
+
+/*a threat or killer move can be tried before the quiet moves are generated
+  if it is a quiet, pseudo-legal move that is not yet in the list. captures
+  and promotions have already been tried in the capture stage.*/
+static int Search_Is_Quiet_Candidate(MOVE move, const MOVE *restrict movelist, int len, enum E_COLOUR colour)
+{
+    int i, from_type;
+
+    if (move.u == MV_NO_MOVE_MASK)
+        return(0);
+    if (board[move.m.to]->type != NO_PIECE)
+        return(0);
+    from_type = board[move.m.from]->type;
+    if ((from_type == WPAWN) || (from_type == BPAWN))
+    {
+        if (move.m.flag != from_type) /*promotion, or a piece move in the list*/
+            return(0);
+    } else if (move.m.flag != 1U)
+        return(0);
+    for (i = 0; i < len; i++)
+    {
+        if (((movelist[i].u ^ move.u) & mv_move_mask.u) == 0)
+            return(0);
+    }
+    return(Mvgen_Check_Move_Legality(move, colour));
+}
+
+/*generates the next stage of the move picker at the end of the move list
+  and returns the new list length, which may be unchanged if the stage has
+  no new moves. the hash move has been validated on retrieval.
+  the stages are generated into a separate buffer because the full move
+  list also contains the moves of the previous stages, so that appending
+  it directly might overflow the move list.
+  the losing captures are parked at the end of the move list until the
+  quiet moves have been tried.*/
+static int Search_Next_Stage(MOVE *restrict movelist, int len, enum E_MV_STAGE *restrict stage,
+                             int *restrict n_losing, int level, enum E_COLOUR colour,
+                             MOVE hash_move, MOVE threat_move)
+{
+    MOVE stage_moves[MAXMV];
+    int n, i, j;
+
+    switch (*stage)
+    {
+    case STAGE_HASH:
+        movelist[len++].u = hash_move.u;
+        *stage = STAGE_CAPTURES;
+        break;
+    case STAGE_CAPTURES:
+        n = Mvgen_Find_All_Captures_And_Promotions(stage_moves, colour, UNDERPROM);
+        n = Search_Append_New_Moves(movelist, len, stage_moves, n);
+        for (i = j = len; i < n; i++)
+        {
+            if (((movelist[i].u ^ threat_move.u) & mv_move_mask.u) == 0)
+                movelist[i].m.mvv_lva = MVV_LVA_THREAT;
+            else if (Search_Is_Losing_Capture(movelist[i]))
+            {
+                movelist[i].m.mvv_lva = MVV_LVA_LOSING;
+                movelist[MAXMV - 1 - *n_losing] = movelist[i];
+                (*n_losing)++;
+                continue;
+            }
+            movelist[j++] = movelist[i];
+        }
+        len = j;
+        *stage = STAGE_KILLERS;
+        break;
+    case STAGE_KILLERS:
+        {
+            MOVE killer;
+
+            if (Search_Is_Quiet_Candidate(threat_move, movelist, len, colour))
+            {
+                movelist[len].u = threat_move.u;
+                movelist[len++].m.mvv_lva = MVV_LVA_THREAT;
+            }
+            for (i = 0; i < 2; i++)
+            {
+                killer = Mvgen_Decompress_Move((colour == WHITE) ? W_Killers[i][level - 1] : B_Killers[i][level - 1]);
+                if (Search_Is_Quiet_Candidate(killer, movelist, len, colour))
+                {
+                    killer.m.mvv_lva = (i == 0) ? MVV_LVA_KILLER_0 : MVV_LVA_KILLER_1;
+                    movelist[len++].u = killer.u;
+                }
+            }
+        }
+        *stage = STAGE_QUIETS;
+        break;
+    case STAGE_QUIETS:
+        n = Mvgen_Find_All_Moves(stage_moves, level - 1, colour, UNDERPROM);
+        for (i = j = 0; i < n; i++)
+        {
+            if (!Search_Is_Capture_Or_Promotion(stage_moves[i]))
+                stage_moves[j++] = stage_moves[i];
+        }
+        n = Search_Append_New_Moves(movelist, len, stage_moves, j);
+        Search_Do_Sort(movelist + len, n - len);
+        len = n;
+        *stage = STAGE_LOSING;
+        break;
+    case STAGE_LOSING:
+        for (i = 0; i < *n_losing; i++)
+            movelist[len++] = movelist[MAXMV - 1 - i];
+        *stage = STAGE_DONE;
+        break;
+    default:
+        break;
+    }
+    return(len);
+}
+
 static int Search_Endgame_Reduct(void)
 {
     /*basic endgames*/
@@ -1382,21 +1962,24 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
             return Search_Quiescence(alpha, beta, colour, QS_NO_CHECKS, 0);
     } else
     {
-        static int root_move_index;
+        static THREAD_LOCAL int root_move_index;
         MOVE x2movelst[MAXMV];
         MOVE threat_best, null_best, hash_best;
         enum E_COLOUR next_colour;
         int i, e, t, a, x2movelen, next_depth, node_moves;
-        int iret, is_material_enough, n_check_pieces;
+        int iret, is_material_enough, n_check_pieces, n_losing = 0;
         unsigned is_endgame, w_passed_mask, b_passed_mask;
         LINE line;
-        uint8_t should_iid=1, hash_move_mode, level_gt_1, node_pruned_moves;
+        PIN_INFO pins;
+        uint8_t should_iid=1, level_gt_1, node_pruned_moves, staged = 0;
+        enum E_MV_STAGE stage;
 
         level_gt_1 = (level > 1) ? 1 : 0;
 
         hash_best.u = MV_NO_MOVE_MASK;
 
         g_nodes++;
+        search_stats.nodes[(is_pv_node) ? STAT_PV : STAT_NON_PV]++;
 
         /*prevent stack overflow*/
         if (UNLIKELY(mv_stack_p - Starting_Mv >= MAX_DEPTH-1 )) { /* We are too deep */
@@ -1406,7 +1989,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
         /* Check Transposition Table for a match */
         if (!is_pv_node) {
             if (level & 1) { /* Our side to move */
-                if (Hash_Check_TT(T_T, colour, alpha, beta, depth, move_stack[mv_stack_p].mv_pos_hash, &t, &hash_best)) {
+                if (Search_Check_TT(T_T, colour, alpha, beta, depth, &t, &hash_best, STAT_NON_PV)) {
                     if (hash_best.u != MV_NO_MOVE_MASK)
                     {
                         pline->line_cmoves[0] = Mvgen_Compress_Move(hash_best);
@@ -1415,7 +1998,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                     return t;
                 }
             } else { /* Opponent time to move */
-                if (Hash_Check_TT(Opp_T_T, colour, alpha, beta, depth, move_stack[mv_stack_p].mv_pos_hash, &t, &hash_best)) {
+                if (Search_Check_TT(Opp_T_T, colour, alpha, beta, depth, &t, &hash_best, STAT_NON_PV)) {
                     if (hash_best.u != MV_NO_MOVE_MASK)
                     {
                         pline->line_cmoves[0] = Mvgen_Compress_Move(hash_best);
@@ -1429,14 +2012,14 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
           hash best move for move ordering.*/
         {
             if (level & 1) /* Our side to move */
-                Hash_Check_TT_PV(T_T, colour, depth, move_stack[mv_stack_p].mv_pos_hash, &t, &hash_best);
+                Search_Check_TT_PV(T_T, colour, depth, &t, &hash_best);
             else           /* Opponent time to move */
-                Hash_Check_TT_PV(Opp_T_T, colour, depth, move_stack[mv_stack_p].mv_pos_hash, &t, &hash_best);
+                Search_Check_TT_PV(Opp_T_T, colour, depth, &t, &hash_best);
         }
 
         /*level 2 has a dedicated move cache.*/
         if ((level == 2) && (hash_best.u == MV_NO_MOVE_MASK))
-            hash_best = Mvgen_Decompress_Move(opp_move_cache[root_move_index]);
+            hash_best = Mvgen_Decompress_Move(opp_move_cache[root_list_offset + root_move_index]);
 
         /*note that the contents of the passed pawn masks are only defined for is_endgame != 0.*/
         if (colour == BLACK) {
@@ -1453,9 +2036,9 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
           MOVE smove;
           smove.u = MV_NO_MOVE_MASK;
           if (level & 1) {
-            Hash_Update_TT(    T_T, depth, 0, EXACT, move_stack[mv_stack_p].mv_pos_hash, smove);
+            Hash_Update_TT(    T_T, colour, depth, 0, EXACT, move_stack[mv_stack_p].mv_pos_hash, smove);
           } else {
-            Hash_Update_TT(Opp_T_T, depth, 0, EXACT, move_stack[mv_stack_p].mv_pos_hash, smove);
+            Hash_Update_TT(Opp_T_T, colour, depth, 0, EXACT, move_stack[mv_stack_p].mv_pos_hash, smove);
           }
           return 0;
         }
@@ -1470,6 +2053,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                 (depth < RVRS_FUTIL_D) && (e - RVRS_FutilMargs[depth] >= beta) &&
                 ((is_material_enough >= EG_PIECES) || Search_Endgame_Reduct()))
             {
+                search_stats.rvrs_futility_prunes++;
                 return e;
             }
             /*Null search*/
@@ -1482,24 +2066,32 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                 /*this can fall right into QS which does not do check evasions at
                   QS level 0. But this is OK because the other side cannot be in check
                   given that it is actually our turn here, i.e. without null move.*/
+                search_stats.null_tries++;
                 t = -Search_Negascout(0, level + 1, &line, x2movelst, 0, next_depth, -beta, -beta + 1, next_colour, &iret, is_pv_node, 0, smove, 0);
                 if (t >= beta)
+                {
+                    search_stats.null_cutoffs++;
                     return t;
+                }
                 if (iret >= 0)
                     null_best.u = x2movelst[iret].u;
             }
         }
 
         /*late move generation*/
-        hash_move_mode = 0;
+        stage = STAGE_DONE;
         if (n == 0)
         {
-            /*defer that if we have a hash move - a beta cutoff is likely.*/
-            if ((hash_best.u == MV_NO_MOVE_MASK) || (following_pv))
+            /*use the staged move picker unless we follow the PV or do IID,
+              which both need the full move list. with a hash move, a beta
+              cutoff is likely before any move generation.*/
+            if ((following_pv) ||
+                ((hash_best.u == MV_NO_MOVE_MASK) && (depth > IID_DEPTH) && (level_gt_1)))
             {
                 MOVE GPVmove;
 
                 n = Mvgen_Find_All_Moves(mlst, level-1, colour, UNDERPROM);
+                Search_Mark_Losing_Captures(mlst, n);
 
                 /* Adjust move priorities */
                 if ((following_pv) && (GlobalPV.line_len > level-1))
@@ -1510,7 +2102,8 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                 Search_Adjust_Priorities(mlst, n, &should_iid, GPVmove, hash_best, threat_move);
             } else
             {
-                hash_move_mode = 1;
+                stage = (hash_best.u != MV_NO_MOVE_MASK) ? STAGE_HASH : STAGE_CAPTURES;
+                staged = 1;
                 should_iid = 0;
             }
         }
@@ -1530,60 +2123,47 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
         a = alpha;
         node_moves = node_pruned_moves = 0;
 
-        if (level_gt_1)
+        if ((level_gt_1) && (!staged))
         {
             /*root move list is already sorted in the main IID loop.*/
             Search_Swap_Best_To_Top(mlst, n);
         }
 
-        /*if we are not in a PV node and there is a hash best move, then this
-          move is 90% likely to cause a cutoff here. The move list has not
-          yet been generated, so n is 0, and the hash move is the only move
-          for now. It has been validated for pseudo legality upon retrieval
-          from the hash table. The in-check verification remains to do.*/
-        if (hash_move_mode)
-        {
-            mlst[0].u = hash_best.u;
-            n = 2;
-        }
-
         if (time_is_up == TM_NO_TIMEOUT)
             time_is_up = Time_Check_Throttle();
 
-        for (i = 0; i < n; i++)
+        /*pins for the legality test before making the moves.*/
+        Mvgen_Pin_Info(&pins, colour);
+
+        for (i = 0; ; i++)
         {
             /*foreach child of node*/
             int LastMoveToSquare, LastMovePieceType, capture_1, capture_2,
                 curr_move_follows_pv, can_reduct, n_checks;
 
+            /*staged move picker: the tried moves stay at the list start so
+              that the move index remains valid for the caller.*/
+            while ((i >= n) && (stage != STAGE_DONE))
+                n = Search_Next_Stage(mlst, n, &stage, &n_losing, level, colour, hash_best, threat_move);
+            if (i >= n)
+                break;
+
             if (level_gt_1) /*initial move list is already sorted*/
             {
-                if (i == 1)
-                {
-                    /*even later move generation*/
-                    if (hash_move_mode)
-                    {
-                        MOVE GPVmove;
-                        GPVmove.u = MV_NO_MOVE_MASK;
-
-                        n = Mvgen_Find_All_Moves(mlst, level-1, colour, UNDERPROM);
-                        /*if there is only one pseudo legal move, that must have been
-                          the hash move which has already been tried.*/
-                        if (n <= 1)
-                            break;
-
-                        /* Adjust move priorities */
-                        Search_Adjust_Priorities(mlst, n, &should_iid, GPVmove, hash_best, threat_move);
-                        Search_Do_Sort(mlst, n); /*hash move will be at the top*/
-                    } else
-                        Search_Do_Sort(mlst + 1, n - 1);
-                }
+                if (stage == STAGE_KILLERS) /*captures are picked by MVV/LVA*/
+                    Search_Swap_Best_To_Top(mlst + i, n - i);
+                else if ((i == 1) && (!staged))
+                    Search_Do_Sort(mlst + 1, n - 1);
             } else /*level 1 is root moves.*/
             {
-                uci_curr_move.u = mlst[i].u;
-                uci_curr_move_number = i;
                 root_move_index = i;
-                if ((show_currmove == CURR_ALWAYS) && (time_is_up == TM_NO_TIMEOUT))
+                if (search_thread_id == 0) /*helper threads have no output*/
+                {
+                    uci_curr_move.u = mlst[i].u;
+                    uci_curr_move_number = i;
+                }
+                if ((show_currmove == CURR_ALWAYS) && (time_is_up == TM_NO_TIMEOUT) &&
+                    (search_thread_id == 0))
                 {
                   /*output_time gets initialised to start_time + 1000LL. if it is
                     greater, then the first output_time must be through, which means
@@ -1609,14 +2189,11 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                     }
                 }
             }
+            if (!Mvgen_Move_Is_Legal(mlst[i], &pins, colour))
+                continue;
             Search_Push_Status();
             Search_Make_Move(mlst[i]);
-            if (Mvgen_King_In_Check(colour))
-            {
-                Search_Retract_Last_Move();
-                Search_Pop_Status();
-                continue;
-            }
+            Hash_Prefetch_TT((level & 1) ? Opp_T_T : T_T, next_colour, move_stack[mv_stack_p].mv_pos_hash);
 #ifdef MOVE_ANALYSIS
             DIFPrint
             printf("%s ",Play_Translate_Moves(mlst[i]));
@@ -1637,7 +2214,8 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                 if (colour == BLACK)
                 {
                     /* if our move just played gives check, generate evasions and do not reduce depth so we can search deeper */
-                    n_checks = Mvgen_White_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces);
+                    n_checks = (Mvgen_Last_Move_Gives_Check()) ?
+                               Mvgen_White_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces) : 0;
                     if (n_checks) { /* early move generation */
                         can_reduct = 0;
                         if ((depth <= 4) && (eval_noise < HIGH_EVAL_NOISE))
@@ -1655,6 +2233,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                                      ((is_material_enough >= EG_PIECES) || Search_Endgame_Reduct());
                         /*futility pruning*/
                         if ( can_reduct && (!is_pv_node) && (depth < FUTIL_DEPTH) && (e+FutilityMargins[depth] < a) ) {
+                            search_stats.futility_prunes++;
                             Search_Retract_Last_Move();
                             Search_Pop_Status();
                             node_pruned_moves = 1U; /*a pruned legal move still is a legal move - for the stalemate recognition at the end of this routine.*/
@@ -1693,7 +2272,8 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                     }
                 } else { /* colour == WHITE */
                     /* if our move just played gives check do not reduce depth so we can search deeper */
-                    n_checks = Mvgen_Black_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces);
+                    n_checks = (Mvgen_Last_Move_Gives_Check()) ?
+                               Mvgen_Black_King_In_Check_Info(search_check_attacks_buf, &n_check_pieces) : 0;
                     if (n_checks) { /* early move generation */
                         can_reduct = 0;
                         if ((depth <= 4) && (eval_noise < HIGH_EVAL_NOISE))
@@ -1711,6 +2291,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                                      ((is_material_enough >= EG_PIECES) || Search_Endgame_Reduct());
                         /*futility pruning*/
                         if ( can_reduct && (!is_pv_node) && (depth < FUTIL_DEPTH) && (e+FutilityMargins[depth] < a) ) {
+                            search_stats.futility_prunes++;
                             Search_Retract_Last_Move();
                             Search_Pop_Status();
                             node_pruned_moves = 1U; /*a pruned legal move still is a legal move - for the stalemate recognition at the end of this routine.*/
@@ -1764,6 +2345,9 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                            check evasion detection at QS level 0.*/
                         t = ((node_moves < 2 * LMR_MOVES) || (depth <= 3)) ? depth-2 : depth-3;
                         t = -Search_Negascout(1, level+1, &line, x2movelst, x2movelen, t, -a-1, -a, next_colour, &iret, CUT_NODE, n_checks, null_best, curr_move_follows_pv);
+                        search_stats.lmr_reductions++;
+                        if (t > a)
+                            search_stats.lmr_researches++;
                     } else t = a + 1;  /* Ensure that re-search is done. */
 
                     if (t > a) {
@@ -1789,7 +2373,7 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
             /*if we are in level 1, then store the best answer from level 2
               for the next main depth iteration.*/
             if ((!level_gt_1) && (threat_best.u != MV_NO_MOVE_MASK))
-                opp_move_cache[i] = Mvgen_Compress_Move(threat_best);
+                opp_move_cache[root_list_offset + i] = Mvgen_Compress_Move(threat_best);
 
             /*the following constitutes alpha-beta pruning*/
             if (t > a) {
@@ -1808,12 +2392,9 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                     pline->line_len = 0;
                 }
                 if (a >= beta) { /*-- cut-off --*/
-#ifdef DBGCUTOFF
-                    if (node_moves == 0) { /* First move of search */
-                        cutoffs_on_1st_move++;
-                    }
-                    total_cutoffs++;
-#endif
+                    if (node_moves == 0) /* First move of search */
+                        search_stats.first_move_cutoffs++;
+                    search_stats.beta_cutoffs++;
                     /*Update depth killers for non captures.
                       not for kings because that's usually castling, moving out of
                       check or some tempo/manoeuvring thing, i.e. different across
@@ -1842,9 +2423,9 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
 
                     /* Update Transposition table */
                     if (level & 1) {
-                        Hash_Update_TT(    T_T, depth, a, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, mlst[i]);
+                        Hash_Update_TT(    T_T, colour, depth, a, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, mlst[i]);
                     } else {
-                        Hash_Update_TT(Opp_T_T, depth, a, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, mlst[i]);
+                        Hash_Update_TT(Opp_T_T, colour, depth, a, CHECK_BETA, move_stack[mv_stack_p].mv_pos_hash, mlst[i]);
                     }
                     return a;
                 }
@@ -1900,16 +2481,16 @@ static int Search_Negascout(int CanNull, int level, LINE *restrict pline, MOVE *
                 hash_best.u = MV_NO_MOVE_MASK;
 
             if (level & 1)
-                Hash_Update_TT(    T_T, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, hash_best);
+                Hash_Update_TT(    T_T, colour, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, hash_best);
             else
-                Hash_Update_TT(Opp_T_T, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, hash_best);
+                Hash_Update_TT(Opp_T_T, colour, depth, a, EXACT, move_stack[mv_stack_p].mv_pos_hash, hash_best);
         } else
         {
             hash_best.u = MV_NO_MOVE_MASK;
             if (level & 1)
-                Hash_Update_TT(    T_T, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, hash_best);
+                Hash_Update_TT(    T_T, colour, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, hash_best);
             else
-                Hash_Update_TT(Opp_T_T, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, hash_best);
+                Hash_Update_TT(Opp_T_T, colour, depth, a, CHECK_ALPHA, move_stack[mv_stack_p].mv_pos_hash, hash_best);
         }
         return a;
     }
@@ -1964,13 +2545,17 @@ static int Search_Play_And_Sort_Moves(MOVE *restrict movelist, int len,
     return(sortV[0]);
 }
 
-static void Search_Print_Move_Output(int depth, int score, int64_t time_passed, int hash_report)
+/*prints one PV line. multipv is the line number for the UCI output, or 0
+  if there is only one line.*/
+static void Search_Print_Line_Output(const LINE *pv, int multipv, int depth, int score,
+                                     int64_t time_passed, int hash_report)
 {
-    uint64_t nps;
+    uint64_t nps, total_nodes;
     int len;
 
+    total_nodes = Search_Get_Total_Nodes();
     if (time_passed > 0)
-        nps = (g_nodes * 1000ULL) / time_passed;
+        nps = (total_nodes * 1000ULL) / time_passed;
     else
         nps = 0;
 
@@ -1985,11 +2570,18 @@ static void Search_Print_Move_Output(int depth, int score, int64_t time_passed,
     strcpy(printbuf + len, " seldepth ");
     len += 10;
 
-    if (GlobalPV.line_len > depth)
-        len += Util_Tostring_U16(printbuf + len, (uint16_t) GlobalPV.line_len);
+    if (pv->line_len > depth)
+        len += Util_Tostring_U16(printbuf + len, (uint16_t) pv->line_len);
     else
         len += Util_Tostring_U16(printbuf + len, (uint16_t) depth);
 
+    if (multipv > 0)
+    {
+        strcpy(printbuf + len, " multipv ");
+        len += 9;
+        len += Util_Tostring_U16(printbuf + len, (uint16_t) multipv);
+    }
+
     if (score > MATE_CUTOFF)
     {
         int mate_moves = INFINITY_ - score;
@@ -2019,7 +2611,7 @@ static void Search_Print_Move_Output(int depth, int score, int64_t time_passed,
 
     strcpy(printbuf + len, " nodes ");
     len += 7;
-    len += Util_Tostring_U64(printbuf + len, g_nodes);
+    len += Util_Tostring_U64(printbuf + len, total_nodes);
 
     strcpy(printbuf + len, " nps ");
     len += 5;
@@ -2038,11 +2630,11 @@ static void Search_Print_Move_Output(int depth, int score, int64_t time_passed,
     len += 8;
     len += Util_Tostring_U64(printbuf + len, tb_hits);
 
-    if (GlobalPV.line_len > 0)
+    if (pv->line_len > 0)
     {
         strcpy(printbuf + len, " pv");
         len += 3;
-        len += Search_Print_PV_Line(&GlobalPV, printbuf + len);
+        len += Search_Print_PV_Line(pv, printbuf + len);
     }
 
     printbuf[len++] = '\n';
@@ -2051,6 +2643,26 @@ static void Search_Print_Move_Output(int depth, int score, int64_t time_passed,
     Play_Print(printbuf); /*print everything at once so that the other thread won't interfere*/
 }
 
+/*prints the PV, or all lines with MultiPV. the further lines have their
+  own depth and score from the last iteration where they were completed.
+  the hash usage is only reported once because it involves a table scan.*/
+static void Search_Print_Move_Output(int depth, int score, int64_t time_passed, int hash_report)
+{
+    if (multipv_cnt > 1)
+    {
+        int k;
+
+        Search_Print_Line_Output(&GlobalPV, 1, depth, score, time_passed, hash_report);
+        for (k = 1; k < multipv_cnt; k++)
+        {
+            if (multipv_lines[k].line_len > 0)
+                Search_Print_Line_Output(multipv_lines + k, k + 1, multipv_depths[k],
+                                         multipv_scores[k], time_passed, 0);
+        }
+    } else
+        Search_Print_Line_Output(&GlobalPV, 0, depth, score, time_passed, hash_report);
+}
+
 /*tests whether the position is checkmate for the relevant colour.*/
 static int Search_Is_Checkmate(enum E_COLOUR colour)
 {
@@ -2262,6 +2874,8 @@ void Search_Make_Move(MOVE amove)
         }
     }
     p->mv_pos_hash = Hash_Get_Position_Value(&(p->mv_pawn_hash));
+    if (p->mv_pawn_hash != (p-1)->mv_pawn_hash)
+        Hash_Prefetch_Pawn_TT(p->mv_pawn_hash);
 }
 
 void Search_Retract_Last_Move(void)
@@ -2482,7 +3096,7 @@ static void Search_Sort_50_Moves(MOVE *restrict player_move, MOVE *restrict move
 
                 /*prefer check giving moves. if those lead to legal
                   captures, they will be de-prioritised anyway.*/
-                if (Mvgen_King_In_Check(next_colour))
+                if (Mvgen_Last_Move_Gives_Check())
                     is_checking = 1;
                 else
                     is_checking = 0;
@@ -2593,11 +3207,229 @@ static int Search_Get_Root_Move_List(MOVE *restrict movelist, int *restrict move
     return(n_checks);
 }
 
+/*one iteration of the iterative deepening at the root. the aspiration
+  window around the last score gets widened on fail high or fail low.*/
+static int Search_Root_Iteration(int d, int nscore, MOVE *restrict movelist, int move_cnt,
+                                 enum E_COLOUR colour, int in_check, LINE *restrict pline,
+                                 int *restrict ret_mv_idx)
+{
+    const int alpha_full = -INFINITY_;
+    const int beta_full  =  INFINITY_;
+    int alpha, beta;
+    MOVE no_threat_move;
+
+    no_threat_move.u = MV_NO_MOVE_MASK;
+
+    /*set aspiration window.*/
+    if (d >= ID_WINDOW_DEPTH)
+    {
+        alpha = nscore - ID_WINDOW_SIZE;
+        if (alpha < alpha_full) alpha = alpha_full;
+        beta  = nscore + ID_WINDOW_SIZE;
+        if (beta > beta_full) beta = beta_full;
+    } else
+    {
+        /*use full window at low depth.*/
+        alpha = alpha_full;
+        beta  = beta_full;
+    }
+
+    /*widen window until neither fail high nor low.*/
+    for (;;)
+    {
+        nscore = Search_Negascout(0, 1, pline, movelist, move_cnt, d, alpha, beta, colour,
+                                  ret_mv_idx, PV_NODE, in_check, no_threat_move, 1);
+
+        /*search with full window should not fail, but
+          just for robustness.*/
+        if ((alpha == alpha_full) && (beta == beta_full))
+            break;
+
+        if (time_is_up != TM_NO_TIMEOUT)
+            break;
+
+        if ((g_max_nodes) && (g_nodes >= g_max_nodes))
+            break;
+
+        if (nscore <= alpha) /*fail low*/
+        {
+            /*note that a fail low implies ret_mv_idx == -1 because
+              the Negascout initialises the return index to that value
+              and only sets it up when a move raises alpha, which no
+              move does in case of a fail low.*/
+            alpha = alpha_full;
+        } else if (nscore >= beta) /*fail high*/
+        {
+            beta = beta_full;
+            if (*ret_mv_idx > 1)
+            {
+                /*don't accept as new PV because the re-search will be
+                  with half open window, and the PV will guide the search
+                  faster to useful limits. But make sure that its root move
+                  is not ranked lower down the list than 2nd place.*/
+                MOVE ret_move = movelist[*ret_mv_idx];
+                Search_Find_Put_To_Top_Root(movelist + 1, opp_move_cache + root_list_offset + 1, move_cnt - 1, ret_move);
+            }
+        } else
+            break;
+    }
+    return(nscore);
+}
+
+/*searches the further MultiPV lines after the main line of an iteration.
+  the root moves of the better lines are at the top of the move list, so line
+  k is searched on the list from position k on. the best move goes to
+  position k for the next line. afterwards, the lines are sorted by score
+  together with their root moves so that the next iteration starts with the
+  right order. a line can only score better than the one before it because
+  of search instability; if that affects the main line, the function returns
+  1 and the new main line is in GlobalPV and main_score.*/
+static int Search_MultiPV_Iteration(int d, int *restrict main_score, MOVE *restrict movelist,
+                                    int move_cnt, enum E_COLOUR colour, int in_check)
+{
+    LINE line;
+    int k, i, ret_mv_idx, main_changed = 0;
+
+    /*the main line may have changed its root move.*/
+    Search_Find_Put_To_Top_Root(movelist, opp_move_cache, move_cnt,
+                                Mvgen_Decompress_Move(GlobalPV.line_cmoves[0]));
+
+    /*the move ordering follows GlobalPV, so each line temporarily puts its
+      own PV from the previous iteration there. the main line is kept at
+      index 0 meanwhile, which is otherwise unused.*/
+    multipv_lines[0] = GlobalPV;
+    multipv_scores[0] = *main_score;
+
+    for (k = 1; k < multipv_cnt; k++)
+    {
+        int score;
+
+        GlobalPV = multipv_lines[k];
+        root_list_offset = k;
+        score = Search_Root_Iteration(d, multipv_scores[k], movelist + k, move_cnt - k,
+                                      colour, in_check, &line, &ret_mv_idx);
+        root_list_offset = 0;
+
+        /*an aborted line keeps the result from the previous iteration.*/
+        if ((time_is_up != TM_NO_TIMEOUT) || (ret_mv_idx < 0))
+            break;
+
+        Search_Find_Put_To_Top_Root(movelist + k, opp_move_cache + k, move_cnt - k,
+                                    movelist[k + ret_mv_idx]);
+        multipv_lines[k].line_cmoves[0] = Mvgen_Compress_Move(movelist[k]);
+        memcpy(multipv_lines[k].line_cmoves + 1, line.line_cmoves, sizeof(CMOVE) * line.line_len);
+        multipv_lines[k].line_len = line.line_len + 1;
+        multipv_scores[k] = score;
+        multipv_depths[k] = d;
+    }
+
+    /*insertion sort of the completed lines.*/
+    for (i = 1; i < k; i++)
+    {
+        int j;
+
+        for (j = i; (j > 0) && (multipv_scores[j] > multipv_scores[j-1]); j--)
+        {
+            LINE tmp_line;
+            MOVE tmp_move;
+            CMOVE tmp_cmove;
+            int tmp_score;
+
+            tmp_line = multipv_lines[j];
+            multipv_lines[j] = multipv_lines[j-1];
+            multipv_lines[j-1] = tmp_line;
+            tmp_score = multipv_scores[j];
+            multipv_scores[j] = multipv_scores[j-1];
+            multipv_scores[j-1] = tmp_score;
+            tmp_move = movelist[j];
+            movelist[j] = movelist[j-1];
+            movelist[j-1] = tmp_move;
+            tmp_cmove = opp_move_cache[j];
+            opp_move_cache[j] = opp_move_cache[j-1];
+            opp_move_cache[j-1] = tmp_cmove;
+            if (j == 1)
+                main_changed = 1;
+        }
+    }
+
+    GlobalPV = multipv_lines[0];
+    *main_score = multipv_scores[0];
+    return(main_changed);
+}
+
+/*copies the root position for the helper threads. must be called by the main
+  thread before starting the helpers.*/
+static void Search_Setup_Helper_Root(const MOVE *restrict movelist, int move_cnt,
+                                     enum E_COLOUR colour, int in_check, int max_depth)
+{
+    Search_Save_Root_Position();
+    memcpy(helper_root.movelist, movelist, sizeof(MOVE) * move_cnt);
+    memcpy(&helper_root.pv, &GlobalPV, sizeof(LINE));
+    memcpy(&helper_root.game_info, &game_info, sizeof(GAME_INFO));
+    helper_root.tt = T_T;
+    helper_root.opp_tt = Opp_T_T;
+    helper_root.max_tt = MAX_TT;
+    helper_root.pmax_tt = PMAX_TT;
+    helper_root.hash_clear_counter = hash_clear_counter;
+    helper_root.dynamic_resign_threshold = dynamic_resign_threshold;
+    helper_root.computer_side = computer_side;
+    helper_root.move_cnt = move_cnt;
+    helper_root.in_check = in_check;
+    helper_root.max_depth = max_depth;
+    helper_root.colour = colour;
+    memset((void *) helper_nodes, 0, sizeof(helper_nodes));
+    memset(helper_stats, 0, sizeof(helper_stats));
+}
+
+/*maps a piece pointer from the main thread's piece lists to the own ones.
+  the empty and fence pieces are shared and need no mapping.*/
+static PIECE *Search_Relocate_Piece(PIECE *piece_p)
+{
+    uintptr_t piece_addr = (uintptr_t) piece_p;
+    uintptr_t w_base = (uintptr_t) helper_root.main_wpieces;
+    uintptr_t b_base = (uintptr_t) helper_root.main_bpieces;
+
+    if ((piece_addr >= w_base) && (piece_addr < w_base + sizeof(Wpieces)))
+        return(Wpieces + (piece_addr - w_base) / sizeof(PIECE));
+    if ((piece_addr >= b_base) && (piece_addr < b_base + sizeof(Bpieces)))
+        return(Bpieces + (piece_addr - b_base) / sizeof(PIECE));
+    return(piece_p);
+}
+
+/*starts the helper threads if the parallel search is configured. not with
+  node limits or throttling since these have to stay exact.*/
+static void Search_Start_Helpers(const MOVE *restrict movelist, int move_cnt, enum E_COLOUR colour,
+                                 int in_check, int max_depth, int cpu_speed, uint64_t max_nps_rate)
+{
+    helper_cnt = 0;
+    helper_stop = 0;
+
+    if ((search_threads <= 1) || (move_cnt < 2) || (g_max_nodes) ||
+        (cpu_speed < 100) || (max_nps_rate < MAX_THROTTLE_KNPS * 1000ULL))
+    {
+        return;
+    }
+
+    Search_Setup_Helper_Root(movelist, move_cnt, colour, in_check, max_depth);
+    helper_cnt = Play_Start_Helper_Threads(search_threads - 1);
+}
+
+/*signals the helper threads to stop and waits for them. their final node
+  counts remain available for the output.*/
+static void Search_Stop_Helpers(void)
+{
+    if (helper_cnt > 0)
+    {
+        helper_stop = 1;
+        Play_Join_Helper_Threads();
+    }
+}
+
 enum E_COMP_RESULT
 Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_move_time,
                      int move_overhead, int exact_time, int max_depth, int cpu_speed,
                      uint64_t max_nps_rate, enum E_COLOUR colour, const MOVE *restrict given_moves,
-                     int given_moves_len, int mate_mode, int mate_depth_mv,
+                     int given_moves_len, int mate_mode, int mate_depth_mv, int ponder_mode,
                      uint64_t *restrict spent_nodes, int64_t *restrict spent_time)
 {
     uint64_t printed_nodes;
@@ -2611,6 +3443,19 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
     start_time_nps = start_time; /*can be overwritten later after hash aging*/
     sleep_time = 0;
 
+    /*while pondering, the search runs like in analysis mode, and the given
+      time limits are only applied after "ponderhit". pondering in mate mode
+      makes no sense, so that is a regular search right away.*/
+    is_pondering = ((ponder_mode) && (!mate_mode));
+    if (is_pondering)
+    {
+        ponder_move_time = full_move_time;
+        ponder_move_overhead = move_overhead;
+        ponder_exact_time = exact_time;
+        full_move_time = INFINITE_TIME;
+        exact_time = 1;
+    }
+
     /*get the time when to start the first throttle sleep phase in CPU
       percentage mode, but only after the pre-search*/
     throttle_time = start_time + INFINITE_TIME;
@@ -2659,6 +3504,7 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
         /*no game information available, use 10 ms fixed.*/
         min_thinking_time = 10;
     }
+    ponder_min_time = min_thinking_time;
 
     stop_time = start_time + full_move_time - move_overhead; /*account for GUI delays*/
 
@@ -2680,6 +3526,8 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
     uci_curr_move.u = MV_NO_MOVE_MASK;
     uci_curr_move_number = 0;
     g_nodes = 1; /*this node*/
+    helper_cnt = 0;
+    multipv_cnt = 1;
     nodes_current_second = 1;
     printed_nodes = 0;
     tb_hits = 0;
@@ -2689,13 +3537,17 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
     nps_startup_phase = 1;
     *spent_nodes = 1ULL;
     *spent_time = 0LL;
-#ifdef DBGCUTOFF
-    cutoffs_on_1st_move = total_cutoffs = 0ULL;
+    memset(&search_stats, 0, sizeof(SEARCH_STATS));
+#ifdef DBGTTSTALL
+    tt_probes = tt_stalls = 0ULL;
 #endif
 
     answer_move->u = MV_NO_MOVE_MASK;
     mate_in_1 = 0;
-    is_analysis = ((exact_time) && (full_move_time == INFINITE_TIME));
+    if (is_pondering)
+        is_analysis = ((ponder_exact_time) && (ponder_move_time == INFINITE_TIME));
+    else
+        is_analysis = ((exact_time) && (full_move_time == INFINITE_TIME));
 
     Search_Reset_History();
 
@@ -2705,9 +3557,13 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
 
     Starting_Mv = mv_stack_p;
     in_check = Search_Get_Root_Move_List(movelist, &move_cnt, colour);
+    ponder_in_check = in_check;
 
     if (move_cnt == 0) /*the GUI should have filtered this*/
     {
+        /*a ponder search must not return before "ponderhit" or "stop".*/
+        if (is_pondering)
+            Time_Wait_For_Abort();
         if (in_check)
             return (COMP_MATE);
         else
@@ -2814,27 +3670,13 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
         *spent_nodes = g_nodes;
         return(COMP_MOVE_FOUND);
     } else {
-        static int64_t hash_clear_time = 0LL;
-        int64_t reduced_move_time;
-        MOVE no_threat_move, decomp_move;
+        MOVE decomp_move;
         int d, sort_max, pv_hit = 0, score_drop, pos_score, nscore;
         CMOVE failsafe_cmove;
 
-        no_threat_move.u = MV_NO_MOVE_MASK;
-
         /*if 50 moves draw is close, re-sort the list*/
         Search_Sort_50_Moves(&player_move, movelist, move_cnt, colour);
 
-        /*drop age clearing under extreme time pressure*/
-        if ((full_move_time >= move_overhead * 10LL) && (full_move_time >= hash_clear_time * 10LL))
-        {
-            int64_t start_clear_time = Play_Get_Millisecs();
-            Hash_Cut_Tables(hash_clear_counter);
-            hash_clear_time = Play_Get_Millisecs() - start_clear_time;
-        }
-
-        /*clearing the hash tables takes time that should not be used for
-          NPS calibration.*/
         start_time_nps = Play_Get_Millisecs();
 
         /*if too much time has been used, don't start another iteration as it will not finish anyway.*/
@@ -2985,6 +3827,14 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
             Search_Find_Put_To_Top(movelist, move_cnt, decomp_move);
         }
 
+        /*MultiPV for the main search. more lines than root moves make no sense.*/
+        multipv_cnt = (search_multipv < move_cnt) ? search_multipv : move_cnt;
+        for (i = 1; i < multipv_cnt; i++)
+        {
+            multipv_lines[i].line_len = 0;
+            multipv_scores[i] = pos_score;
+        }
+
         /*look whether the easy move detection is
           a) a PV hit
           OR
@@ -3001,7 +3851,8 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
                 ((sort_max - game_info.last_valid_eval) > EASY_MARGIN_DOWN))
            )) ||
            (exact_time) || /*don't use time savings with exact time*/
-           (given_moves_len)) /*that is used for analysis*/
+           (given_moves_len) || /*that is used for analysis*/
+           (multipv_cnt > 1))
         {
             score_drop = 0;
         }
@@ -3021,66 +3872,13 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
 
         nscore = pos_score;
 
+        /*the helper threads start from the sorted root move list.*/
+        Search_Start_Helpers(movelist, move_cnt, colour, in_check, max_depth, cpu_speed, max_nps_rate);
+
         for (d=START_DEPTH; ((d < MAX_DEPTH) && (d <= max_depth) &&
                              ((!g_max_nodes) || (g_nodes < g_max_nodes))); d++)
         { /* Iterative deepening method*/
-            const int alpha_full = -INFINITY_;
-            const int beta_full  =  INFINITY_;
-            int alpha, beta;
-
-            /*set aspiration window.*/
-            if (d >= ID_WINDOW_DEPTH)
-            {
-                alpha = nscore - ID_WINDOW_SIZE;
-                if (alpha < alpha_full) alpha = alpha_full;
-                beta  = nscore + ID_WINDOW_SIZE;
-                if (beta > beta_full) beta = beta_full;
-            } else
-            {
-                /*use full window at low depth.*/
-                alpha = alpha_full;
-                beta  = beta_full;
-            }
-
-            /*widen window until neither fail high nor low.*/
-            for (;;)
-            {
-                nscore = Search_Negascout(0, 1, &line, movelist, move_cnt, d, alpha, beta, colour,
-                                          &ret_mv_idx, PV_NODE, in_check, no_threat_move, 1);
-
-                /*search with full window should not fail, but
-                  just for robustness.*/
-                if ((alpha == alpha_full) && (beta == beta_full))
-                    break;
-
-                if (time_is_up != TM_NO_TIMEOUT)
-                    break;
-
-                if ((g_max_nodes) && (g_nodes >= g_max_nodes))
-                    break;
-
-                if (nscore <= alpha) /*fail low*/
-                {
-                    /*note that a fail low implies ret_mv_idx == -1 because
-                      the Negascout initialises the return index to that value
-                      and only sets it up when a move raises alpha, which no
-                      move does in case of a fail low.*/
-                    alpha = alpha_full;
-                } else if (nscore >= beta) /*fail high*/
-                {
-                    beta = beta_full;
-                    if (ret_mv_idx > 1)
-                    {
-                        /*don't accept as new PV because the re-search will be
-                          with half open window, and the PV will guide the search
-                          faster to useful limits. But make sure that its root move
-                          is not ranked lower down the list than 2nd place.*/
-                        MOVE ret_move = movelist[ret_mv_idx];
-                        Search_Find_Put_To_Top_Root(movelist + 1, opp_move_cache + 1, move_cnt - 1, ret_move);
-                    }
-                } else
-                    break;
-            }
+            nscore = Search_Root_Iteration(d, nscore, movelist, move_cnt, colour, in_check, &line, &ret_mv_idx);
 
             time_passed = Time_Passed();
             if (ret_mv_idx >= 0)
@@ -3119,9 +3917,24 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
                     Search_Find_Put_To_Top_Root(movelist, opp_move_cache, move_cnt, decomp_move);
                 }
 
+                if ((multipv_cnt > 1) && (time_is_up == TM_NO_TIMEOUT))
+                {
+                    if (Search_MultiPV_Iteration(d, &pos_score, movelist, move_cnt, colour, in_check))
+                    {
+                        game_info.valid = EVAL_MOVE;
+                        game_info.eval = nscore = pos_score;
+                        game_info.depth = d;
+                    }
+                    time_passed = Time_Passed();
+                }
+
                 Search_Print_Move_Output(d, pos_score, time_passed, is_normal_time);
                 printed_nodes = g_nodes; /*avoid double PV with fixed depth search.*/
 
+                /*after a ponderhit, the given time mode applies.*/
+                if ((ponder_mode) && (!is_pondering))
+                    exact_time = ponder_exact_time;
+
                 if ((((pos_score > MATE_CUTOFF) || (pos_score < -MATE_CUTOFF) || (move_cnt < 2)) && (exact_time == 0))
                     || (time_is_up != TM_NO_TIMEOUT))
                     break;
@@ -3145,6 +3958,7 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
             }
         } /*for (d=...) end of Iterative Deepening loop*/
 
+        Search_Stop_Helpers();
         time_passed = Time_Passed();
 
         if (printed_nodes < g_nodes) /*avoid double PV with fixed depth search.*/
@@ -3154,7 +3968,7 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
         {
             /*computer resigns, but still return the move found in case the player wants to play it out*/
             *answer_move = Mvgen_Decompress_Move(GlobalPV.line_cmoves[0]);
-            if ((is_analysis) && (time_is_up != TM_ABORT))
+            if (((is_analysis) || (is_pondering)) && (time_is_up != TM_ABORT))
             /*timeout is also caused by abort command*/
             {
                 Time_Wait_For_Abort();
@@ -3164,19 +3978,196 @@ Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_
             return(COMP_RESIGN);
         }
     }
-#ifdef DBGCUTOFF
-    printf("info string cutoff %u\n", (unsigned)((cutoffs_on_1st_move*1000ULL) / total_cutoffs));
+    if (search_stats_output)
+        Search_Print_Stats();
+#ifdef DBGTTSTALL
+    /*main thread only.*/
+    printf("info string TT probes %llu stalled %u permill\n", (unsigned long long) tt_probes,
+           (unsigned)((tt_stalls*1000ULL) / (tt_probes + 1ULL)));
 #endif
 
     *answer_move = Mvgen_Decompress_Move(GlobalPV.line_cmoves[0]);
-    if ((is_analysis) && (time_is_up != TM_ABORT))
+    /*a ponder search must not return before "ponderhit" or "stop".*/
+    if (((is_analysis) || (is_pondering)) && (time_is_up != TM_ABORT))
     /*timeout is also caused by abort command*/
     {
         Time_Wait_For_Abort();
         time_passed = Time_Passed();
         Search_Print_Move_Output(game_info.depth, game_info.eval, time_passed, is_normal_time);
     }
-    *spent_nodes = g_nodes;
+    *spent_nodes = Search_Get_Total_Nodes();
     *spent_time = time_passed;
     return(COMP_MOVE_FOUND);
 }
+
+/*copies the position of the calling thread so that other threads can take
+  it over with Search_Load_Root_Position(). the piece pointers still point
+  to the own piece lists and are relocated when loading.*/
+void Search_Save_Root_Position(void)
+{
+    memcpy(helper_root.board, board, sizeof(board));
+    memcpy(helper_root.wpieces, Wpieces, sizeof(Wpieces));
+    memcpy(helper_root.bpieces, Bpieces, sizeof(Bpieces));
+    helper_root.main_wpieces = Wpieces;
+    helper_root.main_bpieces = Bpieces;
+    memcpy(helper_root.move_stack, move_stack, sizeof(MVST) * (mv_stack_p + 1));
+    memcpy(helper_root.cstack, cstack, sizeof(uint16_t) * (cst_p + 1));
+    helper_root.fifty_moves = fifty_moves;
+    helper_root.game_started_from_0 = game_started_from_0;
+    helper_root.start_moves = start_moves;
+    helper_root.mv_stack_p = mv_stack_p;
+    helper_root.cst_p = cst_p;
+    helper_root.wking = wking;
+    helper_root.bking = bking;
+    helper_root.en_passant_sq = en_passant_sq;
+    helper_root.gflags = gflags;
+}
+
+/*takes over the position saved with Search_Save_Root_Position() into the
+  board of the calling thread.*/
+void Search_Load_Root_Position(void)
+{
+    int i;
+
+    memcpy(Wpieces, helper_root.wpieces, sizeof(Wpieces));
+    memcpy(Bpieces, helper_root.bpieces, sizeof(Bpieces));
+    for (i = 0; i < 16; i++)
+    {
+        Wpieces[i].next = Search_Relocate_Piece(Wpieces[i].next);
+        Wpieces[i].prev = Search_Relocate_Piece(Wpieces[i].prev);
+        Bpieces[i].next = Search_Relocate_Piece(Bpieces[i].next);
+        Bpieces[i].prev = Search_Relocate_Piece(Bpieces[i].prev);
+    }
+    for (i = 0; i < 120; i++)
+        board[i] = Search_Relocate_Piece(helper_root.board[i]);
+
+    mv_stack_p = helper_root.mv_stack_p;
+    cst_p = helper_root.cst_p;
+    memcpy(move_stack, helper_root.move_stack, sizeof(MVST) * (mv_stack_p + 1));
+    memcpy(cstack, helper_root.cstack, sizeof(uint16_t) * (cst_p + 1));
+    for (i = 0; i <= mv_stack_p; i++)
+        move_stack[i].captured = Search_Relocate_Piece(move_stack[i].captured);
+
+    wking = helper_root.wking;
+    bking = helper_root.bking;
+    en_passant_sq = helper_root.en_passant_sq;
+    gflags = helper_root.gflags;
+    fifty_moves = helper_root.fifty_moves;
+    game_started_from_0 = helper_root.game_started_from_0;
+    start_moves = helper_root.start_moves;
+}
+
+/*entry point of a lazy SMP helper thread. the helper takes over the root
+  position from the main thread and runs its own iterative deepening until
+  the main thread stops it. every odd helper starts one ply deeper so that
+  the threads diverge a bit more.*/
+void Search_Helper_Thread(int thread_id)
+{
+    MOVE movelist[MAXMV];
+    LINE line;
+    int d, move_cnt, ret_mv_idx, nscore;
+    enum E_COLOUR colour;
+
+    search_thread_id = thread_id;
+
+    /*the pawn hash table is per thread. it is allocated with the options
+      and kept across searches.*/
+    PMAX_TT = helper_root.pmax_tt;
+    P_T_T = helper_p_t_t[thread_id];
+
+    Search_Load_Root_Position();
+    memcpy(&GlobalPV, &helper_root.pv, sizeof(LINE));
+    memcpy(&game_info, &helper_root.game_info, sizeof(GAME_INFO));
+
+    /*the main hash tables are shared with the main thread.*/
+    T_T = helper_root.tt;
+    Opp_T_T = helper_root.opp_tt;
+    MAX_TT = helper_root.max_tt;
+    hash_clear_counter = helper_root.hash_clear_counter;
+
+    dynamic_resign_threshold = helper_root.dynamic_resign_threshold;
+    computer_side = helper_root.computer_side;
+    (void) Eval_Setup_Initial_Material();
+
+    move_cnt = helper_root.move_cnt;
+    colour = helper_root.colour;
+    memcpy(movelist, helper_root.movelist, sizeof(MOVE) * move_cnt);
+
+    Starting_Mv = mv_stack_p;
+    g_nodes = 1;
+    tb_hits = 0;
+    time_is_up = TM_NO_TIMEOUT;
+    memset(&search_stats, 0, sizeof(SEARCH_STATS));
+    Search_Reset_History();
+    memset(opp_move_cache, 0, sizeof(opp_move_cache));
+
+    nscore = 0;
+    for (d = START_DEPTH + (thread_id & 1); ((d < MAX_DEPTH) && (d <= helper_root.max_depth)); d++)
+    {
+        nscore = Search_Root_Iteration(d, nscore, movelist, move_cnt, colour,
+                                       helper_root.in_check, &line, &ret_mv_idx);
+        if (time_is_up != TM_NO_TIMEOUT)
+            break;
+        /*the helper's own root move ordering for the next iteration.*/
+        if (ret_mv_idx >= 0)
+            Search_Find_Put_To_Top_Root(movelist, opp_move_cache, move_cnt, movelist[ret_mv_idx]);
+    }
+
+    helper_nodes[thread_id][0] = g_nodes;
+    memcpy(&helper_stats[thread_id], &search_stats, sizeof(SEARCH_STATS));
+    P_T_T = NULL;
+}
+
+/*prints the statistics of the last search, summed over all threads. this
+  is not time critical, so sprintf is fine here.*/
+void Search_Print_Stats(void)
+{
+    static const char *const node_names[STAT_NODE_TYPES] = {"pv", "non-pv", "qs"};
+    static const char *const table_names[STAT_TT_TABLES] = {"own", "opp"};
+    SEARCH_STATS sum;
+    const uint64_t *src;
+    uint64_t *dest;
+    size_t j;
+    int i, k;
+
+    memcpy(&sum, &search_stats, sizeof(SEARCH_STATS));
+    /*the struct only has uint64_t members.*/
+    for (i = 1; i <= helper_cnt; i++)
+    {
+        src = (const uint64_t *) &helper_stats[i];
+        dest = (uint64_t *) &sum;
+        for (j = 0; j < sizeof(SEARCH_STATS) / sizeof(uint64_t); j++)
+            dest[j] += src[j];
+    }
+
+    sprintf(printbuf, "info string stats nodes pv %"PRIu64" non-pv %"PRIu64" qs %"PRIu64"\n",
+            sum.nodes[STAT_PV], sum.nodes[STAT_NON_PV], sum.nodes[STAT_QS]);
+    Play_Print(printbuf);
+    for (k = 0; k < STAT_TT_TABLES; k++)
+    {
+        for (i = 0; i < STAT_NODE_TYPES; i++)
+        {
+            sprintf(printbuf, "info string stats tt %s %s probes %"PRIu64" hits %"PRIu64" cutoffs %"PRIu64"\n",
+                    table_names[k], node_names[i], sum.tt_probes[k][i], sum.tt_hits[k][i], sum.tt_cutoffs[k][i]);
+            Play_Print(printbuf);
+        }
+    }
+    sprintf(printbuf, "info string stats beta cutoffs %"PRIu64" first move %"PRIu64"\n",
+            sum.beta_cutoffs, sum.first_move_cutoffs);
+    Play_Print(printbuf);
+    sprintf(printbuf, "info string stats null move tries %"PRIu64" cutoffs %"PRIu64"\n",
+            sum.null_tries, sum.null_cutoffs);
+    Play_Print(printbuf);
+    sprintf(printbuf, "info string stats lmr reductions %"PRIu64" re-searches %"PRIu64"\n",
+            sum.lmr_reductions, sum.lmr_researches);
+    Play_Print(printbuf);
+    sprintf(printbuf, "info string stats futility prunes %"PRIu64" reverse futility prunes %"PRIu64"\n",
+            sum.futility_prunes, sum.rvrs_futility_prunes);
+    Play_Print(printbuf);
+    sprintf(printbuf, "info string stats pawn hash probes %"PRIu64" hits %"PRIu64"\n",
+            sum.pawn_probes, sum.pawn_hits);
+    Play_Print(printbuf);
+    sprintf(printbuf, "info string stats eval cache probes %"PRIu64" hits %"PRIu64"\n",
+            sum.eval_probes, sum.eval_hits);
+    Play_Print(printbuf);
+}
@@ -27,8 +27,12 @@ enum E_COMP_RESULT
 Search_Get_Best_Move(MOVE *restrict answer_move, MOVE player_move, int64_t full_move_time,
                      int move_overhead, int exact_time, int max_depth, int cpu_speed,
                      uint64_t max_nps_rate, enum E_COLOUR colour, const MOVE *restrict given_moves,
-                     int given_moves_len, int mate_mode, int mate_depth_mv,
+                     int given_moves_len, int mate_mode, int mate_depth_mv, int ponder_mode,
                      uint64_t *restrict spent_nodes, int64_t *restrict spent_time);
+void    Search_Helper_Thread(int thread_id);
+void    Search_Save_Root_Position(void);
+void    Search_Load_Root_Position(void);
+void    Search_Print_Stats(void);
 
 /*the following two functions are implemented as macro since the calling overhead
 isn't worthwhile, but they are needed in different files.*/